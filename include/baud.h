@@ -0,0 +1,29 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : baud.h
+ */
+
+#ifndef BAUD_H
+#define BAUD_H
+
+/*
+ * kept apart from termios.h on purpose: the termios2 interface needed for
+ * arbitrary rates lives in asm/termbits.h which conflicts with the libc
+ * definitions
+ */
+
+/**
+ * set a non-standard baudrate through termios2 and BOTHER
+ *
+ * must be applied after tcsetattr() as that resets the custom speed
+ *
+ * @param[in] fd open serial port
+ * @param[in] baudrate bits per second
+ * @return status 0 for succes, -1 for failure
+ */
+extern int baud_set_custom(int fd, unsigned int baudrate);
+
+#endif
+
+// vim:ft=c
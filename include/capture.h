@@ -0,0 +1,90 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : capture.h
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * max bytes moved from the port to the file at once
+ */
+#define CAPTURE_CHUNK (1024 * 1024)
+
+/**
+ * max number of rotated segments waiting for compression
+ */
+#define CAPTURE_QUEUE 16
+
+/**
+ * receive-only spool of a port to segmented files
+ *
+ * bytes are spliced from the port through a pipe into the file without
+ * passing through user space, or moved by large reads when the driver can
+ * not splice; no line is ever looked at, rotated segments are gzipped by a
+ * background thread
+ */
+typedef struct capture_t {
+    char* path;           /**< segment being written, rotated to path.N */
+    int fd;               /**< open segment */
+    off_t rotate;         /**< rotate when a segment exceeds this, 0 never */
+    double interval;      /**< rotate every interval sec, 0 never */
+    int compress;         /**< gzip rotated segments to path.N.gz */
+    unsigned int segment; /**< number of the last rotated segment */
+    off_t written;        /**< bytes in the current segment */
+    double opened;        /**< monotonic sec the current segment started */
+    int pipe[2];          /**< splice pipe or -1 when reading instead */
+    char* buf;            /**< read buffer when not splicing */
+    size_t bytes;         /**< bytes captured */
+    unsigned int rotated; /**< segments rotated */
+    char* queue[CAPTURE_QUEUE]; /**< rotated segments to be compressed */
+    size_t head;          /**< oldest segment in queue */
+    size_t used;          /**< segments in queue */
+    int done;             /**< no more segments will be queued */
+    pthread_mutex_t lock; /**< protects queue */
+    pthread_cond_t ready; /**< segment queued or done */
+    pthread_t thread;     /**< compression thread, when compress is set */
+} capture_t;
+
+/**
+ * open (append to) capture file and start the compression thread
+ *
+ * @param[out] capture object to initialize
+ * @param[in] path file name
+ * @param[in] rotate max segment size before it is renamed to path.N, 0 never
+ * @param[in] interval sec after which a segment is rotated, 0 never
+ * @param[in] compress gzip rotated segments
+ * @return status 0 for succes, -1 for failure
+ */
+extern int capture_open(capture_t* capture, const char* path, off_t rotate,
+        double interval, int compress);
+
+/**
+ * move everything received on a port to the capture file until killed
+ *
+ * @param[in,out] capture open capture
+ * @param[in] fd open port
+ * @param[in] killed flag set asynchronously by SIGINT or SIGTERM, both are
+ *            blocked outside of the wait so none is missed
+ * @return status 0 for succes, -1 for failure or hangup
+ */
+extern int capture_run(capture_t* capture, int fd,
+        volatile sig_atomic_t* killed);
+
+/**
+ * close the current segment, compress what is queued and report totals
+ *
+ * @param[in] capture all dyn. allocated memory in this object to be freed
+ * @return status 0 for succes, -1 for failure
+ */
+extern int capture_close(capture_t* capture);
+
+#endif
+
+// vim:ft=c
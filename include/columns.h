@@ -0,0 +1,128 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : columns.h
+ */
+
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * rows buffered per table before they are written as one block
+ */
+#define COLUMNS_BLOCK 1024
+
+/**
+ * type of a field extracted from a response line
+ */
+typedef enum {
+    FIELD_SKIP = '-',     /**< present in the line, not stored */
+    FIELD_INT = 'i',      /**< signed decimal integer */
+    FIELD_FLOAT = 'f',    /**< decimal number, up to 18 significant digits */
+    FIELD_HEX = 'x',      /**< unsigned hexadecimal integer, 0x optional */
+} field_type_t;
+
+/**
+ * value of a stored field
+ */
+typedef struct {
+    int64_t i;            /**< integer, or the mantissa of FIELD_FLOAT */
+    int64_t exp;          /**< decimal exponent of FIELD_FLOAT */
+} field_t;
+
+/**
+ * extraction rule of one command and the rows not yet written
+ */
+typedef struct table_t {
+    char* cmd;            /**< command of which the response is extracted */
+    char sep;             /**< field separator, ' ' for any run of blanks */
+    field_type_t* fields; /**< type of every field in the line */
+    size_t nfields;       /**< length of fields */
+    size_t ncolumns;      /**< fields that are not FIELD_SKIP */
+    int64_t* time;        /**< CLOCK_REALTIME nsec of every buffered row */
+    field_t* rows;        /**< COLUMNS_BLOCK rows of ncolumns values */
+    size_t nrows;         /**< buffered rows */
+    size_t stored;        /**< rows extracted */
+    size_t rejected;      /**< lines that did not match the rule */
+} table_t;
+
+/**
+ * columnar binary log of fields extracted from responses
+ *
+ * the log starts with the magic "TRXCOL1\n" followed by entries; every run
+ * appends a schema entry 'H' holding the number of tables and per table the
+ * command, the number of columns and their type bytes, after which block
+ * entries 'B' hold the table index, the number of rows and the payload size
+ * followed by the timestamp column and every value column in turn;
+ * timestamps and integers are stored as LEB128 varints of the zigzag encoded
+ * difference with the previous row, floats the same way as the mantissa
+ * followed by the decimal exponent so they are kept exactly as received
+ */
+typedef struct columns_t {
+    int fd;               /**< open log file or -1 */
+    table_t* tables;      /**< array of tables */
+    size_t n;             /**< length of tables */
+    table_t* last;        /**< table of the previous line */
+    char* buf;            /**< encoded block */
+    size_t size;          /**< allocated size of buf */
+} columns_t;
+
+/**
+ * add extraction rule
+ *
+ * @param[in,out] columns tables, not yet opened, one per command
+ * @param[in] value "<separator> <type>,<type>,... <command>" where the
+ *            separator is a single character, "space" or "tab" and each type
+ *            is int, float, hex or - to skip the field
+ * @return status 0 for succes, -1 for failure
+ */
+extern int columns_add_rule(columns_t* columns, const char* value);
+
+/**
+ * open (append to) log file and write the schema of the tables
+ *
+ * @param[in,out] columns tables, at least one
+ * @param[in] path log file, created when missing
+ * @return status 0 for succes, -1 for failure
+ */
+extern int columns_open(columns_t* columns, const char* path);
+
+/**
+ * extract the fields of a response line into its table
+ *
+ * lines of commands without a rule are ignored
+ *
+ * @param[in,out] columns open log
+ * @param[in] cmd command the line responds to
+ * @param[in] line received line, not null terminated
+ * @param[in] len length of line
+ * @return status 0 for succes, -1 for failure
+ */
+extern int columns_write(columns_t* columns, const char* cmd,
+        const char* line, size_t len);
+
+/**
+ * write buffered rows, report rejected lines and close log
+ *
+ * @param[in] columns all dyn. allocated memory in this object to be freed
+ * @return status 0 for succes, -1 for failure
+ */
+extern int columns_close(columns_t* columns);
+
+/**
+ * print a log as csv or json lines
+ *
+ * @param[in] path log file
+ * @param[in] stream output stream
+ * @param[in] json one json object per row instead of csv
+ * @return status 0 for succes, -1 for failure
+ */
+extern int columns_dump(const char* path, FILE* stream, int json);
+
+#endif
+
+// vim:ft=c
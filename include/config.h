@@ -0,0 +1,62 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : config.h
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "../include/portsettings.h"
+#include "../include/registry.h"
+
+/**
+ * find file in various locations (~/.config/trx, ~/.trx, /etc/trx)
+ *
+ * @param[in] file name of file or absolute path
+ * @param[in] ext extension
+ * @return pointer to allocated string with absolute path or NULL if failed
+ */
+extern char* config_find(const char* file, const char* ext);
+
+/**
+ * set a single device setting, replacing its current value
+ *
+ * @param[in,out] portsettings settings to update
+ * @param[in] key setting name
+ * @param[in] value setting value
+ * @return status 0 for succes, 1 if the key is unknown, -1 for an invalid
+ *         value
+ */
+extern int config_set(portsettings_t* portsettings, const char* key,
+        const char* value);
+
+/**
+ * apply a single device setting from a config, settings that were given
+ * explicitly are left untouched
+ *
+ * unknown keys are ignored, registry_apply_t compatible
+ *
+ * @param[in,out] portsettings settings to update
+ * @param[in] key setting name
+ * @param[in] value setting value
+ * @return status 0 for succes, -1 for failure
+ */
+extern int config_apply(portsettings_t* portsettings, const char* key,
+        const char* value);
+
+/**
+ * apply the settings of a device from the registry or a config file
+ *
+ * @param[in,out] registry index, opened on the first lookup by name
+ * @param[in,out] portsettings writes settings in this struct
+ * @param[in] name device name, or path of a config file
+ * @param[in] apply callback for every setting, eg config_apply()
+ * @return status 0 for succes, -1 for failure
+ */
+extern int config_load(registry_t* registry, portsettings_t* portsettings,
+        const char* name, registry_apply_t apply);
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,90 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : framing.h
+ */
+
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "../include/rxbuf.h"
+
+/**
+ * how messages are delimited on the wire
+ */
+typedef enum {
+    FRAMING_LINE,   /**< text terminated by CR, responses split by delimiter */
+    FRAMING_COBS,   /**< consistent overhead byte stuffing, 0x00 terminated */
+    FRAMING_SLIP,   /**< RFC 1055, 0xc0 terminated */
+    FRAMING_LENGTH, /**< 16 bit big-endian payload length header */
+} framing_t;
+
+/**
+ * parse framing setting
+ *
+ * @param[out] framing framing to be set
+ * @param[in] str "line", "cobs", "slip" or "length"
+ * @return status 0 for succes, -1 for failure
+ */
+extern int framing_parse(framing_t* framing, const char* str);
+
+/**
+ * name of framing
+ *
+ * @param[in] framing framing
+ * @return static string
+ */
+extern const char* framing_name(framing_t framing);
+
+/**
+ * largest encoded size of a payload, for sizing the output buffer
+ *
+ * @param[in] framing framing
+ * @param[in] len payload length
+ * @return max number of bytes framing_encode() writes
+ */
+extern size_t framing_bound(framing_t framing, size_t len);
+
+/**
+ * encode payload into a frame
+ *
+ * @param[in] framing framing, FRAMING_LINE appends a CR
+ * @param[in] in payload
+ * @param[in] len length of payload
+ * @param[out] out at least framing_bound() bytes
+ * @return length of frame or -1 when the payload can not be framed
+ */
+extern ssize_t framing_encode(framing_t framing, const char* in, size_t len,
+        char* out);
+
+/**
+ * take next complete frame from receive buffer and decode it in place
+ *
+ * like rxbuf_line() the payload is a slice into the buffer, no copies or
+ * allocations are made
+ *
+ * @param[in] framing framing, must not be FRAMING_LINE
+ * @param[in,out] rxbuf buffer
+ * @param[out] frame start of decoded payload
+ * @param[out] len length of payload
+ * @return 1 if a frame was taken, 0 if no complete frame is buffered,
+ *         -1 if a malformed frame was dropped
+ */
+extern int framing_decode(framing_t framing, rxbuf_t* rxbuf, char** frame,
+        size_t* len);
+
+/**
+ * decode hexadecimal text, whitespace between bytes is allowed
+ *
+ * @param[in] str hex text
+ * @param[out] out at least strlen(str)/2 bytes
+ * @return number of bytes or -1 for invalid text
+ */
+extern ssize_t framing_hex_decode(const char* str, char* out);
+
+#endif
+
+// vim:ft=c
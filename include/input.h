@@ -0,0 +1,90 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : input.h
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/**
+ * source of commands, one per line
+ *
+ * regular files are memory-mapped and split into an index of commands in a
+ * single pass, anything else (stdin, pipes) is streamed line by line so
+ * commands are available as soon as they arrive
+ */
+typedef struct input_t {
+    char* map;            /**< mapped file or NULL when streaming */
+    size_t size;          /**< length of map */
+    char** index;         /**< start of every command in map */
+    size_t n;             /**< length of index */
+    size_t next;          /**< index of next command */
+    char* tail;           /**< copy of an unterminated last line */
+    size_t tailat;        /**< offset of tail in the file */
+    FILE* stream;         /**< streamed input */
+    char* line;           /**< getline() buffer */
+    size_t linesize;      /**< allocated length of line */
+    off_t offset;         /**< bytes read from stream */
+} input_t;
+
+/**
+ * open command source
+ *
+ * comments (#) and empty lines are skipped, trailing CR/LF is trimmed and
+ * lines are not limited in length
+ *
+ * @param[out] input object to initialize
+ * @param[in] path file to read, "-" for stdin
+ * @return status 0 for succes, -1 for failure
+ */
+extern int input_open(input_t* input, const char* path);
+
+/**
+ * take next command
+ *
+ * @param[in,out] input command source
+ * @return null-terminated command, valid until input_close() for mapped files
+ *         and until the next call for streams, NULL at end of input
+ */
+extern const char* input_next(input_t* input);
+
+/**
+ * position to resume from after the last command taken
+ *
+ * @param[in] input command source
+ * @return byte offset of the line following the last command, comments and
+ *         empty lines in between may or may not be included
+ */
+extern off_t input_offset(const input_t* input);
+
+/**
+ * skip all commands that start before an offset taken by input_offset()
+ *
+ * streams are read and discarded up to the offset, which has to fall on a
+ * line boundary
+ *
+ * @param[in,out] input command source, nothing taken yet
+ * @param[in] offset byte offset
+ * @param[out] last last command skipped, NULL if none, valid as the return
+ *             value of input_next()
+ * @return number of commands skipped or -1 for failure, errno EINVAL when the
+ *         offset is beyond the end of input or, for streams, not on a line
+ *         boundary
+ */
+extern ssize_t input_seek(input_t* input, off_t offset, const char** last);
+
+/**
+ * release mapping or stream
+ *
+ * @param[in] input all dyn. allocated memory in this object to be freed
+ */
+extern void input_close(input_t* input);
+
+#endif
+
+// vim:ft=c
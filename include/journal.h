@@ -0,0 +1,133 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : journal.h
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * size of one record in the journal file
+ */
+#define JOURNAL_RECORD 64
+
+/**
+ * called before a checkpoint is written, so the responses it covers reach
+ * their destination first
+ *
+ * @return status 0 for succes, -1 for failure
+ */
+typedef int (*journal_flush_t)(void);
+
+/**
+ * position in the input file
+ */
+typedef struct checkpoint_t {
+    off_t offset;         /**< input offset following the command */
+    uint64_t n;           /**< number of the command in the input, 0 none */
+    uint32_t hash;        /**< FNV-1a of the command */
+} checkpoint_t;
+
+/**
+ * checkpoint journal of an input file
+ *
+ * the file holds two JOURNAL_RECORD slots that are written in turn, each a
+ * line of hex fields "seq offset n hash crc", so a record torn by a crash
+ * leaves the previous one to resume from; progress only moves over commands
+ * that were answered, the first command that was not holds it back
+ */
+typedef struct journal_t {
+    char* path;           /**< journal file */
+    int fd;               /**< open journal file */
+    double interval;      /**< sec between syncs, 0 every command */
+    double synced;        /**< monotonic sec of the last sync */
+    journal_flush_t flush; /**< called before writing, may be NULL */
+    uint32_t seq;         /**< number of the last record written */
+    int dirty;            /**< acked has not been written */
+    checkpoint_t acked;   /**< last command acknowledged */
+    checkpoint_t queued;  /**< last command transmitted without response */
+    checkpoint_t missed;  /**< first command left unanswered */
+} journal_t;
+
+/**
+ * open journal
+ *
+ * @param[out] journal object to initialize
+ * @param[in] path journal file, created when missing
+ * @param[in] interval sec between syncs, 0 syncs every command
+ * @param[in] resume continue from the checkpoint in the file instead of
+ *            starting over
+ * @param[in] flush called before a checkpoint is written, may be NULL
+ * @return status 0 for succes, -1 for failure
+ */
+extern int journal_open(journal_t* journal, const char* path, double interval,
+        int resume, journal_flush_t flush);
+
+/**
+ * hash of a command as kept in a checkpoint
+ *
+ * @param[in] cmd null-terminated command
+ * @return FNV-1a
+ */
+extern uint32_t journal_hash(const char* cmd);
+
+/**
+ * record command as answered, everything before it has been as well
+ *
+ * @param[in,out] journal open journal
+ * @param[in] at position of the command
+ * @param[in] cmd transmitted command
+ * @return status 0 for succes, -1 for failure
+ */
+extern int journal_ack(journal_t* journal, const checkpoint_t* at,
+        const char* cmd);
+
+/**
+ * record command that expects no response as queued for transmission
+ *
+ * @param[in,out] journal open journal
+ * @param[in] at position of the command
+ * @param[in] cmd queued command
+ */
+extern void journal_queue(journal_t* journal, const checkpoint_t* at,
+        const char* cmd);
+
+/**
+ * acknowledge the queued commands once they have been transmitted
+ *
+ * @param[in,out] journal open journal
+ * @return status 0 for succes, -1 for failure
+ */
+extern int journal_flushed(journal_t* journal);
+
+/**
+ * record command as unanswered, holding back all further progress
+ *
+ * @param[in,out] journal open journal
+ * @param[in] at position of the command
+ */
+extern void journal_miss(journal_t* journal, const checkpoint_t* at);
+
+/**
+ * write and sync the last checkpoint
+ *
+ * @param[in,out] journal open journal
+ * @return status 0 for succes, -1 for failure
+ */
+extern int journal_sync(journal_t* journal);
+
+/**
+ * sync and close journal
+ *
+ * @param[in] journal all dyn. allocated memory in this object to be freed
+ * @return status 0 for succes, -1 for failure
+ */
+extern int journal_close(journal_t* journal);
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,134 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : latency.h
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+
+/**
+ * number of most recent samples kept per command prefix
+ */
+#define LATENCY_SAMPLES 32
+
+/**
+ * max length of a command prefix including null character
+ */
+#define LATENCY_PREFIX 32
+
+/**
+ * observed response timing of commands sharing a prefix
+ */
+typedef struct latency_t {
+    char prefix[LATENCY_PREFIX];  /**< first word of the command */
+    double first[LATENCY_SAMPLES]; /**< sec between transmit and first line */
+    double gap[LATENCY_SAMPLES];  /**< sec between consecutive lines */
+    unsigned int nfirst;          /**< total first line samples taken */
+    unsigned int ngap;            /**< total gap samples taken */
+} latency_t;
+
+/**
+ * persistent latency profile of one device
+ */
+typedef struct profile_t {
+    char* path;                   /**< file the profile is stored in */
+    latency_t* entries;           /**< one entry per command prefix */
+    size_t n;                     /**< length of entries */
+    int dirty;                    /**< entries changed since loading */
+} profile_t;
+
+/**
+ * load profile from the cache directory, missing file yields empty profile
+ *
+ * the profile is stored as $XDG_CACHE_HOME/trx/<name>.latency or
+ * $HOME/.cache/trx/<name>.latency
+ *
+ * @param[out] profile object to initialize
+ * @param[in] name device name, '/' is replaced by '_'
+ * @return status 0 for succes, -1 for failure
+ */
+extern int profile_load(profile_t* profile, const char* name);
+
+/**
+ * find (or add) the timing entry of a command
+ *
+ * @param[in,out] profile profile to search
+ * @param[in] cmd command, only the first word is used
+ * @return entry or NULL if failed
+ */
+extern latency_t* profile_get(profile_t* profile, const char* cmd);
+
+/**
+ * write profile back if it was changed
+ *
+ * @param[in] profile profile to save
+ * @return status 0 for succes, -1 for failure
+ */
+extern int profile_save(profile_t* profile);
+
+/**
+ * free allocated memory
+ *
+ * @param[in] profile all dyn. allocated memory in this object to be freed
+ */
+extern void profile_die(profile_t* profile);
+
+/**
+ * record time between transmit and first line
+ *
+ * @param[in,out] profile profile to mark dirty
+ * @param[in,out] latency entry of the command
+ * @param[in] sec observed latency
+ */
+extern void latency_add_first(profile_t* profile, latency_t* latency, double sec);
+
+/**
+ * record time between two lines of a response
+ *
+ * @param[in,out] profile profile to mark dirty
+ * @param[in,out] latency entry of the command
+ * @param[in] sec observed gap
+ */
+extern void latency_add_gap(profile_t* profile, latency_t* latency, double sec);
+
+/**
+ * forget first line samples, used after a learned deadline proved too short
+ *
+ * @param[in,out] profile profile to mark dirty
+ * @param[in,out] latency entry of the command
+ */
+extern void latency_reset(profile_t* profile, latency_t* latency);
+
+/**
+ * forget gap samples, used after a learned gap cut a response short
+ *
+ * @param[in,out] profile profile to mark dirty
+ * @param[in,out] latency entry of the command
+ */
+extern void latency_reset_gap(profile_t* profile, latency_t* latency);
+
+/**
+ * deadline for the first line of a response
+ *
+ * @param[in] latency entry of the command
+ * @param[in] timeout configured timeout, returned when history is too short
+ * @return timeout in sec, never more than the configured timeout
+ */
+extern double latency_first(const latency_t* latency, double timeout);
+
+/**
+ * deadline for every next line of a response, this ends a response of
+ * unknown length as soon as the device has gone quiet
+ *
+ * @param[in] latency entry of the command
+ * @param[in] timeout configured timeout, returned when history is too short
+ * @return timeout in sec, never more than the configured timeout
+ */
+extern double latency_gap(const latency_t* latency, double timeout);
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,103 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : libtrx.h
+ */
+
+#ifndef LIBTRX_H
+#define LIBTRX_H
+
+#include <stddef.h>
+
+/**
+ * symbols exported by the shared library, everything else is hidden
+ */
+#define TRX_API __attribute__((visibility("default")))
+
+/**
+ * status returned by the library, negative values are errors
+ */
+typedef enum {
+    TRX_OK = 0,           /**< succes */
+    TRX_EINVAL = -1,      /**< unknown setting or invalid value */
+    TRX_ENODEV = -2,      /**< unknown device or unreadable config */
+    TRX_EPORT = -3,       /**< port could not be opened or configured */
+    TRX_EIO = -4,         /**< transmission or reception failed */
+    TRX_ENOMEM = -5,      /**< out of memory */
+} trx_status_t;
+
+/**
+ * session with one serial device, opaque
+ *
+ * every session has its own settings, port and receive buffer, so any
+ * number may be used at once, each by one thread at a time; the port is
+ * opened by the first exchange and kept open until the session is closed
+ */
+typedef struct trx trx_t;
+
+/**
+ * called for every line received in response to a command
+ *
+ * @param[in] line null-terminated response line, valid during the call
+ * @param[in] len length of line
+ * @param[in,out] arg passed through from trx_transact()
+ */
+typedef void (*trx_line_t)(const char* line, size_t len, void* arg);
+
+/**
+ * create session
+ *
+ * @param[out] trx new session
+ * @param[in] device name of a device in the registry, path of a config file
+ *            or NULL to configure everything by trx_set()
+ * @return TRX_OK, TRX_ENODEV or TRX_ENOMEM
+ */
+extern TRX_API int trx_open(trx_t** trx, const char* device);
+
+/**
+ * change a setting as if given in a device config, eg "port", "baudrate",
+ * "timeout" or "count"
+ *
+ * settings of the line itself close an open port, it is opened with the new
+ * settings by the next exchange
+ *
+ * @param[in,out] trx session
+ * @param[in] key setting name
+ * @param[in] value setting value
+ * @return TRX_OK, TRX_EINVAL or TRX_ENOMEM
+ */
+extern TRX_API int trx_set(trx_t* trx, const char* key, const char* value);
+
+/**
+ * transmit command and receive the response
+ *
+ * the response ends after "count" lines or by the "timeout", "first", "gap"
+ * and "total" limits, whichever comes first
+ *
+ * @param[in,out] trx session
+ * @param[in] cmd command, without terminator
+ * @param[in] line callback for every received line or NULL
+ * @param[in,out] arg passed to line
+ * @return number of lines received, or TRX_EPORT or TRX_EIO
+ */
+extern TRX_API int trx_transact(trx_t* trx, const char* cmd, trx_line_t line,
+        void* arg);
+
+/**
+ * restore and close the port and free the session
+ *
+ * @param[in] trx session, may be NULL
+ */
+extern TRX_API void trx_close(trx_t* trx);
+
+/**
+ * describe status
+ *
+ * @param[in] status value returned by the library
+ * @return static string
+ */
+extern TRX_API const char* trx_strerror(int status);
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,138 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : output.h
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "../include/uring.h"
+
+/**
+ * size of a buffer handed to the writer thread
+ */
+#define OUTPUT_CHUNK (64 * 1024)
+
+/**
+ * max number of chunks waiting for the writer thread
+ */
+#define OUTPUT_QUEUE 64
+
+/**
+ * record format
+ */
+typedef enum {
+    OUTPUT_RAW,   /**< response only */
+    OUTPUT_CSV,   /**< timestamp,device,command,response */
+    OUTPUT_JSON,  /**< one json object per line */
+} output_format_t;
+
+/**
+ * buffer of formatted records
+ */
+typedef struct chunk_t {
+    char data[OUTPUT_CHUNK];    /**< formatted records */
+    size_t len;                 /**< bytes used in data */
+} chunk_t;
+
+/**
+ * response file written by a dedicated thread
+ *
+ * records are formatted into large chunks by the receiving thread and queued,
+ * so a slow disk never delays serial reception unless the whole queue is full;
+ * with an io_uring every queued chunk is written by one submission of linked
+ * writes instead of a write() each
+ */
+typedef struct output_t {
+    char* path;                 /**< output file */
+    int fd;                     /**< open output file */
+    output_format_t format;     /**< record format */
+    off_t rotate;               /**< rotate when file exceeds this, 0 never */
+    off_t written;              /**< bytes in current file */
+    unsigned int segment;       /**< number of rotated files */
+    chunk_t* current;           /**< chunk being filled */
+    chunk_t* queue[OUTPUT_QUEUE]; /**< chunks to be written */
+    size_t head;                /**< oldest chunk in queue */
+    size_t used;                /**< chunks in queue */
+    size_t writing;             /**< chunks taken by the writer thread */
+    chunk_t* spare[OUTPUT_QUEUE]; /**< written chunks for reuse */
+    size_t nspare;              /**< length of spare */
+    int done;                   /**< no more chunks will be queued */
+    int error;                  /**< errno of a failed write */
+    pthread_mutex_t lock;       /**< protects queue and spare */
+    pthread_cond_t ready;       /**< chunk queued or done */
+    pthread_cond_t room;        /**< chunk written */
+    pthread_t thread;           /**< writer thread */
+    uring_t ring;               /**< ring of the writer thread, fd -1 when
+                                     writing synchronously */
+} output_t;
+
+/**
+ * parse record format
+ *
+ * @param[out] format format to be set
+ * @param[in] str "raw", "csv" or "json"
+ * @return status 0 for succes, -1 for failure
+ */
+extern int output_parse_format(output_format_t* format, const char* str);
+
+/**
+ * parse file size, with optional k, M or G suffix
+ *
+ * @param[out] size size in bytes
+ * @param[in] str size text
+ * @return status 0 for succes, -1 for failure
+ */
+extern int output_parse_size(off_t* size, const char* str);
+
+/**
+ * open (append to) output file and start writer thread
+ *
+ * @param[out] output object to initialize
+ * @param[in] path file name
+ * @param[in] format record format
+ * @param[in] rotate max file size before it is renamed to path.N, 0 never
+ * @param[in] uring write through an io_uring, when the kernel provides one
+ * @return status 0 for succes, -1 for failure
+ */
+extern int output_open(output_t* output, const char* path,
+        output_format_t format, off_t rotate, int uring);
+
+/**
+ * format and queue one response line
+ *
+ * @param[in,out] output open output
+ * @param[in] device name of device or NULL
+ * @param[in] cmd command the line responds to
+ * @param[in] line response line
+ * @param[in] len length of line
+ * @param[in] hex write line as hex
+ * @return status 0 for succes, -1 for failure
+ */
+extern int output_write(output_t* output, const char* device, const char* cmd,
+        const char* line, size_t len, int hex);
+
+/**
+ * wait until everything queued so far is written and synced to disk
+ *
+ * @param[in,out] output open output
+ * @return status 0 for succes, -1 if any write failed
+ */
+extern int output_sync(output_t* output);
+
+/**
+ * write everything that is queued, stop writer thread and close file
+ *
+ * @param[in] output all dyn. allocated memory in this object to be freed
+ * @return status 0 for succes, -1 if any write failed
+ */
+extern int output_close(output_t* output);
+
+#endif
+
+// vim:ft=c
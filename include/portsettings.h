@@ -10,14 +10,91 @@
 #include <termios.h>
 #include <sys/time.h>
 
+#include "../include/framing.h"
+#include "../include/record.h"
+#include "../include/rxbuf.h"
+
+/**
+ * settings given explicitly, as flags in portsettings_t.fixed
+ */
+#define PORTSETTINGS_DELIMITER  0x01
+#define PORTSETTINGS_FLOW       0x02
+#define PORTSETTINGS_FRAMING    0x04
+#define PORTSETTINGS_DRAIN      0x08
+#define PORTSETTINGS_HEX        0x10
+#define PORTSETTINGS_LOWLATENCY 0x20
+#define PORTSETTINGS_SPIN       0x40
+
+/**
+ * flow control
+ */
+typedef enum {
+    FLOW_NONE,            /**< no flow control */
+    FLOW_RTSCTS,          /**< hardware, RTS/CTS lines */
+    FLOW_XONXOFF,         /**< software, XON/XOFF characters */
+} flow_t;
+
+/**
+ * kernel error counters of a port as sampled by TIOCGICOUNT
+ */
+typedef struct {
+    int valid;            /**< port supports the counters */
+    int frame;            /**< framing errors */
+    int overrun;          /**< UART overruns */
+    int parity;           /**< parity errors */
+    int brk;              /**< break conditions */
+    int buf_overrun;      /**< tty buffer overruns */
+} icount_t;
+
+/**
+ * receive time limits of one response, in sec
+ */
+typedef struct {
+    double first;         /**< from transmission to the first byte */
+    double gap;           /**< silence between bytes once receiving */
+    double total;         /**< from transmission to the end, 0 for none */
+} timing_t;
+
 /**
  * object containing all settings necessary for serial connection
  */
 typedef struct {
-   speed_t baudrate;      /**< baudrate qs defined in termios.h */
+   speed_t baudrate;      /**< bits per second, non-standard rates allowed */
    char *port;            /**< serial device file */
    unsigned int count;    /**< amount of lines will be attempted to read */
-   double timeout;        /**< msec passed when attempting to read line */
+   double timeout;        /**< sec of silence that ends a response */
+   double first;          /**< sec to the first byte, 0 for timeout */
+   double gap;            /**< sec between bytes, 0 for timeout */
+   double total;          /**< sec for the whole response, 0 for no limit */
+   delimiter_t delimiter; /**< end of line in received data */
+   delimiter_t terminator; /**< end of line appended to commands */
+   unsigned int databits; /**< 5 to 8 bits per character */
+   char parity;           /**< 'n'one, 'e'ven, 'o'dd, 'm'ark or 's'pace */
+   unsigned int stopbits; /**< 1 or 2 */
+   flow_t flow;           /**< flow control */
+   framing_t framing;     /**< message framing on the wire */
+   int drain;             /**< wait for output to be sent after a command */
+   int lowlatency;        /**< ask the driver for ASYNC_LOW_LATENCY */
+   unsigned int spin;     /**< usec to busy-poll before sleeping in serial_rx */
+   int asynclow;          /**< ASYNC_LOW_LATENCY was set, cleared on closing */
+   int hex;               /**< commands and responses are hex encoded */
+   int fixed;             /**< PORTSETTINGS_* given explicitly, a device
+                               config does not override them */
+   char *probe;           /**< command used to probe the baudrate */
+   char *expect;          /**< valid probe response starts with this */
+   int fd;                /**< open serial port or -1 */
+   struct termios oldtty; /**< port settings restored when closing */
+   icount_t icount;       /**< error counters when the port was opened */
+   rxbuf_t rx;            /**< received bytes not yet handed out */
+   char *tx;              /**< encoded commands not yet written */
+   size_t txlen;          /**< number of bytes in tx */
+   size_t txsize;         /**< allocated length of tx */
+   size_t rxbytes;        /**< bytes received since opening */
+   size_t txbytes;        /**< bytes transmitted since opening */
+   double rxfirst;        /**< monotonic sec of first read since serial_tx */
+   double rxlast;         /**< monotonic sec of the last read */
+   double txsent;         /**< monotonic sec the last command was written */
+   record_t* record;      /**< log of all traffic or NULL, not owned */
 } portsettings_t;
 
 /**
@@ -27,6 +104,14 @@ typedef struct {
  */
 extern portsettings_t portsettings_default(void);
 
+/**
+ * duplicate settings, without the open port and receive buffer
+ *
+ * @param[in] portsettings object to copy
+ * @return portsettings object with its own copies of all strings
+ */
+extern portsettings_t portsettings_copy(const portsettings_t* portsettings);
+
 /**
  * fancy print all port settings
  *
@@ -37,6 +122,9 @@ extern void portsettings_print(const portsettings_t* portsettings);
 /**
  * set baudrate
  *
+ * any positive rate is accepted, rates missing from the termios B* table are
+ * set through termios2 when the port is opened
+ *
  * @param[out] portsettings object in which baudrate will be updated
  * @param[in] baudrate to be parsed and validated
  * @return status 0 for succes, -1 for failure
@@ -61,15 +149,143 @@ extern int portsettings_set_port(portsettings_t* portsettings, const char* port)
  */
 extern int portsettings_set_timeout(portsettings_t* portsettings, const char* timeout);
 
+/**
+ * set time limit to the first byte of a response
+ *
+ * @param[out] portsettings object in which first will be updated
+ * @param[in] str positive sec
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_first(portsettings_t* portsettings, const char* str);
+
+/**
+ * set time limit between two bytes of a response
+ *
+ * @param[out] portsettings object in which gap will be updated
+ * @param[in] str positive sec
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_gap(portsettings_t* portsettings, const char* str);
+
+/**
+ * set time limit of a whole response
+ *
+ * @param[out] portsettings object in which total will be updated
+ * @param[in] str positive sec
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_total(portsettings_t* portsettings, const char* str);
+
+/**
+ * effective receive time limits
+ *
+ * @param[in] portsettings object, unset first and gap fall back to timeout
+ * @return limits of a response
+ */
+extern timing_t portsettings_timing(const portsettings_t* portsettings);
+
 /**
  * set count
  *
  * @param[out] portsettings object in which count will be updated
- * @param[in] count string containing a positive int value or -1 (not 0)
+ * @param[in] count string containing a positive int value, -1 for no limit
+ *                  or 0 to not wait for a response
  * @return status 0 for succes, -1 for failure
  */
 extern int portsettings_set_count(portsettings_t* portsettings, const char* str);
 
+/**
+ * set line delimiter of received data
+ *
+ * @param[out] portsettings object in which delimiter will be updated
+ * @param[in] str "lf", "cr", "crlf", a single character or "0x.." byte
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_delimiter(portsettings_t* portsettings, const char* str);
+
+/**
+ * set line terminator appended to commands
+ *
+ * @param[out] portsettings object in which terminator will be updated
+ * @param[in] str "cr", "lf", "crlf", "none", a single character or "0x.." byte
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_terminator(portsettings_t* portsettings, const char* str);
+
+/**
+ * set number of data bits per character
+ *
+ * @param[out] portsettings object in which databits will be updated
+ * @param[in] str 5, 6, 7 or 8
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_databits(portsettings_t* portsettings, const char* str);
+
+/**
+ * set parity
+ *
+ * @param[out] portsettings object in which parity will be updated
+ * @param[in] str "none", "even", "odd", "mark" or "space"
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_parity(portsettings_t* portsettings, const char* str);
+
+/**
+ * set number of stop bits
+ *
+ * @param[out] portsettings object in which stopbits will be updated
+ * @param[in] str 1 or 2
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_stopbits(portsettings_t* portsettings, const char* str);
+
+/**
+ * set flow control
+ *
+ * @param[out] portsettings object in which flow will be updated
+ * @param[in] str "none", "rtscts" or "xonxoff"
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_flow(portsettings_t* portsettings, const char* str);
+
+/**
+ * set framing
+ *
+ * binary framings imply hex encoded commands and responses
+ *
+ * @param[out] portsettings object in which framing will be updated
+ * @param[in] str "line", "cobs", "slip" or "length"
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_framing(portsettings_t* portsettings, const char* str);
+
+/**
+ * set busy-poll period
+ *
+ * @param[out] portsettings object in which spin will be updated
+ * @param[in] str usec to poll for input before sleeping, 0 to always sleep
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_spin(portsettings_t* portsettings, const char* str);
+
+/**
+ * set auto-baud probe command
+ *
+ * @param[out] portsettings object in which probe will be updated
+ * @param[in] str command transmitted at every candidate baudrate
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_probe(portsettings_t* portsettings, const char* str);
+
+/**
+ * set expected auto-baud probe response
+ *
+ * @param[out] portsettings object in which expect will be updated
+ * @param[in] str prefix of a valid response
+ * @return status 0 for succes, -1 for failure
+ */
+extern int portsettings_set_expect(portsettings_t* portsettings, const char* str);
+
 /**
  * free allocated memory
  *
@@ -0,0 +1,40 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : realtime.h
+ */
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+/*
+ * kept apart on purpose: cpu affinity needs _GNU_SOURCE, which is not
+ * defined for the rest of the program
+ */
+
+/**
+ * pin the calling process to a single cpu
+ *
+ * @param[in] cpu cpu number
+ * @return status 0 for succes, -1 for failure with errno set
+ */
+extern int realtime_pin(int cpu);
+
+/**
+ * run the calling process under the SCHED_FIFO real-time policy
+ *
+ * @param[in] priority 1 to 99
+ * @return status 0 for succes, -1 for failure with errno set
+ */
+extern int realtime_fifo(int priority);
+
+/**
+ * lock current and future memory so page faults do not stall a response
+ *
+ * @return status 0 for succes, -1 for failure with errno set
+ */
+extern int realtime_lock(void);
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,90 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : record.h
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/**
+ * size of the in-memory buffer, written to the log once full
+ */
+#define RECORD_BUFFER (64 * 1024)
+
+/**
+ * type of a log entry
+ *
+ * the log starts with the magic "TRXREC1\n" followed by entries of a type
+ * byte, the nsec elapsed since the previous entry and the data length as
+ * LEB128 varints, and the data; every run appends a RECORD_START entry that
+ * holds the absolute CLOCK_MONOTONIC nsec instead of a delta and no data
+ */
+typedef enum {
+    RECORD_START = 'S',   /**< start of a run */
+    RECORD_TX = 'T',      /**< bytes handed to the port */
+    RECORD_RX = 'R',      /**< bytes returned by one read() of the port */
+} record_type_t;
+
+/**
+ * append-only log of all traffic on a port
+ */
+typedef struct record_t {
+    int fd;               /**< open log file */
+    uint64_t last;        /**< monotonic nsec of the previous entry */
+    char* buf;            /**< entries not yet written */
+    size_t len;           /**< bytes used in buf */
+} record_t;
+
+/**
+ * open (append to) log file and start a new run
+ *
+ * @param[out] record object to initialize
+ * @param[in] path log file, created when missing
+ * @return status 0 for succes, -1 for failure
+ */
+extern int record_open(record_t* record, const char* path);
+
+/**
+ * append an entry stamped with the current time
+ *
+ * @param[in,out] record open log
+ * @param[in] type RECORD_TX or RECORD_RX
+ * @param[in] iov captured bytes, gathered into a single entry
+ * @param[in] iovcnt length of iov
+ * @return status 0 for succes, -1 for failure
+ */
+extern int record_write(record_t* record, record_type_t type,
+        const struct iovec* iov, int iovcnt);
+
+/**
+ * write buffered entries and close log
+ *
+ * @param[in] record all dyn. allocated memory in this object to be freed
+ * @return status 0 for succes, -1 for failure
+ */
+extern int record_close(record_t* record);
+
+/**
+ * act as the recorded device on a pseudo-terminal
+ *
+ * prints the path of the pty on stdout; every recorded transmission is
+ * awaited from the client after which the recorded receptions that follow it
+ * are written with their original delay, divided by speed
+ *
+ * @param[in] path log file
+ * @param[in] speed time scale, 2 replays twice as fast, 0 without delays
+ * @param[in] killed flag set asynchronously to stop the replay
+ * @return status 0 for succes, -1 for failure
+ */
+extern int record_replay(const char* path, double speed,
+        volatile sig_atomic_t* killed);
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,107 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : registry.h
+ */
+
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stddef.h>
+
+#include "../include/portsettings.h"
+
+/**
+ * compiled index of all device config files
+ *
+ * every "<name>.conf" in $XDG_CONFIG_HOME/trx, ~/.trx and /etc/trx defines
+ * device <name>, every "[<name>]" section in such a file defines one more
+ * device that inherits the settings above the first section; the first
+ * definition found wins
+ *
+ * the index is a hash table kept in $XDG_CACHE_HOME/trx/registry that is
+ * memory-mapped and rebuilt when a config directory or file has changed
+ */
+typedef struct registry_t {
+    char* map;             /**< index, mapped or allocated */
+    size_t size;           /**< length of map */
+    int mapped;            /**< map is to be unmapped rather than freed */
+} registry_t;
+
+/**
+ * called for every setting of a device
+ *
+ * @param[in,out] portsettings settings to update
+ * @param[in] key setting name
+ * @param[in] value rest of the line, stripped of surrounding whitespace
+ * @return status 0 for succes, -1 for failure
+ */
+typedef int (*registry_apply_t)(portsettings_t* portsettings, const char* key,
+        const char* value);
+
+/**
+ * called for every device that matches a pattern
+ *
+ * @param[in] name device name, valid until the registry is closed
+ * @param[in,out] arg passed through from registry_match()
+ * @return status 0 for succes, -1 to stop
+ */
+typedef int (*registry_each_t)(const char* name, void* arg);
+
+/**
+ * open the index, it is rebuilt when stale
+ *
+ * an index that can not be saved is still built and used in memory
+ *
+ * @param[out] registry object to initialize
+ * @return status 0 for succes, -1 for failure
+ */
+extern int registry_open(registry_t* registry);
+
+/**
+ * apply the settings of a device
+ *
+ * @param[in] registry open index
+ * @param[in] name device name
+ * @param[in] apply callback for every setting
+ * @param[in,out] portsettings settings passed to apply
+ * @return 1 if found, 0 if unknown, -1 if a setting was rejected
+ */
+extern int registry_find(const registry_t* registry, const char* name,
+        registry_apply_t apply, portsettings_t* portsettings);
+
+/**
+ * list the devices whose name matches a shell wildcard pattern
+ *
+ * devices are listed in order of definition
+ *
+ * @param[in] registry open index
+ * @param[in] pattern fnmatch(3) pattern, eg "psu-*"
+ * @param[in] each callback for every matching device
+ * @param[in,out] arg passed to each
+ * @return number of matches or -1 if each failed
+ */
+extern int registry_match(const registry_t* registry, const char* pattern,
+        registry_each_t each, void* arg);
+
+/**
+ * apply the settings of a single config file outside the registry
+ *
+ * @param[in] path config file, settings below a section are ignored
+ * @param[in] apply callback for every setting
+ * @param[in,out] portsettings settings passed to apply
+ * @return status 0 for succes, -1 for failure
+ */
+extern int registry_read(const char* path, registry_apply_t apply,
+        portsettings_t* portsettings);
+
+/**
+ * unmap or free the index
+ *
+ * @param[in] registry all dyn. allocated memory in this object to be freed
+ */
+extern void registry_close(registry_t* registry);
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,107 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : rxbuf.h
+ */
+
+#ifndef RXBUF_H
+#define RXBUF_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * receive buffer that splits a raw byte stream into lines
+ *
+ * bytes are appended at tail and lines are handed out from head as slices
+ * into the buffer itself; consumed space is reclaimed by moving the
+ * (incomplete) remainder to the front, so a line is always contiguous and
+ * may be of any length
+ */
+typedef struct rxbuf_t {
+    char* data;           /**< allocated buffer */
+    size_t size;          /**< allocated length of data */
+    size_t head;          /**< start of first unconsumed byte */
+    size_t tail;          /**< end of received bytes */
+    size_t scan;          /**< bytes from head known not to hold a delimiter */
+} rxbuf_t;
+
+/**
+ * line delimiter as configured per device
+ */
+typedef struct delimiter_t {
+    char bytes[2];        /**< delimiter sequence */
+    size_t len;           /**< 1 or 2 */
+    int trim;             /**< strip a CR before LF or an LF after CR */
+} delimiter_t;
+
+/**
+ * parse delimiter setting
+ *
+ * @param[out] delimiter object to be set
+ * @param[in] str "lf", "cr", "crlf", a single character or a byte as "0x.."
+ * @return status 0 for succes, -1 for failure
+ */
+extern int rxbuf_parse_delimiter(delimiter_t* delimiter, const char* str);
+
+/**
+ * append at most one read() worth of bytes from fd
+ *
+ * @param[in,out] rxbuf buffer, grown when a line does not fit
+ * @param[in] fd file descriptor to read from
+ * @return number of bytes read, 0 on end of file, -1 on failure
+ */
+extern ssize_t rxbuf_fill(rxbuf_t* rxbuf, int fd);
+
+/**
+ * append bytes received by other means than rxbuf_fill()
+ *
+ * @param[in,out] rxbuf buffer, grown when the bytes do not fit
+ * @param[in] data received bytes
+ * @param[in] len length of data
+ * @return status 0 for succes, -1 for failure
+ */
+extern int rxbuf_append(rxbuf_t* rxbuf, const char* data, size_t len);
+
+/**
+ * take next complete line from buffer
+ *
+ * the delimiter is replaced by a null character so the slice can be used as
+ * a string; it remains valid until the next rxbuf_fill()
+ *
+ * @param[in,out] rxbuf buffer
+ * @param[in] delimiter line delimiter
+ * @param[out] line start of line
+ * @param[out] len length of line excluding delimiter
+ * @return 1 if a line was taken, 0 if no complete line is buffered
+ */
+extern int rxbuf_line(rxbuf_t* rxbuf, const delimiter_t* delimiter,
+        char** line, size_t* len);
+
+/**
+ * take raw bytes from the buffer instead of lines
+ *
+ * @param[in,out] rxbuf buffer
+ * @param[out] buf destination
+ * @param[in] len max bytes to take
+ * @return number of bytes taken, 0 if the buffer is empty
+ */
+extern size_t rxbuf_take(rxbuf_t* rxbuf, char* buf, size_t len);
+
+/**
+ * discard all buffered bytes
+ *
+ * @param[in,out] rxbuf buffer to empty
+ */
+extern void rxbuf_reset(rxbuf_t* rxbuf);
+
+/**
+ * free allocated memory
+ *
+ * @param[in] rxbuf all dyn. allocated memory in this object to be freed
+ */
+extern void rxbuf_die(rxbuf_t* rxbuf);
+
+#endif
+
+// vim:ft=c
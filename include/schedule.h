@@ -0,0 +1,106 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : schedule.h
+ */
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * command polled at a fixed period
+ */
+typedef struct task_t {
+    char* cmd;            /**< command, owned */
+    uint64_t period;      /**< nsec between releases */
+    uint64_t due;         /**< CLOCK_MONOTONIC nsec of the next release */
+    size_t runs;          /**< number of releases run */
+    size_t missed;        /**< releases skipped because they were overdue */
+    uint64_t jitter;      /**< sum of nsec runs started late */
+    uint64_t maxjitter;   /**< largest nsec a run started late */
+    char* last;           /**< previous response */
+    size_t lastlen;       /**< length of last */
+    int seen;             /**< last holds a response */
+} task_t;
+
+/**
+ * periodic commands on one port
+ *
+ * releases follow a fixed grid of start + k * period so lateness never
+ * accumulates; the earliest release runs first and releases that collide
+ * go to the task with the shortest period
+ */
+typedef struct schedule_t {
+    task_t* tasks;        /**< array of tasks */
+    size_t n;             /**< length of tasks */
+    uint64_t start;       /**< CLOCK_MONOTONIC nsec of the first release */
+} schedule_t;
+
+/**
+ * parse period with unit
+ *
+ * @param[out] nsec period in nsec
+ * @param[in] str number followed by "us", "ms", "s", "min" or "h", sec when
+ *            no unit is given
+ * @return status 0 for succes, -1 for failure
+ */
+extern int schedule_parse_period(uint64_t* nsec, const char* str);
+
+/**
+ * read "<period> <command>" lines
+ *
+ * @param[out] schedule object to initialize
+ * @param[in] path schedule file, comments and empty lines are skipped
+ * @return status 0 for succes, -1 for failure
+ */
+extern int schedule_load(schedule_t* schedule, const char* path);
+
+/**
+ * sleep until the next release is due
+ *
+ * @param[in,out] schedule tasks, all released at once on the first call
+ * @return task to run or NULL when interrupted by a signal
+ */
+extern task_t* schedule_next(schedule_t* schedule);
+
+/**
+ * account for the start of a run and move the task to its next release
+ *
+ * releases that have passed entirely are counted as missed and skipped
+ *
+ * @param[in,out] task task that is about to run
+ */
+extern void schedule_start(task_t* task);
+
+/**
+ * compare response with the previous one of the task and keep it
+ *
+ * @param[in,out] task task that was run
+ * @param[in] response received lines in any encoding
+ * @param[in] len length of response
+ * @return 1 if it differs from the previous response or is the first one
+ */
+extern int schedule_changed(task_t* task, const char* response, size_t len);
+
+/**
+ * print runs, missed releases and jitter of every task
+ *
+ * @param[in] schedule tasks
+ * @param[in] stream output stream
+ */
+extern void schedule_print(const schedule_t* schedule, FILE* stream);
+
+/**
+ * free allocated memory
+ *
+ * @param[in] schedule all dyn. allocated memory in this object to be freed
+ */
+extern void schedule_die(schedule_t* schedule);
+
+#endif
+
+// vim:ft=c
@@ -11,45 +11,202 @@
 
 #include "../include/portsettings.h"
 
+/**
+ * queued commands are written once this many bytes are buffered
+ */
+#define SERIAL_BURST 4096
+
 /**
  * initialize serial port, open file and set connection properties
  *
- * @param[in] portsettings struct containing all settings
+ * @param[in,out] portsettings struct containing all settings, receives the
+ *                 open file descriptor and the original port settings
+ * @return status 0 for succes, -1 for failure
+ */
+extern int serial_init(portsettings_t* portsettings);
+
+/*
+ * change baudrate of an open port and discard pending data
+ *
+ * @param[in,out] portsettings struct containing all settings
+ * @param[in] baudrate bits per second, standard or not
+ * @return status 0 for succes, -1 for failure
+ */
+extern int serial_set_baudrate(portsettings_t* portsettings,
+        unsigned int baudrate);
+
+/*
+ * find the fastest baudrate at which the device answers the probe command
+ *
+ * candidates are tried from fast to slow, a response is valid when it starts
+ * with the expected text or, without one, is a non-empty printable line
+ *
+ * @param[in,out] portsettings open port, baudrate is set to the result
+ * @param[in] timeout sec to wait for a response at every rate, 0 for a
+ *            default of 0.2
  * @return status 0 for succes, -1 for failure
  */
-extern int serial_init(const portsettings_t* portsettings);
+extern int serial_autobaud(portsettings_t* portsettings, double timeout);
 
 /*
  * transmit string on intialized port
  *
- * blocks until entire command has been sent
+ * blocks until entire command has been handed to the driver, and until it
+ * has been sent when the port is configured to drain
+ * previously queued commands are sent first
+ * with hex set the command is hexadecimal text, binary framings encode the
+ * command into a frame instead of terminating it by CR
+ *
+ * @param[in,out] portsettings struct containing all settings
+ * @param[in] command this string will be transmitted
+ * @return status 0 for succes, -1 for failure
+ */
+extern int serial_tx(portsettings_t* portsettings, const char* command);
+
+/*
+ * transmit raw bytes as they are, without terminator or framing
+ *
+ * queued commands are sent first, the port is not drained
+ *
+ * @param[in,out] portsettings struct containing all settings
+ * @param[in] data bytes to be transmitted
+ * @param[in] len length of data
+ * @return status 0 for succes, -1 for failure
+ */
+extern int serial_write(portsettings_t* portsettings, const void* data,
+        size_t len);
+
+/*
+ * append command to the transmit buffer without sending it
+ *
+ * the buffer is flushed by the next serial_tx(), serial_flush() or once
+ * SERIAL_BURST bytes are queued, packing many commands into few writes
+ *
+ * @param[in,out] portsettings struct containing all settings
+ * @param[in] command this string will be transmitted
+ * @return status 0 for succes, -1 for failure
+ */
+extern int serial_queue(portsettings_t* portsettings, const char* command);
+
+/*
+ * transmit all queued commands
+ *
+ * @param[in,out] portsettings struct containing all settings
+ * @return status 0 for succes, -1 for failure
+ */
+extern int serial_flush(portsettings_t* portsettings);
+
+/*
+ * append command to the transmit buffer for an asynchronous writer
+ *
+ * never writes, the encoded bytes are taken out by serial_take(); starts the
+ * response to the command, with the transmission provisionally dated now
  *
- * @param[in] portsettings struct containing all settings
+ * @param[in,out] portsettings struct containing all settings
  * @param[in] command this string will be transmitted
  * @return status 0 for succes, -1 for failure
  */
-extern int serial_tx(const portsettings_t* portsettings, const char* command);
+extern int serial_encode(portsettings_t* portsettings, const char* command);
+
+/*
+ * move encoded bytes out of the transmit buffer to be written elsewhere
+ *
+ * @param[in,out] portsettings struct containing all settings
+ * @param[out] buf destination
+ * @param[in] size max bytes to move
+ * @return bytes moved
+ */
+extern size_t serial_take(portsettings_t* portsettings, char* buf,
+        size_t size);
+
+/*
+ * date the transmission of the bytes taken by serial_take()
+ *
+ * @param[in,out] portsettings struct containing all settings
+ */
+extern void serial_sent(portsettings_t* portsettings);
+
+/*
+ * account for bytes read from the port by an asynchronous reader
+ *
+ * @param[in,out] portsettings struct containing all settings and rx buffer
+ * @param[in] data received bytes
+ * @param[in] len length of data
+ * @return status 0 for succes, -1 for failure
+ */
+extern int serial_received(portsettings_t* portsettings, const char* data,
+        size_t len);
+
+/**
+ * deadline of the next byte of the response in progress
+ *
+ * @param[in] portsettings port with the times of the last transmission and
+ *            of the first and last read since
+ * @param[in] timing receive time limits
+ * @return CLOCK_MONOTONIC sec
+ */
+extern double serial_deadline(const portsettings_t* portsettings,
+        const timing_t* timing);
 
 /*
  * receive line on serial port
  *
- * blocks until line is read or timeout has passed
+ * blocks until line is read or a deadline has passed: the first byte is due
+ * timing->first after the last transmission, every next byte timing->gap
+ * after the previous read and, when set, the response ends timing->total
+ * after the transmission; all on CLOCK_MONOTONIC
+ * lines already buffered by a previous read are returned without blocking
  * line delimiter is excluded and string is null-terminated
- * a timeout returns empty string with status 0
+ * a timeout sets line to NULL with status 0
  *
- * @param[in] portsettings struct containing all settings
- * @param[out] buffer buffer used to write received line
+ * @param[in,out] portsettings struct containing all settings and rx buffer
+ * @param[out] line slice into receive buffer, valid until next receive
+ * @param[out] len length of line
+ * @param[in] timing receive time limits
  * @return status 0 for succes, -1 for failure
  */
-extern int serial_rx(const portsettings_t* portsettings, char *buffer, size_t length);
+extern int serial_rx(portsettings_t* portsettings, char** line, size_t* len,
+        const timing_t* timing);
+
+/*
+ * read bytes that are available on the port into the receive buffer
+ *
+ * does not block when used after the port was reported readable
+ *
+ * @param[in,out] portsettings struct containing all settings and rx buffer
+ * @return status 0 for succes, -1 for failure or hangup
+ */
+extern int serial_read(portsettings_t* portsettings);
+
+/*
+ * check for received bytes that were not taken yet, without waiting
+ *
+ * @param[in] portsettings struct containing all settings and rx buffer
+ * @return 1 if bytes are buffered or the port is readable, 0 otherwise
+ */
+extern int serial_pending(const portsettings_t* portsettings);
+
+/*
+ * take next buffered line without reading from the port
+ *
+ * with a binary framing this is the decoded payload of the next frame,
+ * malformed frames are reported and skipped
+ *
+ * @param[in,out] portsettings struct containing all settings and rx buffer
+ * @param[out] line slice into receive buffer, valid until next read
+ * @param[out] len length of line
+ * @return 1 if a line was taken, 0 if no complete line is buffered
+ */
+extern int serial_line(portsettings_t* portsettings, char** line, size_t* len);
 
 /*
  * free used resources
- * reset serial port settings
+ * transmit queued commands and reset serial port settings
  *
+ * @param[in,out] portsettings port to be restored and closed
  * @return status 0 for succes, -1 for failure
  */
-extern int serial_die(void);
+extern int serial_die(portsettings_t* portsettings);
 
 #endif
 
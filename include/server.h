@@ -0,0 +1,85 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : server.h
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <signal.h>
+#include <stddef.h>
+
+#include "../include/rxbuf.h"
+#include "../include/session.h"
+
+/**
+ * connection of a client to a running server
+ *
+ * requests are single lines "<command>\n", a line "@<device>\n" selects the
+ * device for the commands that follow; the server replies with COBS framed
+ * records of which the first byte is the type: 'L' response line, 'E' end of
+ * response, 'T' end of response by timeout or '!' error message
+ */
+typedef struct server_conn_t {
+    int fd;               /**< connected socket */
+    rxbuf_t rx;           /**< received records */
+} server_conn_t;
+
+/**
+ * called for every response line received from the server
+ *
+ * @param[in] cmd command the line responds to
+ * @param[in] line response line, formatted as the server would print it
+ * @param[in] len length of line
+ */
+typedef void (*server_reply_t)(const char* cmd, const char* line, size_t len);
+
+/**
+ * keep the ports of all sessions open and serve requests of local clients
+ * from a single epoll loop until killed
+ *
+ * the commands of all clients are queued per port and transmitted in order
+ * of arrival; a port that fails is reopened with the next request
+ *
+ * @param[in] path path of the unix domain socket to listen on
+ * @param[in,out] sessions array of initialized sessions without commands
+ * @param[in] n length of sessions
+ * @param[in] killed flag set asynchronously to stop the server
+ * @return status 0 for succes, -1 for failure
+ */
+extern int server_run(const char* path, session_t* sessions, size_t n,
+        volatile sig_atomic_t* killed);
+
+/**
+ * connect to a running server
+ *
+ * @param[out] conn connection to initialize
+ * @param[in] path path of the unix domain socket
+ * @param[in] device name of device to send commands to, NULL for the first
+ * @return status 0 for succes, -1 for failure
+ */
+extern int server_connect(server_conn_t* conn, const char* path,
+        const char* device);
+
+/**
+ * send command to the server and wait for its response
+ *
+ * @param[in,out] conn connection to the server
+ * @param[in] cmd command
+ * @param[in] reply callback for every response line
+ * @return status 0 for succes, -1 for failure
+ */
+extern int server_request(server_conn_t* conn, const char* cmd,
+        server_reply_t reply);
+
+/**
+ * close connection and free allocated memory
+ *
+ * @param[in] conn all dyn. allocated memory in this object to be freed
+ */
+extern void server_close(server_conn_t* conn);
+
+#endif
+
+// vim:ft=c
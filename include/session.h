@@ -0,0 +1,148 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : session.h
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "../include/portsettings.h"
+
+/**
+ * queued command
+ */
+typedef struct session_cmd_t {
+    char* cmd;                   /**< command, owned */
+    void* tag;                   /**< opaque owner of the command */
+} session_cmd_t;
+
+/**
+ * one serial device served by the multi-port event loop
+ */
+typedef struct session_t {
+    char* name;                  /**< device name, used to tag responses */
+    portsettings_t portsettings; /**< settings and open port */
+    session_cmd_t* queue;        /**< commands to be transmitted */
+    size_t queued;               /**< number of commands in queue */
+    size_t size;                 /**< allocated length of queue */
+    size_t next;                 /**< index of next command to transmit */
+    const char* cmd;             /**< command awaiting response or NULL */
+    void* tag;                   /**< tag of cmd */
+    unsigned int received;       /**< lines received in response to cmd */
+    struct timespec deadline;    /**< CLOCK_MONOTONIC timeout of cmd */
+    size_t done;                 /**< commands finished */
+    size_t timeouts;             /**< commands finished by their deadline */
+    int failed;                  /**< port could not be opened or failed */
+    int uring;                   /**< transmission is left to the io_uring
+                                      loop, unless the port drains */
+} session_t;
+
+/**
+ * called for every received line and once more with line NULL when a command
+ * is finished; it timed out when fewer than count lines were received
+ *
+ * @param[in] session device the line was received on
+ * @param[in] cmd command the line is a response to
+ * @param[in] line null-terminated response line or NULL
+ * @param[in] len length of line
+ */
+typedef void (*session_output_t)(const session_t* session, const char* cmd,
+        const char* line, size_t len);
+
+/**
+ * initialize session with a copy of the given settings
+ *
+ * @param[out] session object to initialize
+ * @param[in] name device name used to tag responses
+ * @param[in] portsettings defaults, strings are duplicated
+ */
+extern void session_init(session_t* session, const char* name,
+        const portsettings_t* portsettings);
+
+/**
+ * append command to the transmit queue of a session
+ *
+ * @param[in,out] session session to append to
+ * @param[in] cmd command, will be copied
+ * @param[in] tag handed back as session->tag while cmd is served
+ * @return status 0 for succes, -1 for failure
+ */
+extern int session_queue(session_t* session, const char* cmd, void* tag);
+
+/**
+ * transmit the next queued commands if none is awaiting a response
+ *
+ * @param[in,out] session session with open port
+ * @param[in] output callback for commands that expect no response
+ */
+extern void session_advance(session_t* session, session_output_t output);
+
+/**
+ * read from the port and hand out the received lines
+ *
+ * when the port fails it is closed and every queued command is finished
+ *
+ * @param[in,out] session session whose port is readable
+ * @param[in] output callback for every received line
+ * @return status 0 for succes, -1 for failure
+ */
+extern int session_receive(session_t* session, session_output_t output);
+
+/**
+ * finish the command in flight if its deadline has passed
+ *
+ * @param[in,out] session session to check
+ * @param[in] now current CLOCK_MONOTONIC time
+ * @param[in] output callback for every finished command
+ */
+extern void session_expire(session_t* session, const struct timespec* now,
+        session_output_t output);
+
+/**
+ * milliseconds until the earliest deadline, rounded up
+ *
+ * @param[in] sessions array of sessions
+ * @param[in] n length of sessions
+ * @return timeout for epoll_wait, -1 when nothing is in flight
+ */
+extern int session_timeout(const session_t* sessions, size_t n);
+
+/**
+ * open the ports and serve them from a single epoll loop until every queue
+ * is empty
+ *
+ * transmission and reception are interleaved across devices so the total
+ * run time approaches that of the slowest device; a port is closed as soon
+ * as its queue is empty, which makes room for the next when jobs is set
+ *
+ * with uring set, reads, writes and the earliest deadline of all ports are
+ * submitted to an io_uring as batches of requests on registered buffers, so
+ * a single system call serves every port; epoll is used when the kernel
+ * does not provide io_uring
+ *
+ * @param[in,out] sessions array of initialized sessions
+ * @param[in] n length of sessions
+ * @param[in] jobs max ports open at once, 0 for all
+ * @param[in] uring use io_uring instead of epoll
+ * @param[in] output callback for every received line
+ * @param[in] killed flag set asynchronously to abort the loop
+ * @return status 0 for succes, -1 for failure
+ */
+extern int session_run(session_t* sessions, size_t n, size_t jobs, int uring,
+        session_output_t output, volatile sig_atomic_t* killed);
+
+/**
+ * close port and free allocated memory
+ *
+ * @param[in] session all dyn. allocated memory in this object to be freed
+ */
+extern void session_die(session_t* session);
+
+#endif
+
+// vim:ft=c
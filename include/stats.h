@@ -0,0 +1,96 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : stats.h
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * max length of command prefix, including null character
+ */
+#define STATS_PREFIX 32
+
+/**
+ * measurements of a single command
+ */
+typedef struct sample_t {
+    double tx;                    /**< sec to transmit, including drain */
+    double first;                 /**< sec from transmit to first byte, <0 if none */
+    double total;                 /**< sec from transmit to last line, <0 if none */
+    size_t bytes;                 /**< bytes received */
+    unsigned int lines;           /**< lines received */
+    int timeout;                  /**< response was cut short by the timeout */
+} sample_t;
+
+/**
+ * growable array of durations
+ */
+typedef struct series_t {
+    double* v;                    /**< samples in sec */
+    size_t n;                     /**< number of samples */
+    size_t size;                  /**< allocated length of v */
+} series_t;
+
+/**
+ * statistics of all commands sharing a prefix
+ */
+typedef struct stats_cmd_t {
+    char prefix[STATS_PREFIX];    /**< first word of the command */
+    series_t tx;                  /**< transmit durations */
+    series_t first;               /**< first byte latencies */
+    series_t total;               /**< response times */
+    size_t count;                 /**< commands sent */
+    size_t bytes;                 /**< bytes received */
+    size_t lines;                 /**< lines received */
+    size_t timeouts;              /**< responses cut short by the timeout */
+} stats_cmd_t;
+
+/**
+ * statistics of a run
+ */
+typedef struct stats_t {
+    stats_cmd_t* entries;         /**< one entry per command prefix */
+    size_t n;                     /**< length of entries */
+    double start;                 /**< CLOCK_MONOTONIC sec of first command */
+    double end;                   /**< CLOCK_MONOTONIC sec of last sample */
+    size_t txbytes;               /**< bytes transmitted */
+} stats_t;
+
+/**
+ * add the measurements of a command
+ *
+ * @param[in,out] stats statistics to update
+ * @param[in] cmd command, grouped by its first word
+ * @param[in] sample measurements
+ * @param[in] start CLOCK_MONOTONIC sec the command was transmitted
+ * @param[in] end CLOCK_MONOTONIC sec the response ended
+ * @return status 0 for succes, -1 for failure
+ */
+extern int stats_add(stats_t* stats, const char* cmd, const sample_t* sample,
+        double start, double end);
+
+/**
+ * print p50/p90/p99/max of every measurement per command and the
+ * aggregate throughput
+ *
+ * @param[in] stats statistics, samples are sorted in place
+ * @param[in] stream stream to print to
+ * @param[in] json print a single json object instead of a table
+ */
+extern void stats_print(stats_t* stats, FILE* stream, int json);
+
+/**
+ * free allocated memory
+ *
+ * @param[in] stats all dyn. allocated memory in this object to be freed
+ */
+extern void stats_die(stats_t* stats);
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,181 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : uring.h
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <time.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * io_uring instance driven through the raw system calls
+ *
+ * requests are prepared in the submission ring and handed to the kernel in a
+ * single uring_submit(), which also waits for completions
+ */
+typedef struct uring_t {
+    int fd;                       /**< ring file descriptor or -1 */
+    unsigned int* sq_head;        /**< consumed by the kernel */
+    unsigned int* sq_tail;        /**< produced by us */
+    unsigned int* sq_mask;        /**< ring index mask */
+    unsigned int* sq_array;       /**< indices into sqes */
+    struct io_uring_sqe* sqes;    /**< submission entries */
+    unsigned int* cq_head;        /**< consumed by us */
+    unsigned int* cq_tail;        /**< produced by the kernel */
+    unsigned int* cq_mask;        /**< ring index mask */
+    struct io_uring_cqe* cqes;    /**< completion entries */
+    void* sq_ring;                /**< mapped submission ring */
+    size_t sq_size;               /**< length of sq_ring */
+    void* cq_ring;                /**< mapped completion ring, may be sq_ring */
+    size_t cq_size;               /**< length of cq_ring */
+    size_t sqes_size;             /**< length of sqes */
+    unsigned int pending;         /**< prepared, not yet submitted */
+    int64_t ts[2];                /**< timespec of the prepared timeout */
+} uring_t;
+
+/**
+ * set up ring
+ *
+ * @param[out] uring object to initialize
+ * @param[in] entries submission ring size, a power of 2
+ * @return status 0 for succes, -1 with errno set when io_uring is not
+ *         available, eg ENOSYS or EPERM
+ */
+extern int uring_init(uring_t* uring, unsigned int entries);
+
+/**
+ * register fixed buffers for uring_read_fixed() and uring_write_fixed()
+ *
+ * @param[in,out] uring ring
+ * @param[in] iov buffers, indexed in order
+ * @param[in] n length of iov
+ * @return status 0 for succes, -1 for failure
+ */
+extern int uring_register(uring_t* uring, const struct iovec* iov,
+        unsigned int n);
+
+/**
+ * prepare read into a registered buffer
+ *
+ * @param[in,out] uring ring
+ * @param[in] fd file descriptor
+ * @param[in] buf start within registered buffer index
+ * @param[in] len max bytes
+ * @param[in] index registered buffer
+ * @param[in] data handed back on completion
+ * @param[in] link the next request only starts once this one succeeded
+ * @return status 0 for succes, -1 for failure
+ */
+extern int uring_read_fixed(uring_t* uring, int fd, void* buf,
+        unsigned int len, unsigned int index, uint64_t data, int link);
+
+/**
+ * prepare write from a registered buffer
+ *
+ * @param[in,out] uring ring
+ * @param[in] fd file descriptor
+ * @param[in] buf start within registered buffer index
+ * @param[in] len bytes to write
+ * @param[in] index registered buffer
+ * @param[in] data handed back on completion
+ * @param[in] link the next request only starts once this one succeeded
+ * @return status 0 for succes, -1 for failure
+ */
+extern int uring_write_fixed(uring_t* uring, int fd, const void* buf,
+        unsigned int len, unsigned int index, uint64_t data, int link);
+
+/**
+ * prepare write at the current file position
+ *
+ * @param[in,out] uring ring
+ * @param[in] fd file descriptor
+ * @param[in] buf bytes, valid until completion
+ * @param[in] len length of buf
+ * @param[in] data handed back on completion
+ * @param[in] link the next request only starts once this one succeeded
+ * @return status 0 for succes, -1 for failure
+ */
+extern int uring_write(uring_t* uring, int fd, const void* buf,
+        unsigned int len, uint64_t data, int link);
+
+/**
+ * prepare one-shot wait for readiness
+ *
+ * @param[in,out] uring ring
+ * @param[in] fd file descriptor
+ * @param[in] events POLLIN, POLLOUT
+ * @param[in] data handed back on completion with the poll events as result
+ * @param[in] link the next request only starts once this one succeeded
+ * @return status 0 for succes, -1 for failure
+ */
+extern int uring_poll(uring_t* uring, int fd, short events, uint64_t data,
+        int link);
+
+/**
+ * prepare timer that completes at an absolute CLOCK_MONOTONIC time
+ *
+ * @param[in,out] uring ring, only one timeout may be prepared per submit
+ * @param[in] deadline expiry time
+ * @param[in] data handed back on completion
+ * @return status 0 for succes, -1 for failure
+ */
+extern int uring_timeout(uring_t* uring, const struct timespec* deadline,
+        uint64_t data);
+
+/**
+ * prepare cancellation of an earlier request
+ *
+ * @param[in,out] uring ring
+ * @param[in] target data of the request to cancel
+ * @param[in] timeout target is a timeout
+ * @param[in] data handed back on completion
+ * @return status 0 for succes, -1 for failure
+ */
+extern int uring_cancel(uring_t* uring, uint64_t target, int timeout,
+        uint64_t data);
+
+/**
+ * end a chain at the last prepared request, when the requests meant to
+ * follow it could not be prepared
+ *
+ * @param[in,out] uring ring
+ */
+extern void uring_unlink(uring_t* uring);
+
+/**
+ * hand all prepared requests to the kernel in one system call
+ *
+ * @param[in,out] uring ring
+ * @param[in] wait number of completions to wait for
+ * @return status 0 for succes, -1 for failure, errno EINTR when interrupted
+ */
+extern int uring_submit(uring_t* uring, unsigned int wait);
+
+/**
+ * take the next completion
+ *
+ * @param[in,out] uring ring
+ * @param[out] data data of the completed request
+ * @param[out] res result, -errno on failure
+ * @return 1 if a completion was taken, 0 if none is available
+ */
+extern int uring_complete(uring_t* uring, uint64_t* data, int* res);
+
+/**
+ * tear down ring, pending requests are cancelled by the kernel
+ *
+ * @param[in] uring all mappings of this object are released
+ */
+extern void uring_die(uring_t* uring);
+
+#endif
+
+// vim:ft=c
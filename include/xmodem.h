@@ -0,0 +1,82 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : xmodem.h
+ */
+
+#ifndef XMODEM_H
+#define XMODEM_H
+
+#include <signal.h>
+#include <stddef.h>
+
+#include "../include/portsettings.h"
+
+/**
+ * largest block payload
+ */
+#define XMODEM_BLOCK 1024
+
+/**
+ * bulk transfer protocol
+ *
+ * the sender follows what the receiver asks for when it starts: 'C' for
+ * CRC-16 and an ACK per block, NAK for the original 8-bit checksum or, with
+ * YMODEM, 'G' to stream all blocks without waiting for an ACK
+ */
+typedef enum {
+    XMODEM,               /**< one file in 128-byte blocks */
+    XMODEM_1K,            /**< one file in 1024-byte blocks */
+    YMODEM,               /**< batch of files in 1024-byte blocks, a header
+                               block carries the name, size and mtime */
+    YMODEM_G,             /**< YMODEM streamed, the receiver starts every
+                               file with 'G' and aborts on an error */
+} xmodem_protocol_t;
+
+/**
+ * parse protocol
+ *
+ * @param[out] protocol protocol to be set
+ * @param[in] str "xmodem", "xmodem-1k", "ymodem" or "ymodem-g"
+ * @return status 0 for succes, -1 for failure
+ */
+extern int xmodem_parse_protocol(xmodem_protocol_t* protocol, const char* str);
+
+/**
+ * send files to the receiver on the port
+ *
+ * the throughput is reported to stderr against the line rate of the
+ * configured baudrate and character format
+ *
+ * @param[in,out] portsettings open port, bytes it holds are taken first
+ * @param[in] protocol XMODEM protocols take a single file
+ * @param[in] files paths of the files
+ * @param[in] n length of files
+ * @param[in] killed flag set asynchronously by SIGINT or SIGTERM, the
+ *            transfer is then cancelled
+ * @return status 0 for succes, -1 for failure
+ */
+extern int xmodem_send(portsettings_t* portsettings,
+        xmodem_protocol_t protocol, char* const* files, size_t n,
+        volatile sig_atomic_t* killed);
+
+/**
+ * receive files from the sender on the port
+ *
+ * YMODEM files are named by their header and truncated to the size it
+ * gives, XMODEM has no size so the last block keeps its padding
+ *
+ * @param[in,out] portsettings open port, bytes it holds are taken first
+ * @param[in] protocol YMODEM_G asks the sender to stream
+ * @param[in] path file for XMODEM, directory for YMODEM
+ * @param[in] killed flag set asynchronously by SIGINT or SIGTERM, the
+ *            transfer is then cancelled
+ * @return status 0 for succes, -1 for failure
+ */
+extern int xmodem_receive(portsettings_t* portsettings,
+        xmodem_protocol_t protocol, const char* path,
+        volatile sig_atomic_t* killed);
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,28 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : baud.c
+ */
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+#include "../include/baud.h"
+
+int baud_set_custom(int fd, unsigned int baudrate)
+{
+    struct termios2 tty;
+
+    if (ioctl(fd, TCGETS2, &tty) == -1) return -1;
+
+    tty.c_cflag &= ~(tcflag_t)CBAUD;
+    tty.c_cflag |= BOTHER;
+    tty.c_ispeed = baudrate;
+    tty.c_ospeed = baudrate;
+
+    if (ioctl(fd, TCSETS2, &tty) == -1) return -1;
+
+    /* driver may round to the nearest rate its divisor can produce */
+    if (ioctl(fd, TCGETS2, &tty) == -1) return -1;
+    return tty.c_ospeed ? 0 : -1;
+}
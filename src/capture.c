@@ -0,0 +1,397 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : capture.c
+ */
+
+/* splice() and F_SETPIPE_SZ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "../include/capture.h"
+
+/**
+ * current CLOCK_MONOTONIC time
+ *
+ * @return sec
+ */
+static double now(void);
+
+/**
+ * write all bytes, retrying short writes
+ *
+ * @param[in] fd file descriptor
+ * @param[in] data bytes to write
+ * @param[in] len length of data
+ * @return status 0 for succes, -1 for failure
+ */
+static int write_all(int fd, const char* data, size_t len);
+
+/**
+ * move the bytes available on the port to the current segment
+ *
+ * @param[in,out] capture open capture
+ * @param[in] fd port, reported readable
+ * @return bytes moved, 0 if none were available or -1 for failure or hangup
+ */
+static ssize_t move(capture_t* capture, int fd);
+
+/**
+ * rename the current segment to path.N, start a new one and queue the old
+ * one for compression
+ *
+ * @param[in,out] capture open capture
+ * @return status 0 for succes, -1 for failure
+ */
+static int rotate(capture_t* capture);
+
+/**
+ * gzip file to file.gz and remove it
+ *
+ * @param[in] path uncompressed file
+ * @return status 0 for succes, -1 for failure
+ */
+static int gzip_file(const char* path);
+
+/**
+ * thread compressing the queued segments
+ *
+ * @param[in] arg capture_t object
+ * @return NULL
+ */
+static void* compressor(void* arg);
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int write_all(int fd, const char* data, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, data, len);
+        if (n == -1) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+ssize_t move(capture_t* capture, int fd)
+{
+    ssize_t n;
+
+    if (capture->pipe[0] != -1) {
+        n = splice(fd, NULL, capture->pipe[1], NULL, CAPTURE_CHUNK,
+                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+        /* the driver can not splice, fall back to reading */
+        if (n == -1 && errno == EINVAL && !capture->bytes) {
+            close(capture->pipe[0]);
+            close(capture->pipe[1]);
+            capture->pipe[0] = capture->pipe[1] = -1;
+            if (!(capture->buf = malloc(CAPTURE_CHUNK))) return -1;
+            return move(capture, fd);
+        }
+        if (n == -1) return errno == EAGAIN || errno == EINTR ? 0 : -1;
+
+        for (ssize_t left = n; left;) {
+            ssize_t m = splice(capture->pipe[0], NULL, capture->fd, NULL,
+                    (size_t)left, SPLICE_F_MOVE);
+            if (m == -1) {
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            left -= m;
+        }
+
+    } else {
+        n = read(fd, capture->buf, CAPTURE_CHUNK);
+        if (n == -1) return errno == EAGAIN || errno == EINTR ? 0 : -1;
+        if (write_all(capture->fd, capture->buf, (size_t)n) == -1) return -1;
+    }
+
+    capture->written += n;
+    capture->bytes += (size_t)n;
+    return n;
+}
+
+int gzip_file(const char* path)
+{
+    char* gz = malloc(strlen(path) + 4);
+    char* buf = malloc(CAPTURE_CHUNK);
+    gzFile out = NULL;
+    int fd = -1;
+    int status = -1;
+    ssize_t n;
+
+    if (!gz || !buf) goto end;
+    sprintf(gz, "%s.gz", path);
+
+    if ((fd = open(path, O_RDONLY)) == -1 || !(out = gzopen(gz, "wb"))) {
+        goto end;
+    }
+    while ((n = read(fd, buf, CAPTURE_CHUNK)) > 0) {
+        if (gzwrite(out, buf, (unsigned int)n) != (int)n) goto end;
+    }
+    if (n == 0) status = 0;
+
+end:
+    if (out && gzclose(out) != Z_OK) status = -1;
+    if (fd != -1) close(fd);
+    if (status == 0) {
+        unlink(path);
+    } else {
+        fprintf(stderr, "error compressing %s\n", path);
+        if (out) unlink(gz);
+    }
+    free(gz);
+    free(buf);
+    return status;
+}
+
+void* compressor(void* arg)
+{
+    capture_t* capture = arg;
+
+    pthread_mutex_lock(&capture->lock);
+    for (;;) {
+        while (!capture->used && !capture->done) {
+            pthread_cond_wait(&capture->ready, &capture->lock);
+        }
+        if (!capture->used) break;
+
+        char* path = capture->queue[capture->head];
+        capture->head = (capture->head + 1) % CAPTURE_QUEUE;
+        capture->used--;
+        pthread_mutex_unlock(&capture->lock);
+
+        gzip_file(path);
+        free(path);
+
+        pthread_mutex_lock(&capture->lock);
+    }
+    pthread_mutex_unlock(&capture->lock);
+    return NULL;
+}
+
+int rotate(capture_t* capture)
+{
+    struct stat st;
+    char* path = malloc(strlen(capture->path) + 16);
+    if (!path) return -1;
+
+    /* earlier runs may have left segments */
+    do {
+        sprintf(path, "%s.%u.gz", capture->path, ++capture->segment);
+        if (stat(path, &st) == 0) continue;
+        path[strlen(path) - 3] = '\0';
+    } while (stat(path, &st) == 0);
+
+    close(capture->fd);
+    if (rename(capture->path, path) == -1) {
+        fprintf(stderr, "error rotating %s: %s\n", capture->path,
+                strerror(errno));
+        free(path);
+        capture->fd = -1;
+        return -1;
+    }
+
+    capture->fd = open(capture->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    capture->written = 0;
+    capture->opened = now();
+    capture->rotated++;
+
+    /* never hold up reception, a full queue leaves the segment as is */
+    pthread_mutex_lock(&capture->lock);
+    if (capture->compress && capture->used < CAPTURE_QUEUE) {
+        capture->queue[(capture->head + capture->used) % CAPTURE_QUEUE] = path;
+        capture->used++;
+        pthread_cond_signal(&capture->ready);
+        path = NULL;
+    } else if (capture->compress) {
+        fprintf(stderr, "capture: compression behind, %s left as is\n", path);
+    }
+    pthread_mutex_unlock(&capture->lock);
+    free(path);
+
+    if (capture->fd == -1) {
+        fprintf(stderr, "error opening %s: %s\n", capture->path,
+                strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int capture_open(capture_t* capture, const char* path, off_t rotate_size,
+        double interval, int gzip)
+{
+    struct stat st;
+
+    memset(capture, 0, sizeof(capture_t));
+    capture->pipe[0] = capture->pipe[1] = -1;
+
+    /* splice() refuses O_APPEND, appending is done by seeking */
+    capture->fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (capture->fd == -1 || fstat(capture->fd, &st) == -1
+            || lseek(capture->fd, 0, SEEK_END) == -1) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+        if (capture->fd != -1) close(capture->fd);
+        capture->fd = -1;
+        return -1;
+    }
+    capture->written = st.st_size;
+
+    capture->path = malloc(strlen(path)+1);
+    if (!capture->path) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+        close(capture->fd);
+        capture->fd = -1;
+        return -1;
+    }
+    strcpy(capture->path, path);
+    capture->rotate = rotate_size;
+    capture->interval = interval;
+    capture->compress = gzip;
+    capture->opened = now();
+
+    /* a pipe of a whole chunk lets one splice take everything available */
+    if (pipe(capture->pipe) == -1) {
+        fprintf(stderr, "error creating pipe: %s\n", strerror(errno));
+        capture->pipe[0] = capture->pipe[1] = -1;
+        if (!(capture->buf = malloc(CAPTURE_CHUNK))) return -1;
+    } else {
+        fcntl(capture->pipe[1], F_SETPIPE_SZ, CAPTURE_CHUNK);
+    }
+
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->ready, NULL);
+
+    /* signals are left to the capturing thread */
+    if (gzip) {
+        sigset_t block, orig;
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        sigaddset(&block, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &block, &orig);
+        if (pthread_create(&capture->thread, NULL, compressor, capture) != 0) {
+            fprintf(stderr, "error starting compression thread\n");
+            capture->compress = 0;
+        }
+        pthread_sigmask(SIG_SETMASK, &orig, NULL);
+    }
+    return 0;
+}
+
+int capture_run(capture_t* capture, int fd, volatile sig_atomic_t* killed)
+{
+    sigset_t block, orig, wait;
+    double start = now();
+    int status = 0;
+
+    /* signals only arrive while waiting, so none is missed */
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigprocmask(SIG_BLOCK, &block, &orig);
+    wait = orig;
+    sigdelset(&wait, SIGINT);
+    sigdelset(&wait, SIGTERM);
+
+    while (!*killed && capture->fd != -1) {
+        struct timespec ts;
+        struct timespec* timeout = NULL;
+        fd_set fds;
+
+        if (capture->interval) {
+            double left = capture->opened + capture->interval - now();
+            if (left <= 0) {
+                if (rotate(capture) == -1) status = -1;
+                continue;
+            }
+            ts.tv_sec = (time_t)left;
+            ts.tv_nsec = (long)((left - (double)ts.tv_sec) * 1e9);
+            timeout = &ts;
+        }
+
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+        int n = pselect(fd+1, &fds, NULL, NULL, timeout, &wait);
+        if (n == -1 && errno != EINTR) {
+            fprintf(stderr, "error waiting for port: %s\n", strerror(errno));
+            status = -1;
+            break;
+        }
+        if (n <= 0) continue;
+
+        if (move(capture, fd) == -1) {
+            fprintf(stderr, "capture: %s\n", errno == EIO
+                    ? "port hung up" : strerror(errno));
+            status = -1;
+            break;
+        }
+
+        if (capture->rotate && capture->written >= capture->rotate
+                && rotate(capture) == -1) {
+            status = -1;
+        }
+    }
+
+    /* whatever the driver still holds belongs to this run */
+    while (capture->fd != -1 && status == 0 && move(capture, fd) > 0) {
+        continue;
+    }
+    sigprocmask(SIG_SETMASK, &orig, NULL);
+
+    double elapsed = now() - start;
+    fprintf(stderr, "capture: %zu bytes in %.1f sec (%.0f bytes/s), "
+            "%u segments rotated\n", capture->bytes, elapsed,
+            elapsed > 0 ? (double)capture->bytes / elapsed : 0.0,
+            capture->rotated);
+    return status;
+}
+
+int capture_close(capture_t* capture)
+{
+    int status = 0;
+
+    if (!capture->path) return 0;
+
+    if (capture->fd != -1 && close(capture->fd) == -1) status = -1;
+    capture->fd = -1;
+    if (capture->pipe[0] != -1) close(capture->pipe[0]);
+    if (capture->pipe[1] != -1) close(capture->pipe[1]);
+
+    /* finish the queued segments */
+    if (capture->compress) {
+        pthread_mutex_lock(&capture->lock);
+        capture->done = 1;
+        pthread_cond_signal(&capture->ready);
+        pthread_mutex_unlock(&capture->lock);
+        pthread_join(capture->thread, NULL);
+    }
+    pthread_mutex_destroy(&capture->lock);
+    pthread_cond_destroy(&capture->ready);
+
+    free(capture->buf);
+    free(capture->path);
+    capture->path = NULL;
+    return status;
+}
+
+// vim:ft=c
@@ -0,0 +1,744 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : columns.c
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/columns.h"
+
+/**
+ * first bytes of every log
+ */
+#define COLUMNS_MAGIC "TRXCOL1\n"
+
+/**
+ * max length of a varint
+ */
+#define VARINT_MAX 10
+
+/**
+ * significant digits of a float mantissa
+ */
+#define FLOAT_DIGITS 18
+
+/**
+ * entry types
+ */
+enum {
+    ENTRY_SCHEMA = 'H',
+    ENTRY_BLOCK = 'B',
+};
+
+/**
+ * current CLOCK_REALTIME time
+ *
+ * @return nsec since the epoch
+ */
+static int64_t realtime(void);
+
+/**
+ * append LEB128 varint
+ *
+ * @param[out] p destination, at least VARINT_MAX bytes
+ * @param[in] v value
+ * @return number of bytes used
+ */
+static size_t put_varint(char* p, uint64_t v);
+
+/**
+ * append zigzag encoded difference of two values as varint
+ *
+ * @param[out] p destination, at least VARINT_MAX bytes
+ * @param[in] v value
+ * @param[in] prev previous value
+ * @return number of bytes used
+ */
+static size_t put_delta(char* p, int64_t v, int64_t prev);
+
+/**
+ * parse LEB128 varint
+ *
+ * @param[in,out] p read position, advanced past the varint
+ * @param[in] end end of data
+ * @param[out] v value
+ * @return status 0 for succes, -1 if truncated
+ */
+static int get_varint(const unsigned char** p, const unsigned char* end,
+        uint64_t* v);
+
+/**
+ * parse zigzag encoded difference with the previous value
+ *
+ * @param[in,out] p read position, advanced past the varint
+ * @param[in] end end of data
+ * @param[in,out] v previous value, replaced by the decoded value
+ * @return status 0 for succes, -1 if truncated
+ */
+static int get_delta(const unsigned char** p, const unsigned char* end,
+        int64_t* v);
+
+/**
+ * write all bytes, retrying short writes
+ *
+ * @param[in] fd file descriptor
+ * @param[in] data bytes to write
+ * @param[in] len length of data
+ * @return status 0 for succes, -1 for failure
+ */
+static int write_all(int fd, const char* data, size_t len);
+
+/**
+ * parse one field
+ *
+ * @param[in] p first character of the field, blanks trimmed
+ * @param[in] n length of the field
+ * @param[in] type FIELD_INT, FIELD_FLOAT or FIELD_HEX
+ * @param[out] v value
+ * @return status 0 for succes, -1 if the field does not match its type
+ */
+static int parse_field(const char* p, size_t n, field_type_t type, field_t* v);
+
+/**
+ * encode the buffered rows of a table as a block and write it
+ *
+ * @param[in,out] columns open log
+ * @param[in,out] table table of which the rows are written and cleared
+ * @return status 0 for succes, -1 for failure
+ */
+static int flush_table(columns_t* columns, table_t* table);
+
+/**
+ * print decimal number exactly, in fixed notation unless the exponent is
+ * positive or very small
+ *
+ * @param[in] stream output stream
+ * @param[in] mantissa signed digits
+ * @param[in] exp decimal exponent
+ */
+static void put_decimal(FILE* stream, int64_t mantissa, int64_t exp);
+
+/**
+ * print string quoted for csv or json
+ *
+ * @param[in] stream output stream
+ * @param[in] str string
+ * @param[in] len length of str
+ * @param[in] json escape for json instead of csv
+ */
+static void put_string(FILE* stream, const char* str, size_t len, int json);
+
+int64_t realtime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + (int64_t)ts.tv_nsec;
+}
+
+size_t put_varint(char* p, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (char)v;
+    return n;
+}
+
+size_t put_delta(char* p, int64_t v, int64_t prev)
+{
+    int64_t d = (int64_t)((uint64_t)v - (uint64_t)prev);
+    return put_varint(p, ((uint64_t)d << 1) ^ (uint64_t)(d >> 63));
+}
+
+int get_varint(const unsigned char** p, const unsigned char* end, uint64_t* v)
+{
+    *v = 0;
+    for (unsigned int shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char c = *(*p)++;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return 0;
+    }
+    return -1;
+}
+
+int get_delta(const unsigned char** p, const unsigned char* end, int64_t* v)
+{
+    uint64_t u;
+    if (get_varint(p, end, &u) == -1) return -1;
+    *v = (int64_t)((uint64_t)*v + ((u >> 1) ^ -(u & 1)));
+    return 0;
+}
+
+int write_all(int fd, const char* data, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, data, len);
+        if (n == -1) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int parse_field(const char* p, size_t n, field_type_t type, field_t* v)
+{
+    const char* end = p + n;
+    uint64_t u = 0;
+
+    switch (type) {
+
+        case FIELD_INT: {
+            int neg = 0;
+            if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+            if (p == end || end - p > 19) return -1;
+            for (; p < end; p++) {
+                if (*p < '0' || *p > '9') return -1;
+                u = u * 10 + (uint64_t)(*p - '0');
+            }
+            v->i = neg ? -(int64_t)u : (int64_t)u;
+            return 0;
+        }
+
+        case FIELD_HEX:
+            if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+                p += 2;
+            }
+            if (p == end || end - p > 16) return -1;
+            for (; p < end; p++) {
+                unsigned int c = (unsigned char)*p;
+                if (c >= '0' && c <= '9') c -= '0';
+                else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+                    c = (c | 0x20) - 'a' + 10;
+                } else return -1;
+                u = u << 4 | c;
+            }
+            v->i = (int64_t)u;
+            return 0;
+
+        /* decimal mantissa and exponent, no rounding */
+        case FIELD_FLOAT: {
+            int neg = 0;
+            int dot = 0;
+            int any = 0;
+            int digits = 0;
+            int64_t exp = 0;
+            if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+            for (; p < end; p++) {
+                if (*p == '.' && !dot) {
+                    dot = 1;
+                    continue;
+                }
+                if (*p < '0' || *p > '9') break;
+                any = 1;
+                if ((u || *p != '0') && ++digits > FLOAT_DIGITS) return -1;
+                u = u * 10 + (uint64_t)(*p - '0');
+                if (dot) exp--;
+            }
+            if (!any) return -1;
+            if (p < end && (*p == 'e' || *p == 'E')) {
+                int eneg = 0;
+                int64_t e = 0;
+                if (++p < end && (*p == '-' || *p == '+')) eneg = *p++ == '-';
+                if (p == end || end - p > 4) return -1;
+                for (; p < end; p++) {
+                    if (*p < '0' || *p > '9') return -1;
+                    e = e * 10 + (*p - '0');
+                }
+                exp += eneg ? -e : e;
+            }
+            if (p != end) return -1;
+            v->i = neg ? -(int64_t)u : (int64_t)u;
+            v->exp = exp;
+            return 0;
+        }
+
+        case FIELD_SKIP:
+        default:
+            return 0;
+    }
+}
+
+int columns_add_rule(columns_t* columns, const char* value)
+{
+    const char* p = value;
+    size_t len = strcspn(p, " \t");
+    table_t* tables;
+    table_t* table;
+    char sep;
+
+    /* separator */
+    if (len == 1) sep = *p;
+    else if (len == 5 && strncmp(p, "space", 5) == 0) sep = ' ';
+    else if (len == 3 && strncmp(p, "tab", 3) == 0) sep = '\t';
+    else goto invalid;
+    p += len;
+    p += strspn(p, " \t");
+
+    tables = realloc(columns->tables, (columns->n+1) * sizeof(table_t));
+    if (!tables) return -1;
+    columns->tables = tables;
+    table = &columns->tables[columns->n];
+    memset(table, 0, sizeof(table_t));
+    table->sep = sep;
+
+    /* field types */
+    len = strcspn(p, " \t");
+    while (len) {
+        size_t n = strcspn(p, ",");
+        field_type_t type;
+        if (n > len) n = len;
+
+        if (n == 3 && strncmp(p, "int", 3) == 0) type = FIELD_INT;
+        else if (n == 5 && strncmp(p, "float", 5) == 0) type = FIELD_FLOAT;
+        else if (n == 3 && strncmp(p, "hex", 3) == 0) type = FIELD_HEX;
+        else if (n == 1 && *p == '-') type = FIELD_SKIP;
+        else goto invalid_table;
+
+        field_type_t* fields = realloc(table->fields,
+                (table->nfields+1) * sizeof(field_type_t));
+        if (!fields) goto invalid_table;
+        table->fields = fields;
+        table->fields[table->nfields++] = type;
+        if (type != FIELD_SKIP) table->ncolumns++;
+
+        p += n;
+        len -= n;
+        if (len) {
+            p++;
+            len--;
+        }
+    }
+    if (!table->ncolumns) goto invalid_table;
+
+    /* the rest of the line is the command */
+    p += strspn(p, " \t");
+    if (!*p) goto invalid_table;
+    for (size_t i = 0; i < columns->n; i++) {
+        if (strcmp(columns->tables[i].cmd, p) == 0) goto invalid_table;
+    }
+    table->cmd = malloc(strlen(p)+1);
+    table->time = malloc(COLUMNS_BLOCK * sizeof(int64_t));
+    table->rows = malloc(COLUMNS_BLOCK * table->ncolumns * sizeof(field_t));
+    if (!table->cmd || !table->time || !table->rows) goto invalid_table;
+    strcpy(table->cmd, p);
+    columns->n++;
+    return 0;
+
+invalid_table:
+    free(table->fields);
+    free(table->cmd);
+    free(table->time);
+    free(table->rows);
+invalid:
+    fprintf(stderr, "invalid extract rule: %s\n", value);
+    return -1;
+}
+
+int columns_open(columns_t* columns, const char* path)
+{
+    struct stat st;
+    char* p;
+    size_t size = 1 + VARINT_MAX + strlen(COLUMNS_MAGIC);
+
+    columns->last = NULL;
+    if (!columns->n) {
+        fprintf(stderr, "%s: the device has no extract rules\n", path);
+        return -1;
+    }
+    for (size_t i = 0; i < columns->n; i++) {
+        size += 2 * VARINT_MAX + strlen(columns->tables[i].cmd)
+            + columns->tables[i].ncolumns;
+    }
+
+    columns->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (columns->fd == -1 || fstat(columns->fd, &st) == -1) {
+        fprintf(stderr, "error opening %s: %s\n", path, strerror(errno));
+        if (columns->fd != -1) close(columns->fd);
+        columns->fd = -1;
+        return -1;
+    }
+
+    if (!(p = columns->buf = malloc(size))) return -1;
+    columns->size = size;
+
+    /* every run describes its own tables */
+    if (!st.st_size) {
+        memcpy(p, COLUMNS_MAGIC, strlen(COLUMNS_MAGIC));
+        p += strlen(COLUMNS_MAGIC);
+    }
+    *p++ = ENTRY_SCHEMA;
+    p += put_varint(p, columns->n);
+    for (size_t i = 0; i < columns->n; i++) {
+        const table_t* table = &columns->tables[i];
+        size_t len = strlen(table->cmd);
+        p += put_varint(p, len);
+        memcpy(p, table->cmd, len);
+        p += len;
+        p += put_varint(p, table->ncolumns);
+        for (size_t j = 0; j < table->nfields; j++) {
+            if (table->fields[j] != FIELD_SKIP) *p++ = (char)table->fields[j];
+        }
+    }
+
+    if (write_all(columns->fd, columns->buf, (size_t)(p - columns->buf)) == -1) {
+        fprintf(stderr, "error writing %s: %s\n", path, strerror(errno));
+        close(columns->fd);
+        columns->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int columns_write(columns_t* columns, const char* cmd,
+        const char* line, size_t len)
+{
+    table_t* table = columns->last;
+    const char* p = line;
+    const char* end = line + len;
+    int more = 1;
+
+    if (columns->fd == -1) return -1;
+
+    /* consecutive lines mostly answer the same command */
+    if (!table || strcmp(table->cmd, cmd) != 0) {
+        table = NULL;
+        for (size_t i = 0; i < columns->n && !table; i++) {
+            if (strcmp(columns->tables[i].cmd, cmd) == 0) {
+                table = &columns->tables[i];
+            }
+        }
+        if (!table) return 0;
+        columns->last = table;
+    }
+
+    field_t* row = table->rows + table->nrows * table->ncolumns;
+    for (size_t i = 0; i < table->nfields; i++) {
+        const char* f;
+        const char* fend;
+
+        if (table->sep == ' ') {
+            while (p < end && (*p == ' ' || *p == '\t')) p++;
+            if (p == end) goto reject;
+            f = p;
+            while (p < end && *p != ' ' && *p != '\t') p++;
+            fend = p;
+        } else {
+            if (!more) goto reject;
+            f = p;
+            fend = memchr(p, table->sep, (size_t)(end - p));
+            if (fend) {
+                p = fend + 1;
+            } else {
+                fend = end;
+                more = 0;
+            }
+        }
+
+        if (table->fields[i] == FIELD_SKIP) continue;
+        while (f < fend && (*f == ' ' || *f == '\t')) f++;
+        while (fend > f && (fend[-1] == ' ' || fend[-1] == '\t'
+                    || fend[-1] == '\r')) {
+            fend--;
+        }
+        if (parse_field(f, (size_t)(fend - f), table->fields[i], row++) == -1) {
+            goto reject;
+        }
+    }
+
+    table->time[table->nrows++] = realtime();
+    table->stored++;
+    if (table->nrows == COLUMNS_BLOCK) return flush_table(columns, table);
+    return 0;
+
+reject:
+    table->rejected++;
+    return 0;
+}
+
+int flush_table(columns_t* columns, table_t* table)
+{
+    char head[1 + 3 * VARINT_MAX];
+    size_t nhead = 0;
+    size_t size = table->nrows * (2 * table->ncolumns + 1) * VARINT_MAX;
+    char* p;
+
+    if (!table->nrows) return 0;
+    if (columns->fd == -1) return -1;
+
+    if (size > columns->size) {
+        char* buf = realloc(columns->buf, size);
+        if (!buf) return -1;
+        columns->buf = buf;
+        columns->size = size;
+    }
+    p = columns->buf;
+
+    /* timestamps, then one column after the other */
+    int64_t prev = 0;
+    for (size_t r = 0; r < table->nrows; r++) {
+        p += put_delta(p, table->time[r], prev);
+        prev = table->time[r];
+    }
+    size_t c = 0;
+    for (size_t i = 0; i < table->nfields; i++) {
+        if (table->fields[i] == FIELD_SKIP) continue;
+        const field_t* v = table->rows + c++;
+        int64_t exp = 0;
+        prev = 0;
+        for (size_t r = 0; r < table->nrows; r++, v += table->ncolumns) {
+            p += put_delta(p, v->i, prev);
+            prev = v->i;
+            if (table->fields[i] == FIELD_FLOAT) {
+                p += put_delta(p, v->exp, exp);
+                exp = v->exp;
+            }
+        }
+    }
+
+    head[nhead++] = ENTRY_BLOCK;
+    nhead += put_varint(head + nhead, (uint64_t)(table - columns->tables));
+    nhead += put_varint(head + nhead, table->nrows);
+    nhead += put_varint(head + nhead, (uint64_t)(p - columns->buf));
+    table->nrows = 0;
+
+    if (write_all(columns->fd, head, nhead) == -1
+            || write_all(columns->fd, columns->buf,
+                (size_t)(p - columns->buf)) == -1) {
+        fprintf(stderr, "error writing extracted fields: %s\n",
+                strerror(errno));
+        close(columns->fd);
+        columns->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int columns_close(columns_t* columns)
+{
+    int status = 0;
+
+    for (size_t i = 0; i < columns->n; i++) {
+        table_t* table = &columns->tables[i];
+        if (columns->fd != -1 && flush_table(columns, table) == -1) status = -1;
+        if (table->rejected) {
+            fprintf(stderr, "extract: %zu of %zu lines of \"%s\" rejected\n",
+                    table->rejected, table->rejected + table->stored,
+                    table->cmd);
+        }
+        free(table->cmd);
+        free(table->fields);
+        free(table->time);
+        free(table->rows);
+    }
+    if (columns->fd != -1) close(columns->fd);
+    free(columns->tables);
+    free(columns->buf);
+    memset(columns, 0, sizeof(columns_t));
+    columns->fd = -1;
+    return status;
+}
+
+void put_decimal(FILE* stream, int64_t mantissa, int64_t exp)
+{
+    char digits[24];
+    int n;
+
+    if (exp > 0 || exp < -20) {
+        fprintf(stream, "%llde%lld", (long long)mantissa, (long long)exp);
+        return;
+    }
+
+    /* the digits padded with zeros to have one before the point */
+    if (mantissa < 0) fputc('-', stream);
+    n = snprintf(digits, sizeof(digits), "%0*llu", (int)(1 - exp),
+            mantissa < 0 ? -(unsigned long long)mantissa
+            : (unsigned long long)mantissa);
+    fwrite(digits, 1, (size_t)(n + exp), stream);
+    if (exp) {
+        fputc('.', stream);
+        fwrite(digits + n + exp, 1, (size_t)-exp, stream);
+    }
+}
+
+void put_string(FILE* stream, const char* str, size_t len, int json)
+{
+    if (!json && !memchr(str, ',', len) && !memchr(str, '"', len)
+            && !memchr(str, '\n', len)) {
+        fwrite(str, 1, len, stream);
+        return;
+    }
+    fputc('"', stream);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)str[i];
+        if (c == '"') fputs(json ? "\\\"" : "\"\"", stream);
+        else if (json && c == '\\') fputs("\\\\", stream);
+        else if (json && c < 0x20) fprintf(stream, "\\u%04x", c);
+        else fputc(c, stream);
+    }
+    fputc('"', stream);
+}
+
+int columns_dump(const char* path, FILE* stream, int json)
+{
+    struct stat st;
+    unsigned char* map;
+    int fd;
+    int status = 0;
+
+    /* schema of the current run */
+    struct {
+        const unsigned char* cmd;
+        size_t len;
+        const unsigned char* types;
+        size_t ncolumns;
+    }* tables = NULL;
+    size_t ntables = 0;
+    field_t* values = NULL;
+
+    if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+        fprintf(stderr, "error opening %s: %s\n", path, strerror(errno));
+        if (fd != -1) close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < strlen(COLUMNS_MAGIC)) {
+        fprintf(stderr, "%s: not an extract log\n", path);
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "error mapping %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (memcmp(map, COLUMNS_MAGIC, strlen(COLUMNS_MAGIC)) != 0) {
+        fprintf(stderr, "%s: not an extract log\n", path);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    const unsigned char* p = map + strlen(COLUMNS_MAGIC);
+    const unsigned char* end = map + st.st_size;
+    uint64_t v;
+
+    while (p < end && status == 0) {
+        switch (*p++) {
+
+            case ENTRY_SCHEMA:
+                if (get_varint(&p, end, &v) == -1) goto truncated;
+                free(tables);
+                ntables = (size_t)v;
+                if (!(tables = calloc(ntables ? ntables : 1, sizeof(*tables)))) {
+                    status = -1;
+                    break;
+                }
+                for (size_t i = 0; i < ntables; i++) {
+                    if (get_varint(&p, end, &v) == -1
+                            || v > (uint64_t)(end - p)) goto truncated;
+                    tables[i].cmd = p;
+                    tables[i].len = (size_t)v;
+                    p += v;
+                    if (get_varint(&p, end, &v) == -1
+                            || v > (uint64_t)(end - p)) goto truncated;
+                    tables[i].types = p;
+                    tables[i].ncolumns = (size_t)v;
+                    p += v;
+                }
+                break;
+
+            case ENTRY_BLOCK: {
+                uint64_t t, nrows, size;
+                if (get_varint(&p, end, &t) == -1
+                        || get_varint(&p, end, &nrows) == -1
+                        || get_varint(&p, end, &size) == -1
+                        || size > (uint64_t)(end - p) || t >= ntables
+                        || nrows > size) goto truncated;
+
+                /* decode all columns, then print row by row */
+                size_t ncolumns = tables[t].ncolumns;
+                const unsigned char* block = p + size;
+                field_t* vals = realloc(values,
+                        (size_t)nrows * (ncolumns + 1) * sizeof(field_t));
+                if (!vals) {
+                    status = -1;
+                    break;
+                }
+                values = vals;
+
+                for (size_t c = 0; c <= ncolumns; c++) {
+                    int decimal = c && tables[t].types[c-1] == FIELD_FLOAT;
+                    int64_t prev = 0;
+                    int64_t exp = 0;
+                    for (size_t r = 0; r < nrows; r++) {
+                        field_t* out = &values[r * (ncolumns + 1) + c];
+                        if (get_delta(&p, block, &prev) == -1) goto truncated;
+                        out->i = prev;
+                        if (decimal && get_delta(&p, block, &exp) == -1) {
+                            goto truncated;
+                        }
+                        out->exp = exp;
+                    }
+                }
+                p = block;
+
+                for (size_t r = 0; r < nrows; r++) {
+                    const field_t* row = &values[r * (ncolumns + 1)];
+                    fprintf(stream, json ? "{\"time\":%lld.%09lld,\"command\":"
+                            : "%lld.%09lld,", (long long)(row->i / 1000000000),
+                            (long long)(row->i % 1000000000));
+                    put_string(stream, (const char*)tables[t].cmd,
+                            tables[t].len, json);
+                    if (json) fputs(",\"values\":[", stream);
+                    for (size_t c = 1; c <= ncolumns; c++) {
+                        if (!json || c > 1) fputc(',', stream);
+                        switch (tables[t].types[c-1]) {
+                            case FIELD_FLOAT:
+                                put_decimal(stream, row[c].i, row[c].exp);
+                                break;
+                            case FIELD_HEX:
+                                fprintf(stream, json ? "\"0x%llx\"" : "0x%llx",
+                                        (unsigned long long)row[c].i);
+                                break;
+                            default:
+                                fprintf(stream, "%lld", (long long)row[c].i);
+                                break;
+                        }
+                    }
+                    fputs(json ? "]}\n" : "\n", stream);
+                }
+                break;
+            }
+
+            default:
+                fprintf(stderr, "%s: unknown entry '%c'\n", path, p[-1]);
+                status = -1;
+                break;
+        }
+        continue;
+
+truncated:
+        fprintf(stderr, "%s: truncated\n", path);
+        status = -1;
+    }
+
+    free(values);
+    free(tables);
+    munmap(map, (size_t)st.st_size);
+    return status;
+}
+
+// vim:ft=c
@@ -0,0 +1,276 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : config.c
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/config.h"
+
+#define CMD_LEN 80
+
+char* config_find(const char* file, const char* ext)
+{
+    char* path = NULL;
+    char buf[CMD_LEN+1];
+    struct stat file_stat;
+
+    const char* home = getenv("HOME");
+    const char* config = getenv("XDG_CONFIG_HOME");
+
+    if (*file != '~') {
+        snprintf(buf, sizeof(buf), "%s", file);
+
+    /* expand tilde */
+    } else {
+        snprintf(buf, sizeof(buf), "%s/%s", home ? home : "", file+1);
+    }
+
+    /* absolute path */
+    if ((strncmp(buf, "./", 2) != 0 || *buf != '/') && access(buf, F_OK) == -1) {
+
+        /* ~/.config/trx/{}.ext */
+        if (config && *config) {
+            snprintf(buf, sizeof(buf), "%s/trx/%s%s", config, file, ext);
+        } else {
+            snprintf(buf, sizeof(buf), "%s/.config/trx/%s%s", home ? home : "",
+                    file, ext);
+        }
+        if (access(buf, F_OK) == -1) {
+
+            /* ~/.trx/{}.ext */
+            snprintf(buf, sizeof(buf), "%s/.trx/%s%s", home ? home : "",
+                    file, ext);
+            if (access(buf, F_OK) == -1) {
+
+                /* /etc/trx/{}.ext */
+                snprintf(buf, sizeof(buf), "/etc/trx/%s%s", file, ext);
+
+                if (access(buf, F_OK) == -1) {
+                    return NULL;
+                }
+            }
+        }
+    }
+
+    path = malloc(strlen(buf)+1);
+    strcpy(path, buf);
+
+    stat(path, &file_stat);
+
+    /* check if file is regular file */
+    if (!S_ISREG(file_stat.st_mode)) {
+        fprintf(stderr, "\"%s\" is not a regular file\n", path);
+        free(path);
+        return NULL;
+
+    /* check if file is empty */
+    } else if (!file_stat.st_size) {
+        fprintf(stderr, "file \"%s\" is empty\n", path);
+        free(path);
+        return NULL;
+
+    } else {
+        return path;
+    }
+}
+
+int config_set(portsettings_t* ps, const char* key, const char* value)
+{
+    char token[CMD_LEN+1];
+    size_t len = strcspn(value, " \t");
+    const char* p = token;
+
+    /* all but probe and expect are a single word */
+    if (len > CMD_LEN) {
+        fprintf(stderr, "maximum line length exceeded: %i characters\n",
+                CMD_LEN);
+        return -1;
+    }
+    memcpy(token, value, len);
+    token[len] = '\0';
+
+    if (strcmp(key, "port") == 0) {
+        if (portsettings_set_port(ps, p) == -1) {
+            fprintf(stderr, "invalid serial port: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "baudrate") == 0) {
+        if (portsettings_set_baudrate(ps, p) == -1) {
+            fprintf(stderr, "invalid baudrate: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "timeout") == 0) {
+        if (portsettings_set_timeout(ps, p) == -1) {
+            fprintf(stderr, "invalid timeout: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "first") == 0) {
+        if (portsettings_set_first(ps, p) == -1) {
+            fprintf(stderr, "invalid first: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "gap") == 0) {
+        if (portsettings_set_gap(ps, p) == -1) {
+            fprintf(stderr, "invalid gap: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "total") == 0) {
+        if (portsettings_set_total(ps, p) == -1) {
+            fprintf(stderr, "invalid total: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "delimiter") == 0) {
+        if (portsettings_set_delimiter(ps, p) == -1) {
+            fprintf(stderr, "invalid delimiter: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "terminator") == 0) {
+        if (portsettings_set_terminator(ps, p) == -1) {
+            fprintf(stderr, "invalid terminator: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "databits") == 0) {
+        if (portsettings_set_databits(ps, p) == -1) {
+            fprintf(stderr, "invalid databits: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "parity") == 0) {
+        if (portsettings_set_parity(ps, p) == -1) {
+            fprintf(stderr, "invalid parity: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "flow") == 0) {
+        if (portsettings_set_flow(ps, p) == -1) {
+            fprintf(stderr, "invalid flow control: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "stopbits") == 0) {
+        if (portsettings_set_stopbits(ps, p) == -1) {
+            fprintf(stderr, "invalid stopbits: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "framing") == 0) {
+        if (portsettings_set_framing(ps, p) == -1) {
+            fprintf(stderr, "invalid framing: %s\n", p);
+            return -1;
+        }
+
+    } else if (strcmp(key, "drain") == 0) {
+        ps->drain = atoi(p) != 0;
+
+    } else if (strcmp(key, "hex") == 0) {
+        ps->hex = atoi(p) != 0;
+
+    } else if (strcmp(key, "lowlatency") == 0) {
+        ps->lowlatency = atoi(p) != 0;
+
+    } else if (strcmp(key, "spin") == 0) {
+        if (portsettings_set_spin(ps, p) == -1) {
+            fprintf(stderr, "invalid spin: %s\n", p);
+            return -1;
+        }
+
+    /* the whole line, may contain spaces */
+    } else if (strcmp(key, "probe") == 0) {
+        if (portsettings_set_probe(ps, value) == -1) {
+            fprintf(stderr, "invalid probe: %s\n", value);
+            return -1;
+        }
+
+    } else if (strcmp(key, "expect") == 0) {
+        if (portsettings_set_expect(ps, value) == -1) {
+            fprintf(stderr, "invalid expect: %s\n", value);
+            return -1;
+        }
+
+    } else if (strcmp(key, "count") == 0) {
+        if (portsettings_set_count(ps, p) == -1) {
+            fprintf(stderr, "invalid count: %s\n", p);
+            return -1;
+        }
+
+    } else {
+        return 1;
+    }
+    return 0;
+}
+
+int config_apply(portsettings_t* ps, const char* key, const char* value)
+{
+    /* options given explicitly win over the config */
+    if ((ps->port && strcmp(key, "port") == 0)
+            || (ps->baudrate && strcmp(key, "baudrate") == 0)
+            || (ps->timeout && strcmp(key, "timeout") == 0)
+            || (ps->first && strcmp(key, "first") == 0)
+            || (ps->gap && strcmp(key, "gap") == 0)
+            || (ps->total && strcmp(key, "total") == 0)
+            || ((ps->fixed & PORTSETTINGS_DELIMITER)
+                && strcmp(key, "delimiter") == 0)
+            || ((ps->fixed & PORTSETTINGS_FLOW) && strcmp(key, "flow") == 0)
+            || ((ps->fixed & PORTSETTINGS_FRAMING)
+                && strcmp(key, "framing") == 0)
+            || ((ps->fixed & PORTSETTINGS_DRAIN) && strcmp(key, "drain") == 0)
+            || ((ps->fixed & PORTSETTINGS_HEX) && strcmp(key, "hex") == 0)
+            || ((ps->fixed & PORTSETTINGS_LOWLATENCY)
+                && strcmp(key, "lowlatency") == 0)
+            || ((ps->fixed & PORTSETTINGS_SPIN) && strcmp(key, "spin") == 0)
+            || (ps->probe && strcmp(key, "probe") == 0)
+            || (ps->expect && strcmp(key, "expect") == 0)
+            || (ps->count != UINT_MAX && strcmp(key, "count") == 0)) {
+        return 0;
+    }
+    return config_set(ps, key, value) == -1 ? -1 : 0;
+}
+
+int config_load(registry_t* registry, portsettings_t* ps, const char* name,
+        registry_apply_t apply)
+{
+    int status;
+
+    /* a path or a file in the working directory is read as is */
+    if (strchr(name, '/') || *name == '~' || access(name, F_OK) == 0) {
+        char* path = config_find(name, ".conf");
+        if (!path) {
+            fprintf(stderr, "%s \"%s\"\n", strerror(errno), name);
+            return -1;
+        }
+        status = registry_read(path, apply, ps);
+        free(path);
+
+    } else {
+        if (!registry->map && registry_open(registry) == -1) return -1;
+        status = registry_find(registry, name, apply, ps);
+        if (status == 0) {
+            fprintf(stderr, "unknown device \"%s\"\n", name);
+            return -1;
+        }
+    }
+
+    if (status == -1) {
+        fprintf(stderr, "error parsing config file: %s\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+// vim:ft=c
@@ -0,0 +1,267 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : framing.c
+ */
+
+#include <ctype.h>
+#include <string.h>
+
+#include "../include/framing.h"
+
+/**
+ * SLIP special characters
+ */
+#define SLIP_END 0xc0
+#define SLIP_ESC 0xdb
+#define SLIP_ESC_END 0xdc
+#define SLIP_ESC_ESC 0xdd
+
+/**
+ * size of length header
+ */
+#define LENGTH_HEADER 2
+
+/**
+ * value of a hex digit
+ *
+ * @return 0..15 or -1
+ */
+static int nibble(char c);
+
+/**
+ * frame ends at the first occurrence of byte, decode it in place
+ */
+static int decode_cobs(rxbuf_t* rxbuf, char** frame, size_t* len);
+static int decode_slip(rxbuf_t* rxbuf, char** frame, size_t* len);
+static int decode_length(rxbuf_t* rxbuf, char** frame, size_t* len);
+
+/**
+ * find byte in unconsumed part of buffer, resuming the previous scan
+ *
+ * @return offset from head or -1 when not buffered
+ */
+static ssize_t find(rxbuf_t* rxbuf, char byte);
+
+int framing_parse(framing_t* framing, const char* str)
+{
+    if (!str) return -1;
+    else if (strcmp(str, "line") == 0) *framing = FRAMING_LINE;
+    else if (strcmp(str, "cobs") == 0) *framing = FRAMING_COBS;
+    else if (strcmp(str, "slip") == 0) *framing = FRAMING_SLIP;
+    else if (strcmp(str, "length") == 0) *framing = FRAMING_LENGTH;
+    else return -1;
+    return 0;
+}
+
+const char* framing_name(framing_t framing)
+{
+    switch (framing) {
+        case FRAMING_LINE: return "line";
+        case FRAMING_COBS: return "cobs";
+        case FRAMING_SLIP: return "slip";
+        case FRAMING_LENGTH: return "length";
+        default: return "?";
+    }
+}
+
+size_t framing_bound(framing_t framing, size_t len)
+{
+    switch (framing) {
+        case FRAMING_LINE: return len + 1;
+        case FRAMING_COBS: return len + len / 254 + 2;
+        case FRAMING_SLIP: return 2 * len + 2;
+        case FRAMING_LENGTH: return len + LENGTH_HEADER;
+        default: return 0;
+    }
+}
+
+ssize_t framing_encode(framing_t framing, const char* in, size_t len,
+        char* out)
+{
+    const unsigned char* src = (const unsigned char*)in;
+    unsigned char* dst = (unsigned char*)out;
+    size_t n = 0;
+
+    switch (framing) {
+
+        case FRAMING_LINE:
+            memcpy(dst, src, len);
+            dst[len] = '\r';
+            return (ssize_t)len + 1;
+
+        /* every run of non-zero bytes is preceded by its length + 1 */
+        case FRAMING_COBS: {
+            size_t code = n++;
+            unsigned char run = 1;
+            for (size_t i = 0; i < len; i++) {
+                if (src[i]) {
+                    dst[n++] = src[i];
+                    run++;
+                }
+                if (!src[i] || run == 0xff) {
+                    dst[code] = run;
+                    code = n++;
+                    run = 1;
+                }
+            }
+            dst[code] = run;
+            dst[n++] = 0x00;
+            return (ssize_t)n;
+        }
+
+        /* leading END flushes line noise at the receiver */
+        case FRAMING_SLIP:
+            dst[n++] = SLIP_END;
+            for (size_t i = 0; i < len; i++) {
+                if (src[i] == SLIP_END) {
+                    dst[n++] = SLIP_ESC;
+                    dst[n++] = SLIP_ESC_END;
+                } else if (src[i] == SLIP_ESC) {
+                    dst[n++] = SLIP_ESC;
+                    dst[n++] = SLIP_ESC_ESC;
+                } else {
+                    dst[n++] = src[i];
+                }
+            }
+            dst[n++] = SLIP_END;
+            return (ssize_t)n;
+
+        case FRAMING_LENGTH:
+            if (len > 0xffff) return -1;
+            dst[0] = (unsigned char)(len >> 8);
+            dst[1] = (unsigned char)len;
+            memcpy(dst + LENGTH_HEADER, src, len);
+            return (ssize_t)(len + LENGTH_HEADER);
+
+        default:
+            return -1;
+    }
+}
+
+ssize_t find(rxbuf_t* rxbuf, char byte)
+{
+    char* start = rxbuf->data + rxbuf->head;
+    size_t avail = rxbuf->tail - rxbuf->head;
+    char* p = NULL;
+
+    if (rxbuf->scan < avail) {
+        p = memchr(start + rxbuf->scan, byte, avail - rxbuf->scan);
+    }
+    if (!p) {
+        rxbuf->scan = avail;
+        return -1;
+    }
+    rxbuf->scan = 0;
+    return p - start;
+}
+
+int decode_cobs(rxbuf_t* rxbuf, char** frame, size_t* len)
+{
+    ssize_t end = find(rxbuf, 0x00);
+    if (end == -1) return 0;
+
+    unsigned char* p = (unsigned char*)rxbuf->data + rxbuf->head;
+    size_t size = (size_t)end;
+    size_t in = 0;
+    size_t out = 0;
+
+    rxbuf->head += size + 1;
+
+    /* output never overtakes input, decode in place */
+    while (in < size) {
+        unsigned char code = p[in++];
+        if (!code || in + code - 1 > size) return -1;
+        for (unsigned char i = 1; i < code; i++) p[out++] = p[in++];
+        if (code != 0xff && in < size) p[out++] = 0x00;
+    }
+
+    *frame = (char*)p;
+    *len = out;
+    return 1;
+}
+
+int decode_slip(rxbuf_t* rxbuf, char** frame, size_t* len)
+{
+    ssize_t end;
+
+    /* skip empty frames from leading END characters */
+    while ((end = find(rxbuf, (char)SLIP_END)) == 0) rxbuf->head++;
+    if (end == -1) return 0;
+
+    unsigned char* p = (unsigned char*)rxbuf->data + rxbuf->head;
+    size_t size = (size_t)end;
+    size_t out = 0;
+
+    rxbuf->head += size + 1;
+
+    for (size_t in = 0; in < size; in++) {
+        if (p[in] != SLIP_ESC) {
+            p[out++] = p[in];
+        } else if (++in < size && p[in] == SLIP_ESC_END) {
+            p[out++] = SLIP_END;
+        } else if (in < size && p[in] == SLIP_ESC_ESC) {
+            p[out++] = SLIP_ESC;
+        } else {
+            return -1;
+        }
+    }
+
+    *frame = (char*)p;
+    *len = out;
+    return 1;
+}
+
+int decode_length(rxbuf_t* rxbuf, char** frame, size_t* len)
+{
+    unsigned char* p = (unsigned char*)rxbuf->data + rxbuf->head;
+    size_t avail = rxbuf->tail - rxbuf->head;
+
+    if (avail < LENGTH_HEADER) return 0;
+
+    size_t size = (size_t)p[0] << 8 | p[1];
+    if (avail < LENGTH_HEADER + size) return 0;
+
+    rxbuf->head += LENGTH_HEADER + size;
+    *frame = (char*)p + LENGTH_HEADER;
+    *len = size;
+    return 1;
+}
+
+int framing_decode(framing_t framing, rxbuf_t* rxbuf, char** frame,
+        size_t* len)
+{
+    switch (framing) {
+        case FRAMING_COBS: return decode_cobs(rxbuf, frame, len);
+        case FRAMING_SLIP: return decode_slip(rxbuf, frame, len);
+        case FRAMING_LENGTH: return decode_length(rxbuf, frame, len);
+        case FRAMING_LINE:
+        default: return -1;
+    }
+}
+
+int nibble(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+ssize_t framing_hex_decode(const char* str, char* out)
+{
+    size_t n = 0;
+
+    while (*str) {
+        if (isspace((unsigned char)*str)) {
+            str++;
+            continue;
+        }
+        int hi = nibble(str[0]);
+        int lo = hi == -1 ? -1 : nibble(str[1]);
+        if (lo == -1) return -1;
+        out[n++] = (char)(hi << 4 | lo);
+        str += 2;
+    }
+    return (ssize_t)n;
+}
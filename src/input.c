@@ -0,0 +1,222 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : input.c
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/input.h"
+
+/**
+ * trim line ending and check if line holds a command
+ *
+ * @param[in,out] line null-terminated line
+ * @param[in] len length of line
+ * @return 1 if line is a command
+ */
+static int command(char* line, size_t len);
+
+/**
+ * offset of a command within the mapped file
+ *
+ * @param[in] input mapped file
+ * @param[in] i index of command
+ * @return byte offset
+ */
+static size_t start(const input_t* input, size_t i);
+
+/**
+ * map file and build index of commands
+ *
+ * @param[in,out] input object to fill
+ * @param[in] fd open regular file
+ * @param[in] size length of file
+ * @return status 0 for succes, -1 for failure
+ */
+static int map(input_t* input, int fd, size_t size);
+
+int command(char* line, size_t len)
+{
+    while (len && (line[len-1] == '\n' || line[len-1] == '\r')) line[--len] = '\0';
+    return len && *line != '#';
+}
+
+int map(input_t* input, int fd, size_t size)
+{
+    size_t cap = 0;
+
+    /* private writable mapping: line endings become null characters in
+     * place, the file itself is never modified */
+    input->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (input->map == MAP_FAILED) {
+        input->map = NULL;
+        return -1;
+    }
+    input->size = size;
+    madvise(input->map, size, MADV_SEQUENTIAL);
+
+    char* p = input->map;
+    char* end = input->map + size;
+
+    while (p < end) {
+        char* nl = memchr(p, '\n', (size_t)(end - p));
+        char* line = p;
+        size_t len;
+
+        if (nl) {
+            *nl = '\0';
+            len = (size_t)(nl - p);
+            p = nl + 1;
+        } else {
+            /* no room to terminate a last line that fills the mapping */
+            len = (size_t)(end - p);
+            input->tail = malloc(len + 1);
+            if (!input->tail) return -1;
+            memcpy(input->tail, p, len);
+            input->tail[len] = '\0';
+            line = input->tail;
+            input->tailat = (size_t)(p - input->map);
+            p = end;
+        }
+
+        if (!command(line, len)) continue;
+
+        if (input->n == cap) {
+            cap = cap ? 2 * cap : 1024;
+            char** index = realloc(input->index, cap * sizeof(char*));
+            if (!index) return -1;
+            input->index = index;
+        }
+        input->index[input->n++] = line;
+    }
+    return 0;
+}
+
+size_t start(const input_t* input, size_t i)
+{
+    if (input->index[i] == input->tail) return input->tailat;
+    return (size_t)(input->index[i] - input->map);
+}
+
+int input_open(input_t* input, const char* path)
+{
+    struct stat st;
+    int fd;
+
+    memset(input, 0, sizeof(input_t));
+
+    if (strcmp(path, "-") == 0) {
+        input->stream = stdin;
+        return 0;
+    }
+
+    if ((fd = open(path, O_RDONLY)) == -1) return -1;
+
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    /* fifos and character devices can not be mapped */
+    if (!S_ISREG(st.st_mode) || !st.st_size) {
+        input->stream = fdopen(fd, "r");
+        return input->stream ? 0 : -1;
+    }
+
+    int status = map(input, fd, (size_t)st.st_size);
+    close(fd);
+    if (status == -1) {
+        int err = errno;
+        input_close(input);
+        errno = err;
+    }
+    return status;
+}
+
+const char* input_next(input_t* input)
+{
+    if (input->map) {
+        if (input->next == input->n) return NULL;
+        return input->index[input->next++];
+    }
+
+    if (!input->stream) return NULL;
+
+    ssize_t len;
+    while ((len = getline(&input->line, &input->linesize, input->stream)) != -1) {
+        input->offset += len;
+        if (command(input->line, (size_t)len)) return input->line;
+    }
+    return NULL;
+}
+
+off_t input_offset(const input_t* input)
+{
+    if (!input->map) return input->offset;
+    if (input->next == input->n) return (off_t)input->size;
+    return (off_t)start(input, input->next);
+}
+
+ssize_t input_seek(input_t* input, off_t offset, const char** last)
+{
+    *last = NULL;
+
+    if (input->map) {
+        if (offset < 0 || (size_t)offset > input->size) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        /* first command at or after offset */
+        size_t lo = 0, hi = input->n;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (start(input, mid) < (size_t)offset) lo = mid + 1;
+            else hi = mid;
+        }
+        input->next = lo;
+        if (lo) *last = input->index[lo-1];
+        return (ssize_t)lo;
+    }
+
+    if (!input->stream) return 0;
+
+    /* the line buffer is reused, the last command is kept in tail */
+    ssize_t n = 0;
+    ssize_t len;
+    while (input->offset < offset
+            && (len = getline(&input->line, &input->linesize,
+                    input->stream)) != -1) {
+        input->offset += len;
+        if (!command(input->line, (size_t)len)) continue;
+
+        char* tail = realloc(input->tail, (size_t)len + 1);
+        if (!tail) return -1;
+        input->tail = strcpy(tail, input->line);
+        n++;
+    }
+    if (input->offset != offset) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (n) *last = input->tail;
+    return n;
+}
+
+void input_close(input_t* input)
+{
+    if (input->map) munmap(input->map, input->size);
+    if (input->stream && input->stream != stdin) fclose(input->stream);
+    free(input->index);
+    free(input->tail);
+    free(input->line);
+    memset(input, 0, sizeof(input_t));
+}
@@ -0,0 +1,255 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : journal.c
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/journal.h"
+
+/**
+ * length of the fields of a record covered by its crc
+ */
+#define FIELDS 52
+
+/**
+ * current CLOCK_MONOTONIC time
+ *
+ * @return sec
+ */
+static double now(void);
+
+/**
+ * FNV-1a of bytes
+ *
+ * @param[in] data bytes
+ * @param[in] len length of data
+ * @return hash
+ */
+static uint32_t fnv(const char* data, size_t len);
+
+/**
+ * parse one record slot
+ *
+ * @param[in] slot JOURNAL_RECORD bytes
+ * @param[out] seq number of the record
+ * @param[out] at checkpoint held
+ * @return status 0 for succes, -1 if the slot is empty or torn
+ */
+static int parse(const char* slot, uint32_t* seq, checkpoint_t* at);
+
+/**
+ * load the latest intact record
+ *
+ * @param[in,out] journal open journal
+ * @return status 0 for succes, -1 if none is found
+ */
+static int load(journal_t* journal);
+
+/**
+ * sync when the interval has passed
+ *
+ * @param[in,out] journal open journal
+ * @return status 0 for succes, -1 for failure
+ */
+static int tick(journal_t* journal);
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+uint32_t fnv(const char* data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int parse(const char* slot, uint32_t* seq, checkpoint_t* at)
+{
+    char fields[JOURNAL_RECORD];
+    unsigned long long offset, n;
+    unsigned int s, hash, crc;
+
+    if (slot[JOURNAL_RECORD-1] != '\n') return -1;
+    memcpy(fields, slot, JOURNAL_RECORD-1);
+    fields[JOURNAL_RECORD-1] = '\0';
+
+    if (sscanf(fields, "%8x %16llx %16llx %8x %8x", &s, &offset, &n, &hash,
+                &crc) != 5 || crc != fnv(slot, FIELDS)) {
+        return -1;
+    }
+    *seq = s;
+    at->offset = (off_t)offset;
+    at->n = n;
+    at->hash = hash;
+    return 0;
+}
+
+int load(journal_t* journal)
+{
+    char slots[2 * JOURNAL_RECORD];
+    checkpoint_t at[2];
+    uint32_t seq[2];
+    int ok[2];
+
+    ssize_t len = pread(journal->fd, slots, sizeof(slots), 0);
+    if (len < JOURNAL_RECORD) return -1;
+
+    ok[0] = parse(slots, &seq[0], &at[0]) == 0;
+    ok[1] = len == sizeof(slots)
+        && parse(slots + JOURNAL_RECORD, &seq[1], &at[1]) == 0;
+    if (!ok[0] && !ok[1]) return -1;
+
+    /* the newer of the two, sequence numbers may wrap */
+    int i = !ok[0] || (ok[1] && (int32_t)(seq[1] - seq[0]) > 0);
+    journal->seq = seq[i];
+    journal->acked = at[i];
+    return 0;
+}
+
+int tick(journal_t* journal)
+{
+    if (now() - journal->synced < journal->interval) return 0;
+    return journal_sync(journal);
+}
+
+int journal_open(journal_t* journal, const char* path, double interval,
+        int resume, journal_flush_t flush)
+{
+    memset(journal, 0, sizeof(journal_t));
+
+    journal->fd = open(path, resume ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC,
+            0644);
+    if (journal->fd == -1) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+        return -1;
+    }
+    journal->path = malloc(strlen(path)+1);
+    if (!journal->path) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+        close(journal->fd);
+        journal->fd = -1;
+        return -1;
+    }
+    strcpy(journal->path, path);
+    journal->interval = interval;
+    journal->flush = flush;
+
+    if (resume && load(journal) == -1) {
+        fprintf(stderr, "no checkpoint in \"%s\"\n", path);
+        journal_close(journal);
+        return -1;
+    }
+
+    /* a new run never resumes from what an earlier one left */
+    journal->dirty = !resume;
+    return journal_sync(journal);
+}
+
+uint32_t journal_hash(const char* cmd)
+{
+    return fnv(cmd, strlen(cmd));
+}
+
+int journal_ack(journal_t* journal, const checkpoint_t* at, const char* cmd)
+{
+    if (!at->n || journal->missed.n) return 0;
+
+    journal->acked = *at;
+    journal->acked.hash = journal_hash(cmd);
+    journal->queued.n = 0;
+    journal->dirty = 1;
+    return tick(journal);
+}
+
+void journal_queue(journal_t* journal, const checkpoint_t* at,
+        const char* cmd)
+{
+    if (!at->n || journal->missed.n) return;
+
+    journal->queued = *at;
+    journal->queued.hash = journal_hash(cmd);
+}
+
+int journal_flushed(journal_t* journal)
+{
+    if (!journal->queued.n || journal->missed.n) return 0;
+
+    journal->acked = journal->queued;
+    journal->queued.n = 0;
+    journal->dirty = 1;
+    return tick(journal);
+}
+
+void journal_miss(journal_t* journal, const checkpoint_t* at)
+{
+    if (at->n && !journal->missed.n) journal->missed = *at;
+}
+
+int journal_sync(journal_t* journal)
+{
+    char slot[JOURNAL_RECORD + 1];
+
+    if (!journal->dirty) return 0;
+
+    /* a checkpoint is never ahead of the responses it covers */
+    if (journal->flush && journal->flush() == -1) return -1;
+
+    journal->seq++;
+    sprintf(slot, "%08x %016llx %016llx %08x ", (unsigned int)journal->seq,
+            (unsigned long long)journal->acked.offset,
+            (unsigned long long)journal->acked.n,
+            (unsigned int)journal->acked.hash);
+    sprintf(slot + FIELDS, "%08x", (unsigned int)fnv(slot, FIELDS));
+    memset(slot + FIELDS + 8, ' ', JOURNAL_RECORD - FIELDS - 9);
+    slot[JOURNAL_RECORD-1] = '\n';
+
+    /* the slot not holding the previous record */
+    off_t pos = (off_t)(journal->seq % 2) * JOURNAL_RECORD;
+    if (pwrite(journal->fd, slot, JOURNAL_RECORD, pos) != JOURNAL_RECORD
+            || fdatasync(journal->fd) == -1) {
+        fprintf(stderr, "error writing journal %s: %s\n", journal->path,
+                strerror(errno));
+        return -1;
+    }
+    journal->dirty = 0;
+    journal->synced = now();
+    return 0;
+}
+
+int journal_close(journal_t* journal)
+{
+    int status = 0;
+
+    if (!journal->path) return 0;
+
+    if (journal->fd != -1) {
+        if (journal_sync(journal) == -1) status = -1;
+        if (close(journal->fd) == -1) status = -1;
+    }
+    if (journal->missed.n) {
+        fprintf(stderr, "journal: command %llu was not answered, "
+                "--resume starts there\n",
+                (unsigned long long)journal->missed.n);
+    }
+    free(journal->path);
+    memset(journal, 0, sizeof(journal_t));
+    journal->fd = -1;
+    return status;
+}
+
+// vim:ft=c
@@ -0,0 +1,279 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : latency.c
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "../include/latency.h"
+
+/**
+ * samples needed before a learned deadline replaces the timeout
+ */
+#define MIN_SAMPLES 8
+
+/**
+ * learned deadline = percentile * factor + margin
+ */
+#define PERCENTILE 0.99
+#define FIRST_FACTOR 4.0
+#define FIRST_MARGIN 0.050
+#define GAP_FACTOR 2.0
+#define GAP_MARGIN 0.005
+
+/**
+ * compare doubles for qsort
+ */
+static int compare(const void* a, const void* b);
+
+/**
+ * percentile of the most recent samples
+ *
+ * @param[in] samples ring of LATENCY_SAMPLES values
+ * @param[in] n total number of samples taken
+ * @param[in] p percentile 0..1
+ * @return value below which a fraction p of the samples lies
+ */
+static double percentile(const double* samples, unsigned int n, double p);
+
+/**
+ * store value in ring of samples
+ */
+static void add(double* samples, unsigned int* n, double sec);
+
+/**
+ * write a ring of samples as one profile line
+ */
+static void write_samples(FILE* stream, const char* prefix, const char* kind,
+        const double* samples, unsigned int n);
+
+int compare(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+double percentile(const double* samples, unsigned int n, double p)
+{
+    double sorted[LATENCY_SAMPLES];
+    size_t len = n < LATENCY_SAMPLES ? n : LATENCY_SAMPLES;
+    size_t i;
+
+    memcpy(sorted, samples, len * sizeof(double));
+    qsort(sorted, len, sizeof(double), compare);
+
+    i = (size_t)(p * (double)len + 0.999999);
+    return sorted[i ? i-1 : 0];
+}
+
+void add(double* samples, unsigned int* n, double sec)
+{
+    samples[*n % LATENCY_SAMPLES] = sec;
+    (*n)++;
+}
+
+int profile_load(profile_t* profile, const char* name)
+{
+    char path[PATH_MAX];
+    char line[1024];
+    const char* cache = getenv("XDG_CACHE_HOME");
+    FILE* stream;
+    int len;
+
+    memset(profile, 0, sizeof(profile_t));
+
+    if (cache && *cache) {
+        len = snprintf(path, sizeof(path), "%s/trx", cache);
+    } else if (getenv("HOME")) {
+        len = snprintf(path, sizeof(path), "%s/.cache/trx", getenv("HOME"));
+    } else {
+        fprintf(stderr, "no cache directory for latency profile\n");
+        return -1;
+    }
+    if (len < 0 || (size_t)len >= sizeof(path) - LATENCY_PREFIX) return -1;
+
+    /* create cache directory */
+    char* p = strchr(path+1, '/');
+    for (; p; p = strchr(p+1, '/')) {
+        *p = '\0';
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+        return -1;
+    }
+
+    /* one file per device, a path is flattened to a file name */
+    path[len++] = '/';
+    snprintf(path + len, sizeof(path) - (size_t)len, "%s.latency", name);
+    for (p = path + len; *p; p++) if (*p == '/') *p = '_';
+
+    profile->path = malloc(strlen(path)+1);
+    strcpy(profile->path, path);
+
+    if (!(stream = fopen(path, "r"))) return errno == ENOENT ? 0 : -1;
+
+    while (fgets(line, sizeof(line), stream)) {
+        char prefix[LATENCY_PREFIX];
+        char kind[8];
+        unsigned int n;
+        int off;
+
+        if (*line == '#') continue;
+        if (sscanf(line, "%31s %7s %u%n", prefix, kind, &n, &off) != 3) continue;
+
+        latency_t* latency = profile_get(profile, prefix);
+        if (!latency) break;
+
+        double* samples = strcmp(kind, "first") == 0 ? latency->first
+            : strcmp(kind, "gap") == 0 ? latency->gap : NULL;
+        if (!samples) continue;
+
+        /* oldest sample first, so re-adding keeps the ring order */
+        char* s = line + off;
+        for (unsigned int i = 0; i < n && i < LATENCY_SAMPLES; i++) {
+            char* end;
+            double d = strtod(s, &end);
+            if (end == s) break;
+            s = end;
+            add(samples, samples == latency->first ? &latency->nfirst
+                    : &latency->ngap, d);
+        }
+    }
+
+    fclose(stream);
+    profile->dirty = 0;
+    return 0;
+}
+
+latency_t* profile_get(profile_t* profile, const char* cmd)
+{
+    char prefix[LATENCY_PREFIX];
+    size_t len = strcspn(cmd, " \t");
+
+    if (len >= LATENCY_PREFIX) len = LATENCY_PREFIX - 1;
+    if (!len) {
+        strcpy(prefix, "-");
+    } else {
+        memcpy(prefix, cmd, len);
+        prefix[len] = '\0';
+    }
+
+    for (size_t i = 0; i < profile->n; i++) {
+        if (strcmp(profile->entries[i].prefix, prefix) == 0) {
+            return &profile->entries[i];
+        }
+    }
+
+    latency_t* entries = realloc(profile->entries,
+            (profile->n+1) * sizeof(latency_t));
+    if (!entries) return NULL;
+    profile->entries = entries;
+
+    latency_t* latency = &profile->entries[profile->n++];
+    memset(latency, 0, sizeof(latency_t));
+    strcpy(latency->prefix, prefix);
+    return latency;
+}
+
+void write_samples(FILE* stream, const char* prefix, const char* kind,
+        const double* samples, unsigned int n)
+{
+    unsigned int len = n < LATENCY_SAMPLES ? n : LATENCY_SAMPLES;
+
+    if (!len) return;
+    fprintf(stream, "%s %s %u", prefix, kind, len);
+    for (unsigned int i = n - len; i < n; i++) {
+        fprintf(stream, " %.6f", samples[i % LATENCY_SAMPLES]);
+    }
+    fprintf(stream, "\n");
+}
+
+int profile_save(profile_t* profile)
+{
+    char tmp[PATH_MAX];
+    FILE* stream;
+
+    if (!profile->path || !profile->dirty) return 0;
+
+    /* replace atomically so concurrent runs never read half a profile */
+    snprintf(tmp, sizeof(tmp), "%s.%i", profile->path, (int)getpid());
+    if (!(stream = fopen(tmp, "w"))) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), tmp);
+        return -1;
+    }
+
+    fprintf(stream, "# trx latency profile: <prefix> first|gap <n> <sec> ...\n");
+    for (size_t i = 0; i < profile->n; i++) {
+        const latency_t* l = &profile->entries[i];
+        write_samples(stream, l->prefix, "first", l->first, l->nfirst);
+        write_samples(stream, l->prefix, "gap", l->gap, l->ngap);
+    }
+
+    if (fclose(stream) == EOF || rename(tmp, profile->path) == -1) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), profile->path);
+        remove(tmp);
+        return -1;
+    }
+    profile->dirty = 0;
+    return 0;
+}
+
+void profile_die(profile_t* profile)
+{
+    free(profile->path);
+    free(profile->entries);
+    memset(profile, 0, sizeof(profile_t));
+}
+
+void latency_add_first(profile_t* profile, latency_t* latency, double sec)
+{
+    add(latency->first, &latency->nfirst, sec);
+    profile->dirty = 1;
+}
+
+void latency_add_gap(profile_t* profile, latency_t* latency, double sec)
+{
+    add(latency->gap, &latency->ngap, sec);
+    profile->dirty = 1;
+}
+
+void latency_reset(profile_t* profile, latency_t* latency)
+{
+    latency->nfirst = 0;
+    profile->dirty = 1;
+}
+
+void latency_reset_gap(profile_t* profile, latency_t* latency)
+{
+    latency->ngap = 0;
+    profile->dirty = 1;
+}
+
+double latency_first(const latency_t* latency, double timeout)
+{
+    if (latency->nfirst < MIN_SAMPLES) return timeout;
+
+    double d = FIRST_FACTOR * percentile(latency->first, latency->nfirst,
+            PERCENTILE) + FIRST_MARGIN;
+    return d < timeout ? d : timeout;
+}
+
+double latency_gap(const latency_t* latency, double timeout)
+{
+    if (latency->ngap < MIN_SAMPLES) return timeout;
+
+    double d = GAP_FACTOR * percentile(latency->gap, latency->ngap,
+            PERCENTILE) + GAP_MARGIN;
+    return d < timeout ? d : timeout;
+}
@@ -0,0 +1,115 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : libtrx.c
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/config.h"
+#include "../include/libtrx.h"
+#include "../include/portsettings.h"
+#include "../include/registry.h"
+#include "../include/serial.h"
+
+/**
+ * session with one serial device
+ */
+struct trx {
+    portsettings_t portsettings; /**< settings and open port */
+    registry_t registry;         /**< device index, opened when a name is
+                                      looked up */
+};
+
+/**
+ * settings of the line itself, the port is reopened when they change
+ */
+static const char* const line_settings[] = {
+    "port", "baudrate", "databits", "parity", "stopbits", "flow",
+    "lowlatency",
+};
+
+int trx_open(trx_t** trx, const char* device)
+{
+    trx_t* t = calloc(1, sizeof(trx_t));
+
+    *trx = NULL;
+    if (!t) return TRX_ENOMEM;
+    t->portsettings = portsettings_default();
+
+    if (device && config_load(&t->registry, &t->portsettings, device,
+                config_apply) == -1) {
+        trx_close(t);
+        return TRX_ENODEV;
+    }
+    *trx = t;
+    return TRX_OK;
+}
+
+int trx_set(trx_t* trx, const char* key, const char* value)
+{
+    if (!key || !value) return TRX_EINVAL;
+
+    errno = 0;
+    if (config_set(&trx->portsettings, key, value) != 0) {
+        return errno == ENOMEM ? TRX_ENOMEM : TRX_EINVAL;
+    }
+
+    for (size_t i = 0; i < sizeof(line_settings)/sizeof(*line_settings); i++) {
+        if (strcmp(key, line_settings[i]) == 0) {
+            serial_die(&trx->portsettings);
+            break;
+        }
+    }
+    return TRX_OK;
+}
+
+int trx_transact(trx_t* trx, const char* cmd, trx_line_t line, void* arg)
+{
+    portsettings_t* ps = &trx->portsettings;
+    timing_t timing = portsettings_timing(ps);
+    unsigned int n = 0;
+    char* data;
+    size_t len;
+
+    if (ps->fd == -1 && serial_init(ps) == -1) return TRX_EPORT;
+    if (serial_tx(ps, cmd) == -1) return TRX_EIO;
+
+    while ((ps->count == UINT_MAX || n < ps->count) && n < INT_MAX) {
+        if (serial_rx(ps, &data, &len, &timing) == -1) return TRX_EIO;
+
+        /* timeout */
+        if (!data) break;
+
+        n++;
+        if (line) line(data, len, arg);
+    }
+    return (int)n;
+}
+
+void trx_close(trx_t* trx)
+{
+    if (!trx) return;
+
+    serial_die(&trx->portsettings);
+    portsettings_die(&trx->portsettings);
+    registry_close(&trx->registry);
+    free(trx);
+}
+
+const char* trx_strerror(int status)
+{
+    switch (status) {
+        case TRX_EINVAL: return "invalid setting";
+        case TRX_ENODEV: return "unknown device";
+        case TRX_EPORT: return "port could not be opened";
+        case TRX_EIO: return "transmission failed";
+        case TRX_ENOMEM: return "out of memory";
+        default: return status >= 0 ? "succes" : "unknown error";
+    }
+}
+
+// vim:ft=c
@@ -0,0 +1,517 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : output.c
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/output.h"
+
+/**
+ * sec a partially filled chunk may wait before it is written anyway
+ */
+#define OUTPUT_LATENCY 1
+
+/**
+ * get a written chunk for reuse or allocate one, lock must be held
+ */
+static chunk_t* take_chunk(output_t* output);
+
+/**
+ * queue current chunk, blocks while the queue is full, lock must be held
+ */
+static void submit(output_t* output);
+
+/**
+ * append bytes to current chunk, lock must be held
+ */
+static void put(output_t* output, const char* data, size_t len);
+
+/**
+ * append string escaped for json or csv, lock must be held
+ */
+static void put_json(output_t* output, const char* data, size_t len);
+static void put_csv(output_t* output, const char* data, size_t len);
+
+/**
+ * append bytes as hex, lock must be held
+ */
+static void put_hex(output_t* output, const char* data, size_t len);
+
+/**
+ * append response as text or hex, escaped for the output format
+ */
+static void put_field(output_t* output, const char* data, size_t len, int hex);
+
+/**
+ * rename the output file to path.N and start a new one
+ */
+static int rotate(output_t* output);
+
+/**
+ * write all bytes, retrying short writes
+ *
+ * @return 0 for succes or errno of the failed write
+ */
+static int write_all(output_t* output, const char* data, size_t len);
+
+/**
+ * write chunks in order, rotating the file in between where needed
+ *
+ * consecutive chunks that go to the same file are submitted to the ring as
+ * linked writes at once, what a write left is written synchronously
+ *
+ * @return 0 for succes or errno of the first failure
+ */
+static int write_chunks(output_t* output, chunk_t** chunks, size_t n);
+
+/**
+ * write queued chunks until output is closed
+ */
+static void* writer(void* arg);
+
+int output_parse_format(output_format_t* format, const char* str)
+{
+    if (!str) return -1;
+    else if (strcmp(str, "raw") == 0) *format = OUTPUT_RAW;
+    else if (strcmp(str, "csv") == 0) *format = OUTPUT_CSV;
+    else if (strcmp(str, "json") == 0) *format = OUTPUT_JSON;
+    else return -1;
+    return 0;
+}
+
+int output_parse_size(off_t* size, const char* str)
+{
+    char* end;
+    if (!str || !*str || *str == '-') return -1;
+
+    long long l = strtoll(str, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': l *= 1024; end++; break;
+        case 'm': case 'M': l *= 1024 * 1024; end++; break;
+        case 'g': case 'G': l *= 1024 * 1024 * 1024; end++; break;
+        default: break;
+    }
+    if (*end || l <= 0) return -1;
+    *size = (off_t)l;
+    return 0;
+}
+
+chunk_t* take_chunk(output_t* output)
+{
+    chunk_t* chunk = output->nspare ? output->spare[--output->nspare]
+        : malloc(sizeof(chunk_t));
+    if (chunk) chunk->len = 0;
+    return chunk;
+}
+
+void submit(output_t* output)
+{
+    if (!output->current || !output->current->len) return;
+
+    while (output->used == OUTPUT_QUEUE) {
+        pthread_cond_wait(&output->room, &output->lock);
+    }
+    output->queue[(output->head + output->used++) % OUTPUT_QUEUE]
+        = output->current;
+    output->current = NULL;
+    pthread_cond_signal(&output->ready);
+}
+
+void put(output_t* output, const char* data, size_t len)
+{
+    while (len) {
+        if (output->current && output->current->len == OUTPUT_CHUNK) {
+            submit(output);
+        }
+        if (!output->current && !(output->current = take_chunk(output))) {
+            output->error = ENOMEM;
+            return;
+        }
+
+        chunk_t* c = output->current;
+        size_t n = OUTPUT_CHUNK - c->len < len ? OUTPUT_CHUNK - c->len : len;
+        memcpy(c->data + c->len, data, n);
+        c->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void put_json(output_t* output, const char* data, size_t len)
+{
+    char esc[8];
+    size_t start = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        put(output, data + start, i - start);
+        start = i + 1;
+        if (c == '"' || c == '\\') snprintf(esc, sizeof(esc), "\\%c", c);
+        else snprintf(esc, sizeof(esc), "\\u%04x", c);
+        put(output, esc, strlen(esc));
+    }
+    put(output, data + start, len - start);
+}
+
+void put_csv(output_t* output, const char* data, size_t len)
+{
+    size_t start = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != '"') continue;
+        put(output, data + start, i - start + 1);
+        start = i;
+    }
+    put(output, data + start, len - start);
+}
+
+void put_hex(output_t* output, const char* data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    char pair[2];
+
+    for (size_t i = 0; i < len; i++) {
+        pair[0] = digits[(unsigned char)data[i] >> 4];
+        pair[1] = digits[(unsigned char)data[i] & 0x0f];
+        put(output, pair, 2);
+    }
+}
+
+void put_field(output_t* output, const char* data, size_t len, int hex)
+{
+    if (hex) put_hex(output, data, len);
+    else if (output->format == OUTPUT_JSON) put_json(output, data, len);
+    else if (output->format == OUTPUT_CSV) put_csv(output, data, len);
+    else put(output, data, len);
+}
+
+int rotate(output_t* output)
+{
+    struct stat st;
+    char* path = malloc(strlen(output->path) + 16);
+    if (!path) return -1;
+
+    /* earlier runs may have left segments */
+    do {
+        sprintf(path, "%s.%u", output->path, ++output->segment);
+    } while (stat(path, &st) == 0);
+
+    close(output->fd);
+    if (rename(output->path, path) == -1) {
+        fprintf(stderr, "error rotating %s: %s\n", output->path,
+                strerror(errno));
+        free(path);
+        output->fd = -1;
+        return -1;
+    }
+    free(path);
+
+    output->fd = open(output->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    output->written = 0;
+    if (output->fd == -1) {
+        fprintf(stderr, "error opening %s: %s\n", output->path,
+                strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int write_all(output_t* output, const char* data, size_t len)
+{
+    for (size_t off = 0; off < len && output->fd != -1;) {
+        ssize_t n = write(output->fd, data + off, len - off);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        off += (size_t)n;
+        output->written += n;
+    }
+    return 0;
+}
+
+int write_chunks(output_t* output, chunk_t** chunks, size_t n)
+{
+    int res[OUTPUT_QUEUE];
+    int error = 0;
+
+    for (size_t k = 0; k < n && output->fd != -1;) {
+
+        /* chunks start with a record, so files are not split mid-record */
+        if (output->rotate && output->written >= output->rotate
+                && rotate(output) == -1 && !error) {
+            error = errno;
+        }
+
+        /* the chunks up to the next rotation */
+        size_t end = k + 1;
+        off_t size = (off_t)chunks[k]->len;
+        while (end < n && (!output->rotate
+                    || output->written + size < output->rotate)) {
+            size += (off_t)chunks[end++]->len;
+        }
+
+        size_t count = end - k;
+        size_t queued = 0;
+        size_t got = 0;
+        for (size_t i = 0; i < count; i++) res[i] = 0;
+
+        /* a short write breaks the link, the rest is cancelled */
+        if (output->ring.fd != -1 && count > 1) {
+            for (size_t i = k; i < end; i++) {
+                if (uring_write(&output->ring, output->fd, chunks[i]->data,
+                            (unsigned int)chunks[i]->len, i - k,
+                            i + 1 < end) == -1) {
+                    break;
+                }
+                queued++;
+            }
+
+            /* what could not be queued is written synchronously after the
+             * chain, which must not link to a request that never comes */
+            if (queued < count) uring_unlink(&output->ring);
+
+            while (got < queued) {
+                uint64_t data;
+                int r;
+                if (uring_submit(&output->ring, 1) == -1) {
+                    if (errno == EINTR) continue;
+
+                    /* the kernel cancels what is left with the ring */
+                    fprintf(stderr, "output: io_uring failed: %s, writing "
+                            "synchronously\n", strerror(errno));
+                    uring_die(&output->ring);
+                    break;
+                }
+                while (uring_complete(&output->ring, &data, &r)) {
+                    if (data < count) res[data] = r;
+                    got++;
+                }
+            }
+        }
+
+        for (size_t i = k; i < end && output->fd != -1; i++) {
+            size_t done = res[i - k] > 0 ? (size_t)res[i - k] : 0;
+            output->written += (off_t)done;
+            if (res[i - k] < 0 && res[i - k] != -ECANCELED
+                    && res[i - k] != -EINTR && res[i - k] != -EAGAIN) {
+                if (!error) error = -res[i - k];
+                return error;
+            }
+            int e = write_all(output, chunks[i]->data + done,
+                    chunks[i]->len - done);
+            if (e) return error ? error : e;
+        }
+        k = end;
+    }
+    return error;
+}
+
+void* writer(void* arg)
+{
+    output_t* output = arg;
+
+    pthread_mutex_lock(&output->lock);
+    for (;;) {
+
+        /* a slow trickle of records is written at least every second */
+        while (!output->used && !output->done) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += OUTPUT_LATENCY;
+            if (pthread_cond_timedwait(&output->ready, &output->lock, &ts)
+                    == ETIMEDOUT) {
+                submit(output);
+            }
+        }
+        if (!output->used) break;
+
+        /* with a ring everything queued is taken at once */
+        chunk_t* chunks[OUTPUT_QUEUE];
+        size_t n = 0;
+        do {
+            chunks[n++] = output->queue[output->head];
+            output->head = (output->head + 1) % OUTPUT_QUEUE;
+            output->used--;
+        } while (output->used && output->ring.fd != -1);
+        output->writing = n;
+        pthread_cond_signal(&output->room);
+        pthread_mutex_unlock(&output->lock);
+
+        int error = write_chunks(output, chunks, n);
+
+        pthread_mutex_lock(&output->lock);
+        if (error && !output->error) output->error = error;
+        output->writing = 0;
+        pthread_cond_broadcast(&output->room);
+        for (size_t i = 0; i < n; i++) {
+            if (output->nspare < OUTPUT_QUEUE) {
+                output->spare[output->nspare++] = chunks[i];
+            } else {
+                free(chunks[i]);
+            }
+        }
+    }
+    pthread_mutex_unlock(&output->lock);
+    return NULL;
+}
+
+int output_open(output_t* output, const char* path, output_format_t format,
+        off_t rotate_size, int uring)
+{
+    struct stat st;
+
+    memset(output, 0, sizeof(output_t));
+    output->ring.fd = -1;
+
+    output->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (output->fd == -1) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+        return -1;
+    }
+    if (fstat(output->fd, &st) == 0) output->written = st.st_size;
+
+    output->path = malloc(strlen(path)+1);
+    strcpy(output->path, path);
+    output->format = format;
+    output->rotate = rotate_size;
+
+    pthread_mutex_init(&output->lock, NULL);
+    pthread_cond_init(&output->ready, NULL);
+    pthread_cond_init(&output->room, NULL);
+
+    if (uring && uring_init(&output->ring, OUTPUT_QUEUE) == -1) {
+        fprintf(stderr, "output: io_uring unavailable: %s, writing "
+                "synchronously\n", strerror(errno));
+    }
+
+    if (pthread_create(&output->thread, NULL, writer, output) != 0) {
+        fprintf(stderr, "error starting output thread\n");
+        if (output->ring.fd != -1) uring_die(&output->ring);
+        close(output->fd);
+        free(output->path);
+        return -1;
+    }
+    return 0;
+}
+
+int output_write(output_t* output, const char* device, const char* cmd,
+        const char* line, size_t len, int hex)
+{
+    char stamp[40];
+    struct timespec ts;
+    struct tm tm;
+
+    if (output->format != OUTPUT_RAW) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        gmtime_r(&ts.tv_sec, &tm);
+        size_t n = strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+        snprintf(stamp + n, sizeof(stamp) - n, ".%06ldZ", ts.tv_nsec / 1000);
+    }
+
+    pthread_mutex_lock(&output->lock);
+
+    /* start a new chunk unless the whole record surely fits, so a chunk
+     * only splits a record that is larger than a chunk by itself */
+    size_t bound = 64 + sizeof(stamp) + 6 * (len + strlen(cmd)
+            + (device ? strlen(device) : 0));
+    if (output->current && output->current->len + bound > OUTPUT_CHUNK) {
+        submit(output);
+    }
+
+    switch (output->format) {
+        case OUTPUT_CSV:
+            put(output, stamp, strlen(stamp));
+            put(output, ",\"", 2);
+            if (device) put_csv(output, device, strlen(device));
+            put(output, "\",\"", 3);
+            put_csv(output, cmd, strlen(cmd));
+            put(output, "\",\"", 3);
+            put_field(output, line, len, hex);
+            put(output, "\"\n", 2);
+            break;
+
+        case OUTPUT_JSON:
+            put(output, "{\"time\":\"", 9);
+            put(output, stamp, strlen(stamp));
+            if (device) {
+                put(output, "\",\"device\":\"", 12);
+                put_json(output, device, strlen(device));
+            }
+            put(output, "\",\"command\":\"", 13);
+            put_json(output, cmd, strlen(cmd));
+            put(output, "\",\"response\":\"", 14);
+            put_field(output, line, len, hex);
+            put(output, "\"}\n", 3);
+            break;
+
+        case OUTPUT_RAW:
+        default:
+            put_field(output, line, len, hex);
+            put(output, "\n", 1);
+            break;
+    }
+
+    int status = output->error ? -1 : 0;
+    pthread_mutex_unlock(&output->lock);
+    return status;
+}
+
+int output_sync(output_t* output)
+{
+    pthread_mutex_lock(&output->lock);
+    submit(output);
+    while (output->used || output->writing) {
+        pthread_cond_wait(&output->room, &output->lock);
+    }
+
+    /* nothing is in flight, the file can not be rotated meanwhile */
+    if (fdatasync(output->fd) == -1 && !output->error) output->error = errno;
+    int status = output->error ? -1 : 0;
+    pthread_mutex_unlock(&output->lock);
+    return status;
+}
+
+int output_close(output_t* output)
+{
+    if (!output->path) return 0;
+
+    pthread_mutex_lock(&output->lock);
+    submit(output);
+    output->done = 1;
+    pthread_cond_signal(&output->ready);
+    pthread_mutex_unlock(&output->lock);
+
+    pthread_join(output->thread, NULL);
+    if (output->ring.fd != -1) uring_die(&output->ring);
+
+    if (output->fd != -1 && close(output->fd) == -1 && !output->error) {
+        output->error = errno;
+    }
+    if (output->error) {
+        fprintf(stderr, "error writing \"%s\": %s\n", output->path,
+                strerror(output->error));
+    }
+
+    int status = output->error ? -1 : 0;
+    for (size_t i = 0; i < output->nspare; i++) free(output->spare[i]);
+    free(output->current);
+    free(output->path);
+    pthread_mutex_destroy(&output->lock);
+    pthread_cond_destroy(&output->ready);
+    pthread_cond_destroy(&output->room);
+    memset(output, 0, sizeof(output_t));
+    output->fd = -1;
+    return status;
+}
@@ -4,6 +4,7 @@
  * @filename    : portsettings.c
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,25 +19,49 @@ portsettings_t portsettings_default(void)
         .count = (unsigned int)-1,
         .port = NULL,
         .timeout = 0,
+        .databits = 8,
+        .parity = 'n',
+        .stopbits = 1,
+        .fd = -1,
     };
+    rxbuf_parse_delimiter(&portsettings.delimiter, "lf");
+    rxbuf_parse_delimiter(&portsettings.terminator, "cr");
     return portsettings;
 }
 
+portsettings_t portsettings_copy(const portsettings_t* portsettings)
+{
+    portsettings_t copy = *portsettings;
+
+    copy.port = NULL;
+    copy.probe = NULL;
+    copy.expect = NULL;
+    copy.fd = -1;
+    copy.tx = NULL;
+    copy.txlen = 0;
+    copy.txsize = 0;
+    copy.record = NULL;
+    copy.asynclow = 0;
+    memset(&copy.rx, 0, sizeof(rxbuf_t));
+
+    if (portsettings->port) {
+        copy.port = calloc(strlen(portsettings->port)+1, 1);
+        if (copy.port) strcpy(copy.port, portsettings->port);
+    }
+    if (portsettings->probe) portsettings_set_probe(&copy, portsettings->probe);
+    if (portsettings->expect) portsettings_set_expect(&copy, portsettings->expect);
+    return copy;
+}
+
 int portsettings_set_baudrate(portsettings_t* portsettings, const char* str)
 {
-    speed_t baudrate = 0;
+    char* end;
     if (!str || !*str) return -1;
 
-    /* TODO: add all valid baudrates */
-    switch (atol(str)) {
-        case 2400: baudrate = B2400; break;
-        case 4800: baudrate = B4800; break;
-        case 9600: baudrate = B9600; break;
-        case 19200: baudrate = B19200; break;
-        case 38400: baudrate = B38400; break;
-        default: return -1;
-    }
-    portsettings->baudrate = baudrate;
+    unsigned long baudrate = strtoul(str, &end, 10);
+    if (*end || !baudrate || baudrate > UINT_MAX || *str == '-') return -1;
+
+    portsettings->baudrate = (speed_t)baudrate;
     return 0;
 }
 
@@ -44,7 +69,9 @@ int portsettings_set_port(portsettings_t* portsettings, const char* str)
 {
     if (!str || !*str) return -1;
 
+    free(portsettings->port);
     portsettings->port = calloc(strlen(str)+1, 1);
+    if (!portsettings->port) return -1;
     strcpy(portsettings->port, str);
 
     return access(portsettings->port, F_OK);
@@ -58,22 +85,180 @@ int portsettings_set_timeout(portsettings_t* portsettings, const char* str)
     return 0;
 }
 
+int portsettings_set_first(portsettings_t* portsettings, const char* str)
+{
+    double d = atof(str);
+    if (d <= 0) return -1;
+    portsettings->first = d;
+    return 0;
+}
+
+int portsettings_set_gap(portsettings_t* portsettings, const char* str)
+{
+    double d = atof(str);
+    if (d <= 0) return -1;
+    portsettings->gap = d;
+    return 0;
+}
+
+int portsettings_set_total(portsettings_t* portsettings, const char* str)
+{
+    double d = atof(str);
+    if (d <= 0) return -1;
+    portsettings->total = d;
+    return 0;
+}
+
+timing_t portsettings_timing(const portsettings_t* portsettings)
+{
+    timing_t timing = {
+        .first = portsettings->first ? portsettings->first : portsettings->timeout,
+        .gap = portsettings->gap ? portsettings->gap : portsettings->timeout,
+        .total = portsettings->total,
+    };
+    return timing;
+}
+
 int portsettings_set_count(portsettings_t* portsettings, const char* str)
 {
-    int i = atoi(str);
-    if (i <= 0 && i != -1) return -1;
+    char* end;
+    if (!str || !*str) return -1;
+
+    long i = strtol(str, &end, 10);
+    if (*end || (i < 0 && i != -1) || i > INT_MAX) return -1;
     portsettings->count = (unsigned int)i;
     return 0;
 }
 
+int portsettings_set_delimiter(portsettings_t* portsettings, const char* str)
+{
+    return rxbuf_parse_delimiter(&portsettings->delimiter, str);
+}
+
+int portsettings_set_terminator(portsettings_t* portsettings, const char* str)
+{
+    if (str && strcmp(str, "none") == 0) {
+        memset(&portsettings->terminator, 0, sizeof(delimiter_t));
+        return 0;
+    }
+    return rxbuf_parse_delimiter(&portsettings->terminator, str);
+}
+
+int portsettings_set_databits(portsettings_t* portsettings, const char* str)
+{
+    if (!str || str[0] < '5' || str[0] > '8' || str[1]) return -1;
+    portsettings->databits = (unsigned int)(str[0] - '0');
+    return 0;
+}
+
+int portsettings_set_parity(portsettings_t* portsettings, const char* str)
+{
+    static const char* names[] = { "none", "even", "odd", "mark", "space" };
+
+    if (!str) return -1;
+    for (size_t i = 0; i < sizeof(names)/sizeof(names[0]); i++) {
+        if (strcmp(str, names[i]) == 0) {
+            portsettings->parity = names[i][0];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int portsettings_set_stopbits(portsettings_t* portsettings, const char* str)
+{
+    if (!str || (strcmp(str, "1") != 0 && strcmp(str, "2") != 0)) return -1;
+    portsettings->stopbits = (unsigned int)(str[0] - '0');
+    return 0;
+}
+
+int portsettings_set_flow(portsettings_t* portsettings, const char* str)
+{
+    if (!str) return -1;
+    else if (strcmp(str, "none") == 0) portsettings->flow = FLOW_NONE;
+    else if (strcmp(str, "rtscts") == 0) portsettings->flow = FLOW_RTSCTS;
+    else if (strcmp(str, "xonxoff") == 0) portsettings->flow = FLOW_XONXOFF;
+    else return -1;
+    return 0;
+}
+
+int portsettings_set_framing(portsettings_t* portsettings, const char* str)
+{
+    if (framing_parse(&portsettings->framing, str) == -1) return -1;
+
+    /* binary payloads can only be given and shown as hex on the cli */
+    if (portsettings->framing != FRAMING_LINE) portsettings->hex = 1;
+    return 0;
+}
+
+int portsettings_set_spin(portsettings_t* portsettings, const char* str)
+{
+    char* end;
+    if (!str || !*str || *str == '-') return -1;
+
+    unsigned long usec = strtoul(str, &end, 10);
+    if (*end || usec > 1000000) return -1;
+    portsettings->spin = (unsigned int)usec;
+    return 0;
+}
+
+int portsettings_set_probe(portsettings_t* portsettings, const char* str)
+{
+    if (!str || !*str) return -1;
+
+    free(portsettings->probe);
+    portsettings->probe = calloc(strlen(str)+1, 1);
+    if (!portsettings->probe) return -1;
+    strcpy(portsettings->probe, str);
+    return 0;
+}
+
+int portsettings_set_expect(portsettings_t* portsettings, const char* str)
+{
+    if (!str || !*str) return -1;
+
+    free(portsettings->expect);
+    portsettings->expect = calloc(strlen(str)+1, 1);
+    if (!portsettings->expect) return -1;
+    strcpy(portsettings->expect, str);
+    return 0;
+}
+
 void portsettings_print(const portsettings_t* portsettings)
 {
     if (portsettings->port) printf("%-12s = %s\n", "port", portsettings->port);
     else printf("%-12s = none\n", "port");
 
-    printf("%-12s = %i\n", "baudrate", portsettings->baudrate);
+    printf("%-12s = %u\n", "baudrate", portsettings->baudrate);
     printf("%-12s = %f\n", "timeout", portsettings->timeout);
+    printf("%-12s = %f\n", "first", portsettings_timing(portsettings).first);
+    printf("%-12s = %f\n", "gap", portsettings_timing(portsettings).gap);
+    printf("%-12s = %f\n", "total", portsettings->total);
     printf("%-12s = %i\n", "count", portsettings->count);
+
+    printf("%-12s =", "delimiter");
+    for (size_t i = 0; i < portsettings->delimiter.len; i++) {
+        printf(" 0x%02x", (unsigned char)portsettings->delimiter.bytes[i]);
+    }
+    printf("\n");
+
+    printf("%-12s =", "terminator");
+    for (size_t i = 0; i < portsettings->terminator.len; i++) {
+        printf(" 0x%02x", (unsigned char)portsettings->terminator.bytes[i]);
+    }
+    printf("\n");
+
+    printf("%-12s = %u%c%u\n", "line", portsettings->databits,
+            portsettings->parity - 'a' + 'A', portsettings->stopbits);
+    printf("%-12s = %s\n", "flow", portsettings->flow == FLOW_RTSCTS ? "rtscts"
+            : portsettings->flow == FLOW_XONXOFF ? "xonxoff" : "none");
+    printf("%-12s = %s\n", "framing", framing_name(portsettings->framing));
+    printf("%-12s = %i\n", "hex", portsettings->hex);
+    printf("%-12s = %i\n", "drain", portsettings->drain);
+    printf("%-12s = %i\n", "lowlatency", portsettings->lowlatency);
+    printf("%-12s = %u us\n", "spin", portsettings->spin);
+    if (portsettings->probe) printf("%-12s = %s\n", "probe", portsettings->probe);
+    if (portsettings->expect) printf("%-12s = %s\n", "expect", portsettings->expect);
 }
 
 void portsettings_die(portsettings_t* portsettings)
@@ -82,4 +267,13 @@ void portsettings_die(portsettings_t* portsettings)
         free(portsettings->port);
         portsettings->port = NULL;
     }
+    free(portsettings->probe);
+    portsettings->probe = NULL;
+    free(portsettings->expect);
+    portsettings->expect = NULL;
+    rxbuf_die(&portsettings->rx);
+    free(portsettings->tx);
+    portsettings->tx = NULL;
+    portsettings->txlen = 0;
+    portsettings->txsize = 0;
 }
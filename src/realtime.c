@@ -0,0 +1,34 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : realtime.c
+ */
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "../include/realtime.h"
+
+int realtime_pin(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET((size_t)cpu, &set);
+    return sched_setaffinity(0, sizeof(cpu_set_t), &set);
+}
+
+int realtime_fifo(int priority)
+{
+    struct sched_param param = { .sched_priority = priority };
+    return sched_setscheduler(0, SCHED_FIFO, &param);
+}
+
+int realtime_lock(void)
+{
+    return mlockall(MCL_CURRENT | MCL_FUTURE);
+}
+
+// vim:ft=c
@@ -0,0 +1,417 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : record.c
+ */
+
+/* ptys and ppoll() */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/record.h"
+#include "../include/rxbuf.h"
+
+/**
+ * first bytes of every log
+ */
+#define RECORD_MAGIC "TRXREC1\n"
+
+/**
+ * max length of an entry header: type and two varints
+ */
+#define RECORD_HEADER (1 + 10 + 10)
+
+/**
+ * current CLOCK_MONOTONIC time
+ *
+ * @return nsec
+ */
+static uint64_t now(void);
+
+/**
+ * append LEB128 varint
+ *
+ * @param[out] p destination, at least 10 bytes
+ * @param[in] v value
+ * @return number of bytes used
+ */
+static size_t put_varint(char* p, uint64_t v);
+
+/**
+ * parse LEB128 varint
+ *
+ * @param[in,out] p read position, advanced past the varint
+ * @param[in] end end of data
+ * @param[out] v value
+ * @return status 0 for succes, -1 if truncated
+ */
+static int get_varint(const unsigned char** p, const unsigned char* end,
+        uint64_t* v);
+
+/**
+ * write all bytes, retrying short writes
+ *
+ * @param[in] fd file descriptor
+ * @param[in] data bytes to write
+ * @param[in] len length of data
+ * @return status 0 for succes, -1 for failure
+ */
+static int write_all(int fd, const char* data, size_t len);
+
+/**
+ * write buffered entries to the log
+ *
+ * @param[in,out] record open log, closed when the write fails
+ * @return status 0 for succes, -1 for failure
+ */
+static int flush(record_t* record);
+
+/**
+ * open pty pair in raw mode
+ *
+ * @param[out] slave open slave side, keeps the master from hanging up until
+ *             the client has opened it
+ * @return master file descriptor or -1 for failure
+ */
+static int open_pty(int* slave);
+
+/**
+ * wait for input of the client until a deadline
+ *
+ * @param[in] fd master side of the pty
+ * @param[in,out] in bytes received from the client
+ * @param[in] deadline monotonic nsec, 0 to wait for a single read
+ * @return status 0 for succes, -1 if the client hung up or on failure
+ */
+static int receive(int fd, rxbuf_t* in, uint64_t deadline);
+
+uint64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+size_t put_varint(char* p, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (char)v;
+    return n;
+}
+
+int get_varint(const unsigned char** p, const unsigned char* end, uint64_t* v)
+{
+    *v = 0;
+    for (unsigned int shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char c = *(*p)++;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return 0;
+    }
+    return -1;
+}
+
+int write_all(int fd, const char* data, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, data, len);
+        if (n == -1) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int flush(record_t* record)
+{
+    if (record->fd == -1) return -1;
+    if (write_all(record->fd, record->buf, record->len) == -1) {
+        fprintf(stderr, "error writing record: %s\n", strerror(errno));
+        close(record->fd);
+        record->fd = -1;
+        return -1;
+    }
+    record->len = 0;
+    return 0;
+}
+
+int record_open(record_t* record, const char* path)
+{
+    struct stat st;
+
+    memset(record, 0, sizeof(record_t));
+    record->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (record->fd == -1 || fstat(record->fd, &st) == -1) {
+        fprintf(stderr, "error opening record %s: %s\n", path, strerror(errno));
+        if (record->fd != -1) close(record->fd);
+        record->fd = -1;
+        return -1;
+    }
+
+    if (!(record->buf = malloc(RECORD_BUFFER))) {
+        close(record->fd);
+        record->fd = -1;
+        return -1;
+    }
+
+    if (!st.st_size) {
+        memcpy(record->buf, RECORD_MAGIC, strlen(RECORD_MAGIC));
+        record->len = strlen(RECORD_MAGIC);
+    }
+
+    /* a run starts from an absolute time, later entries are deltas */
+    record->last = now();
+    record->buf[record->len++] = RECORD_START;
+    record->len += put_varint(record->buf + record->len, record->last);
+    record->len += put_varint(record->buf + record->len, 0);
+    return 0;
+}
+
+int record_write(record_t* record, record_type_t type,
+        const struct iovec* iov, int iovcnt)
+{
+    uint64_t t = now();
+    size_t len = 0;
+
+    for (int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+
+    if (record->fd == -1) return -1;
+    if (record->len + RECORD_HEADER + len > RECORD_BUFFER
+            && flush(record) == -1) {
+        return -1;
+    }
+
+    record->buf[record->len++] = (char)type;
+    record->len += put_varint(record->buf + record->len, t - record->last);
+    record->len += put_varint(record->buf + record->len, len);
+    record->last = t;
+
+    /* large chunks bypass the buffer */
+    if (record->len + len > RECORD_BUFFER) {
+        if (flush(record) == -1) return -1;
+        for (int i = 0; i < iovcnt; i++) {
+            if (write_all(record->fd, iov[i].iov_base, iov[i].iov_len) == -1) {
+                fprintf(stderr, "error writing record: %s\n", strerror(errno));
+                close(record->fd);
+                record->fd = -1;
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(record->buf + record->len, iov[i].iov_base, iov[i].iov_len);
+        record->len += iov[i].iov_len;
+    }
+    return 0;
+}
+
+int record_close(record_t* record)
+{
+    int status = 0;
+
+    if (record->fd != -1) {
+        status = flush(record);
+        if (record->fd != -1) close(record->fd);
+    }
+    free(record->buf);
+    record->buf = NULL;
+    record->fd = -1;
+    return status;
+}
+
+int open_pty(int* slave)
+{
+    struct termios tty;
+    int fd;
+
+    if ((fd = posix_openpt(O_RDWR | O_NOCTTY)) == -1
+            || grantpt(fd) == -1 || unlockpt(fd) == -1) {
+        fprintf(stderr, "error opening pty: %s\n", strerror(errno));
+        if (fd != -1) close(fd);
+        return -1;
+    }
+    if ((*slave = open(ptsname(fd), O_RDWR | O_NOCTTY)) == -1) {
+        fprintf(stderr, "error opening %s: %s\n", ptsname(fd), strerror(errno));
+        close(fd);
+        return -1;
+    }
+    tcgetattr(*slave, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(*slave, TCSANOW, &tty);
+    return fd;
+}
+
+int receive(int fd, rxbuf_t* in, uint64_t deadline)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    struct timespec ts;
+    struct timespec* timeout = NULL;
+
+    if (deadline) {
+        uint64_t t = now();
+        uint64_t wait = deadline > t ? deadline - t : 0;
+        ts.tv_sec = (time_t)(wait / 1000000000u);
+        ts.tv_nsec = (long)(wait % 1000000000u);
+        timeout = &ts;
+    }
+
+    switch (ppoll(&pfd, 1, timeout, NULL)) {
+        case -1:
+            return errno == EINTR ? 0 : -1;
+        case 0:
+            return 0;
+        default:
+            break;
+    }
+
+    /* all slave descriptors are closed */
+    if (rxbuf_fill(in, fd) <= 0) return -1;
+    return 0;
+}
+
+int record_replay(const char* path, double speed,
+        volatile sig_atomic_t* killed)
+{
+    struct stat st;
+    rxbuf_t in = { 0 };
+    unsigned char* map;
+    int fd;
+    int slave;
+    int master;
+    size_t entries = 0;
+    size_t mismatches = 0;
+    int status = 0;
+
+    if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+        fprintf(stderr, "error opening record %s: %s\n", path, strerror(errno));
+        if (fd != -1) close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < strlen(RECORD_MAGIC)) {
+        fprintf(stderr, "%s: not a record\n", path);
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "error mapping record %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (memcmp(map, RECORD_MAGIC, strlen(RECORD_MAGIC)) != 0) {
+        fprintf(stderr, "%s: not a record\n", path);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    if ((master = open_pty(&slave)) == -1) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    printf("%s\n", ptsname(master));
+    fflush(stdout);
+
+    const unsigned char* p = map + strlen(RECORD_MAGIC);
+    const unsigned char* end = map + st.st_size;
+    uint64_t ts = 0;       /* recorded time of the current entry */
+    uint64_t anchor = 0;   /* recorded time of the last transmission */
+    uint64_t wall = now(); /* monotonic time the anchor was replayed */
+
+    while (p < end && !*killed) {
+        uint64_t delta, len;
+        unsigned char type = *p++;
+
+        if (get_varint(&p, end, &delta) == -1 || get_varint(&p, end, &len) == -1
+                || len > (uint64_t)(end - p)) {
+            fprintf(stderr, "%s: truncated after %zu entries\n", path, entries);
+            break;
+        }
+        ts = type == RECORD_START ? delta : ts + delta;
+        entries++;
+
+        switch (type) {
+
+            /* a new run replays from its own start */
+            case RECORD_START:
+                anchor = ts;
+                wall = now();
+                break;
+
+            /* the recorded timing restarts from the client's command */
+            case RECORD_TX:
+                while (in.tail - in.head < len && !*killed) {
+                    if (receive(master, &in, 0) == -1) goto hangup;
+
+                    /* the client has the pty open, it may now hang up */
+                    if (slave != -1) {
+                        close(slave);
+                        slave = -1;
+                    }
+                }
+                if (*killed) break;
+                if (memcmp(in.data + in.head, p, len) != 0) mismatches++;
+                in.head += len;
+                anchor = ts;
+                wall = now();
+                break;
+
+            case RECORD_RX: {
+                uint64_t due = wall + (uint64_t)(speed > 0
+                        ? (double)(ts - anchor) / speed : 0);
+                while (now() < due && !*killed) {
+                    if (receive(master, &in, due) == -1) goto hangup;
+                }
+                if (write_all(master, (const char*)p, len) == -1) goto hangup;
+                break;
+            }
+
+            default:
+                fprintf(stderr, "%s: unknown entry '%c'\n", path, type);
+                status = -1;
+                p = end;
+                continue;
+        }
+        p += len;
+    }
+
+    /* keep the responses readable until the client is done */
+    while (!*killed && receive(master, &in, 0) != -1) {
+        in.head = in.tail;
+    }
+
+hangup:
+    if (mismatches) {
+        fprintf(stderr, "replay: %zu transmissions differ from the record\n",
+                mismatches);
+    }
+    if (p < end && !*killed) {
+        fprintf(stderr, "replay: client hung up after %zu entries\n", entries);
+    }
+    if (slave != -1) close(slave);
+    close(master);
+    rxbuf_die(&in);
+    munmap(map, (size_t)st.st_size);
+    return status;
+}
+
+// vim:ft=c
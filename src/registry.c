@@ -0,0 +1,743 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : registry.c
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/registry.h"
+
+/**
+ * number of config directories, in order of precedence
+ */
+#define REGISTRY_DIRS 3
+
+/**
+ * identifies an index of this layout
+ */
+#define REGISTRY_MAGIC "trxreg1"
+
+/**
+ * start of index, offsets are counted from the start of the file
+ */
+typedef struct header_t {
+    char magic[8];         /**< REGISTRY_MAGIC */
+    uint32_t size;         /**< length of index */
+    uint32_t nsources;     /**< directories followed by config files */
+    uint32_t nbuckets;     /**< length of hash table, a power of two */
+    uint32_t nentries;     /**< number of devices */
+    uint32_t sources;      /**< offset of source_t array */
+    uint32_t buckets;      /**< offset of hash table, entry index + 1 */
+    uint32_t entries;      /**< offset of entry_t array */
+    uint32_t pairs;        /**< offset of key, value string offsets */
+    uint32_t strings;      /**< offset of null-terminated strings */
+    uint32_t reserved;     /**< pad to 8 bytes */
+} header_t;
+
+/**
+ * directory or file the index was built from
+ */
+typedef struct source_t {
+    int64_t sec;           /**< mtime, -1 for a missing directory */
+    int64_t nsec;          /**< mtime nanoseconds */
+    uint32_t path;         /**< string offset */
+    uint32_t reserved;     /**< pad to 8 bytes */
+} source_t;
+
+/**
+ * device
+ */
+typedef struct entry_t {
+    uint32_t hash;         /**< hash of name */
+    uint32_t name;         /**< string offset */
+    uint32_t pairs;        /**< index of first key in pairs */
+    uint32_t npairs;       /**< number of settings */
+} entry_t;
+
+/**
+ * growable array of bytes
+ */
+typedef struct blob_t {
+    char* data;            /**< allocated buffer */
+    size_t len;            /**< bytes in use */
+    size_t size;           /**< allocated length */
+} blob_t;
+
+/**
+ * index under construction
+ */
+typedef struct build_t {
+    blob_t sources;        /**< source_t array */
+    blob_t entries;        /**< entry_t array */
+    blob_t pairs;          /**< uint32_t key, value string offsets */
+    blob_t strings;        /**< null-terminated strings */
+} build_t;
+
+/**
+ * append bytes to blob
+ *
+ * @param[in,out] blob blob to grow
+ * @param[in] data bytes to append
+ * @param[in] len number of bytes
+ * @return offset of the appended bytes or -1 for failure
+ */
+static long append(blob_t* blob, const void* data, size_t len);
+
+/**
+ * append null-terminated string to the strings of a build
+ *
+ * @param[in,out] build index under construction
+ * @param[in] str string
+ * @return string offset or -1 for failure
+ */
+static long intern(build_t* build, const char* str);
+
+/**
+ * 32-bit FNV-1a
+ *
+ * @param[in] str string to hash
+ * @return hash
+ */
+static uint32_t hash(const char* str);
+
+/**
+ * paths of the config directories, in order of precedence
+ *
+ * @param[out] dirs paths, empty when it can not be determined
+ */
+static void config_dirs(char dirs[REGISTRY_DIRS][PATH_MAX]);
+
+/**
+ * path of the index in the cache directory, which is created
+ *
+ * @param[out] path path of index
+ * @return status 0 for succes, -1 for failure
+ */
+static int cache_path(char path[PATH_MAX]);
+
+/**
+ * split config line in place
+ *
+ * @param[in,out] line line, terminated in place
+ * @param[out] key setting name or section name
+ * @param[out] value setting value
+ * @return 0 for a setting, 1 for a section, -1 for nothing
+ */
+static int split(char* line, char** key, char** value);
+
+/**
+ * mtime of path as recorded in a source
+ *
+ * @param[in] path file or directory
+ * @param[out] source sec and nsec are set, sec is -1 when missing
+ * @return status 0 for succes, -1 when path does not exist
+ */
+static int mtime(const char* path, source_t* source);
+
+/**
+ * add device unless it is already defined
+ *
+ * @param[in,out] build index under construction
+ * @param[in] name device name
+ * @param[in] own settings of the device as key, value string offsets
+ * @param[in] nown number of own settings
+ * @param[in] inherited settings used unless the device has its own
+ * @param[in] ninherited number of inherited settings
+ * @return status 0 for succes, -1 for failure
+ */
+static int add_entry(build_t* build, const char* name, const uint32_t* own,
+        size_t nown, const uint32_t* inherited, size_t ninherited);
+
+/**
+ * add all devices of a config file
+ *
+ * @param[in,out] build index under construction
+ * @param[in] path config file
+ * @param[in] name device name of the settings above the first section
+ * @return status 0 for succes, -1 for failure
+ */
+static int add_file(build_t* build, const char* path, const char* name);
+
+/**
+ * qsort comparator for an array of strings
+ *
+ * @param[in] a pointer to first string
+ * @param[in] b pointer to second string
+ * @return strcmp of both strings
+ */
+static int compare(const void* a, const void* b);
+
+/**
+ * add all config files of a directory, in alphabetical order
+ *
+ * @param[in,out] build index under construction
+ * @param[in] dir config directory
+ * @return status 0 for succes, -1 for failure
+ */
+static int add_dir(build_t* build, const char* dir);
+
+/**
+ * build index from the config directories
+ *
+ * @param[out] registry registry holding the allocated index
+ * @return status 0 for succes, -1 for failure
+ */
+static int build(registry_t* registry);
+
+/**
+ * check whether a mapped index matches the current config directories
+ *
+ * @param[in] registry registry with mapped index
+ * @return 1 when up to date, 0 otherwise
+ */
+static int valid(const registry_t* registry);
+
+long append(blob_t* blob, const void* data, size_t len)
+{
+    if (blob->len + len > blob->size) {
+        size_t size = blob->size ? blob->size : 1024;
+        while (blob->len + len > size) size *= 2;
+        char* p = realloc(blob->data, size);
+        if (!p) return -1;
+        blob->data = p;
+        blob->size = size;
+    }
+    memcpy(blob->data + blob->len, data, len);
+    blob->len += len;
+    return (long)(blob->len - len);
+}
+
+long intern(build_t* build, const char* str)
+{
+    return append(&build->strings, str, strlen(str)+1);
+}
+
+uint32_t hash(const char* str)
+{
+    uint32_t h = 2166136261u;
+    for (; *str; str++) {
+        h ^= (unsigned char)*str;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void config_dirs(char dirs[REGISTRY_DIRS][PATH_MAX])
+{
+    const char* config = getenv("XDG_CONFIG_HOME");
+    const char* home = getenv("HOME");
+
+    memset(dirs, 0, REGISTRY_DIRS * PATH_MAX);
+
+    if (config && *config) {
+        snprintf(dirs[0], PATH_MAX, "%s/trx", config);
+    } else if (home) {
+        snprintf(dirs[0], PATH_MAX, "%s/.config/trx", home);
+    }
+    if (home) snprintf(dirs[1], PATH_MAX, "%s/.trx", home);
+    strcpy(dirs[2], "/etc/trx");
+}
+
+int cache_path(char path[PATH_MAX])
+{
+    const char* cache = getenv("XDG_CACHE_HOME");
+    int len;
+
+    if (cache && *cache) {
+        len = snprintf(path, PATH_MAX, "%s/trx", cache);
+    } else if (getenv("HOME")) {
+        len = snprintf(path, PATH_MAX, "%s/.cache/trx", getenv("HOME"));
+    } else {
+        return -1;
+    }
+    if (len < 0 || len >= PATH_MAX - 16) return -1;
+
+    /* create cache directory */
+    char* p = strchr(path+1, '/');
+    for (; p; p = strchr(p+1, '/')) {
+        *p = '\0';
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) return -1;
+
+    strcat(path, "/registry");
+    return 0;
+}
+
+int split(char* line, char** key, char** value)
+{
+    char* end = line + strlen(line);
+
+    while (end > line && strchr(" \t\r\n", end[-1])) end--;
+    *end = '\0';
+    line += strspn(line, " \t");
+
+    if (!*line || *line == '#') return -1;
+
+    /* [name] */
+    if (*line == '[') {
+        if (end[-1] != ']' || end - line < 3) return -1;
+        end[-1] = '\0';
+        *key = line + 1;
+        return 1;
+    }
+
+    /* key = value, the '=' is optional */
+    *key = line;
+    line += strcspn(line, " \t=");
+    if (*line) *line++ = '\0';
+    *value = line + strspn(line, " \t=");
+    return 0;
+}
+
+int mtime(const char* path, source_t* source)
+{
+    struct stat st;
+
+    if (!*path || stat(path, &st) == -1) {
+        source->sec = -1;
+        source->nsec = 0;
+        return -1;
+    }
+    source->sec = (int64_t)st.st_mtim.tv_sec;
+    source->nsec = (int64_t)st.st_mtim.tv_nsec;
+    return 0;
+}
+
+int add_entry(build_t* build, const char* name, const uint32_t* own,
+        size_t nown, const uint32_t* inherited, size_t ninherited)
+{
+    entry_t* entries = (entry_t*)build->entries.data;
+    size_t n = build->entries.len / sizeof(entry_t);
+    entry_t entry = { .hash = hash(name) };
+
+    /* the first definition wins */
+    for (size_t i = 0; i < n; i++) {
+        if (entries[i].hash == entry.hash
+                && strcmp(build->strings.data + entries[i].name, name) == 0) {
+            return 0;
+        }
+    }
+
+    long off = intern(build, name);
+    if (off == -1) return -1;
+    entry.name = (uint32_t)off;
+    entry.pairs = (uint32_t)(build->pairs.len / (2 * sizeof(uint32_t)));
+
+    if (nown && append(&build->pairs, own, 2 * nown * sizeof(uint32_t)) == -1) {
+        return -1;
+    }
+    entry.npairs = (uint32_t)nown;
+
+    for (size_t i = 0; i < ninherited; i++) {
+        const char* key = build->strings.data + inherited[2*i];
+        int overridden = 0;
+        for (size_t j = 0; j < nown && !overridden; j++) {
+            overridden = strcmp(build->strings.data + own[2*j], key) == 0;
+        }
+        if (overridden) continue;
+        if (append(&build->pairs, &inherited[2*i], 2 * sizeof(uint32_t)) == -1) {
+            return -1;
+        }
+        entry.npairs++;
+    }
+
+    return append(&build->entries, &entry, sizeof(entry_t)) == -1 ? -1 : 0;
+}
+
+int add_file(build_t* build, const char* path, const char* name)
+{
+    blob_t defaults = { 0 };
+    blob_t section = { 0 };
+    char* current = NULL;
+    char* line = NULL;
+    size_t size = 0;
+    int status = 0;
+    FILE* stream;
+
+    source_t source = { 0 };
+    long off;
+    if (mtime(path, &source) == -1 || (off = intern(build, path)) == -1) {
+        return -1;
+    }
+    source.path = (uint32_t)off;
+    if (append(&build->sources, &source, sizeof(source_t)) == -1) return -1;
+
+    if (!(stream = fopen(path, "r"))) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+        return -1;
+    }
+
+    while (status != -1 && getline(&line, &size, stream) != -1) {
+        char* key;
+        char* value;
+        uint32_t pair[2];
+
+        switch (split(line, &key, &value)) {
+
+            /* the previous section is complete */
+            case 1:
+                if (current) {
+                    status = add_entry(build, current,
+                            (uint32_t*)section.data, section.len / sizeof(pair),
+                            (uint32_t*)defaults.data, defaults.len / sizeof(pair));
+                    free(current);
+                }
+                current = malloc(strlen(key)+1);
+                if (!current) status = -1;
+                else strcpy(current, key);
+                section.len = 0;
+                break;
+
+            case 0:
+                if ((off = intern(build, key)) == -1) {
+                    status = -1;
+                    break;
+                }
+                pair[0] = (uint32_t)off;
+                if ((off = intern(build, value)) == -1) {
+                    status = -1;
+                    break;
+                }
+                pair[1] = (uint32_t)off;
+                if (append(current ? &section : &defaults, pair, sizeof(pair))
+                        == -1) {
+                    status = -1;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (status != -1 && current) {
+        status = add_entry(build, current,
+                (uint32_t*)section.data, section.len / (2 * sizeof(uint32_t)),
+                (uint32_t*)defaults.data, defaults.len / (2 * sizeof(uint32_t)));
+    }
+
+    /* a file of sections only is no device itself */
+    if (status != -1 && defaults.len) {
+        status = add_entry(build, name, (uint32_t*)defaults.data,
+                defaults.len / (2 * sizeof(uint32_t)), NULL, 0);
+    }
+
+    free(current);
+    free(line);
+    free(defaults.data);
+    free(section.data);
+    fclose(stream);
+    return status;
+}
+
+int compare(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+int add_dir(build_t* build, const char* dir)
+{
+    char** names = NULL;
+    size_t n = 0;
+    int status = 0;
+    struct dirent* ent;
+    DIR* d;
+
+    if (!*dir || !(d = opendir(dir))) return 0;
+
+    while ((ent = readdir(d))) {
+        size_t len = strlen(ent->d_name);
+        if (ent->d_name[0] == '.' || len <= 5
+                || strcmp(ent->d_name + len - 5, ".conf") != 0) {
+            continue;
+        }
+        char** p = realloc(names, (n+1) * sizeof(char*));
+        if (!p || !(p[n] = malloc(len+1))) {
+            names = p ? p : names;
+            status = -1;
+            break;
+        }
+        names = p;
+        strcpy(names[n++], ent->d_name);
+    }
+    closedir(d);
+
+    if (n) qsort(names, n, sizeof(char*), compare);
+
+    for (size_t i = 0; i < n; i++) {
+        char path[PATH_MAX];
+        struct stat st;
+
+        if (status != -1) {
+            snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+
+            /* the device name is the file name without .conf */
+            names[i][strlen(names[i]) - 5] = '\0';
+            if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+                status = add_file(build, path, names[i]);
+            }
+        }
+        free(names[i]);
+    }
+    free(names);
+    return status;
+}
+
+int build(registry_t* registry)
+{
+    char dirs[REGISTRY_DIRS][PATH_MAX];
+    build_t b;
+    int status = 0;
+
+    memset(&b, 0, sizeof(build_t));
+
+    /* offset 0 is never a valid name */
+    intern(&b, "");
+
+    config_dirs(dirs);
+
+    /* directories first, a file added or removed changes their mtime */
+    for (size_t i = 0; i < REGISTRY_DIRS && status != -1; i++) {
+        source_t source = { 0 };
+        long off = intern(&b, dirs[i]);
+        mtime(dirs[i], &source);
+        source.path = (uint32_t)off;
+        if (off == -1 || append(&b.sources, &source, sizeof(source_t)) == -1) {
+            status = -1;
+        }
+    }
+    for (size_t i = 0; i < REGISTRY_DIRS && status != -1; i++) {
+        status = add_dir(&b, dirs[i]);
+    }
+
+    size_t nentries = b.entries.len / sizeof(entry_t);
+    size_t nbuckets = 8;
+    while (nbuckets < 2 * nentries) nbuckets *= 2;
+
+    /* lay out header, sources, buckets, entries, pairs and strings */
+    header_t header = { .magic = REGISTRY_MAGIC };
+    size_t off = sizeof(header_t);
+    header.sources = (uint32_t)off;
+    off += b.sources.len;
+    header.buckets = (uint32_t)off;
+    off += nbuckets * sizeof(uint32_t);
+    off = (off + 7) & ~(size_t)7;
+    header.entries = (uint32_t)off;
+    off += b.entries.len;
+    header.pairs = (uint32_t)off;
+    off += b.pairs.len;
+    header.strings = (uint32_t)off;
+    off += b.strings.len;
+
+    if (status == -1 || off > UINT32_MAX
+            || !(registry->map = calloc(1, off))) {
+        free(b.sources.data);
+        free(b.entries.data);
+        free(b.pairs.data);
+        free(b.strings.data);
+        return -1;
+    }
+    header.size = (uint32_t)off;
+    header.nsources = (uint32_t)(b.sources.len / sizeof(source_t));
+    header.nbuckets = (uint32_t)nbuckets;
+    header.nentries = (uint32_t)nentries;
+
+    char* map = registry->map;
+    memcpy(map, &header, sizeof(header_t));
+    if (b.sources.len) memcpy(map + header.sources, b.sources.data, b.sources.len);
+    if (b.entries.len) memcpy(map + header.entries, b.entries.data, b.entries.len);
+    if (b.pairs.len) memcpy(map + header.pairs, b.pairs.data, b.pairs.len);
+    memcpy(map + header.strings, b.strings.data, b.strings.len);
+
+    /* open addressing, linear probing */
+    uint32_t* buckets = (uint32_t*)(map + header.buckets);
+    entry_t* entries = (entry_t*)(map + header.entries);
+    for (size_t i = 0; i < nentries; i++) {
+        size_t j = entries[i].hash & (nbuckets - 1);
+        while (buckets[j]) j = (j + 1) & (nbuckets - 1);
+        buckets[j] = (uint32_t)(i + 1);
+    }
+
+    registry->size = off;
+    registry->mapped = 0;
+
+    free(b.sources.data);
+    free(b.entries.data);
+    free(b.pairs.data);
+    free(b.strings.data);
+    return 0;
+}
+
+int valid(const registry_t* registry)
+{
+    char dirs[REGISTRY_DIRS][PATH_MAX];
+    const header_t* header = (const header_t*)registry->map;
+
+    if (registry->size < sizeof(header_t)
+            || memcmp(header->magic, REGISTRY_MAGIC, sizeof(header->magic)) != 0
+            || header->size != registry->size
+            || header->nsources < REGISTRY_DIRS
+            || header->strings >= header->size
+            || header->sources + header->nsources * sizeof(source_t)
+                > header->size) {
+        return 0;
+    }
+
+    const source_t* sources = (const source_t*)(registry->map + header->sources);
+    const char* strings = registry->map + header->strings;
+
+    /* the environment may point to other directories */
+    config_dirs(dirs);
+    for (size_t i = 0; i < REGISTRY_DIRS; i++) {
+        if (strcmp(strings + sources[i].path, dirs[i]) != 0) return 0;
+    }
+
+    for (size_t i = 0; i < header->nsources; i++) {
+        source_t source;
+        mtime(strings + sources[i].path, &source);
+        if (source.sec != sources[i].sec || source.nsec != sources[i].nsec) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int registry_open(registry_t* registry)
+{
+    char path[PATH_MAX];
+    char tmp[PATH_MAX + 16];
+    struct stat st;
+    int fd;
+
+    memset(registry, 0, sizeof(registry_t));
+
+    if (cache_path(path) == -1) return build(registry);
+
+    if ((fd = open(path, O_RDONLY)) != -1) {
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(header_t)) {
+            void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                    fd, 0);
+            if (map != MAP_FAILED) {
+                registry->map = map;
+                registry->size = (size_t)st.st_size;
+                registry->mapped = 1;
+            }
+        }
+        close(fd);
+        if (registry->map && valid(registry)) return 0;
+        registry_close(registry);
+    }
+
+    if (build(registry) == -1) {
+        fprintf(stderr, "error building device registry\n");
+        return -1;
+    }
+
+    /* saving is an optimization, the index in memory is complete */
+    snprintf(tmp, sizeof(tmp), "%s.%i", path, (int)getpid());
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) return 0;
+    ssize_t n = write(fd, registry->map, registry->size);
+    if (close(fd) == -1 || n != (ssize_t)registry->size
+            || rename(tmp, path) == -1) {
+        unlink(tmp);
+    }
+    return 0;
+}
+
+int registry_find(const registry_t* registry, const char* name,
+        registry_apply_t apply, portsettings_t* portsettings)
+{
+    const header_t* header = (const header_t*)registry->map;
+    const uint32_t* buckets = (const uint32_t*)(registry->map + header->buckets);
+    const entry_t* entries = (const entry_t*)(registry->map + header->entries);
+    const uint32_t* pairs = (const uint32_t*)(registry->map + header->pairs);
+    const char* strings = registry->map + header->strings;
+    uint32_t h = hash(name);
+
+    for (uint32_t i = h & (header->nbuckets - 1); buckets[i];
+            i = (i + 1) & (header->nbuckets - 1)) {
+        const entry_t* entry = &entries[buckets[i] - 1];
+        if (entry->hash != h || strcmp(strings + entry->name, name) != 0) {
+            continue;
+        }
+        for (uint32_t j = 0; j < entry->npairs; j++) {
+            const uint32_t* pair = &pairs[2 * (entry->pairs + j)];
+            if (apply(portsettings, strings + pair[0], strings + pair[1])
+                    == -1) {
+                return -1;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+int registry_match(const registry_t* registry, const char* pattern,
+        registry_each_t each, void* arg)
+{
+    const header_t* header = (const header_t*)registry->map;
+    const entry_t* entries = (const entry_t*)(registry->map + header->entries);
+    const char* strings = registry->map + header->strings;
+    int n = 0;
+
+    for (uint32_t i = 0; i < header->nentries; i++) {
+        const char* name = strings + entries[i].name;
+        if (fnmatch(pattern, name, 0) != 0) continue;
+        if (each(name, arg) == -1) return -1;
+        n++;
+    }
+    return n;
+}
+
+int registry_read(const char* path, registry_apply_t apply,
+        portsettings_t* portsettings)
+{
+    char* line = NULL;
+    size_t size = 0;
+    int status = 0;
+    FILE* stream;
+
+    if (!(stream = fopen(path, "r"))) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+        return -1;
+    }
+
+    while (getline(&line, &size, stream) != -1) {
+        char* key;
+        char* value;
+        int kind = split(line, &key, &value);
+
+        if (kind == 1) break;
+        if (kind == 0 && apply(portsettings, key, value) == -1) {
+            status = -1;
+            break;
+        }
+    }
+
+    free(line);
+    fclose(stream);
+    return status;
+}
+
+void registry_close(registry_t* registry)
+{
+    if (registry->map && registry->mapped) munmap(registry->map, registry->size);
+    else free(registry->map);
+    memset(registry, 0, sizeof(registry_t));
+}
+
+// vim:ft=c
@@ -0,0 +1,170 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : rxbuf.c
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/rxbuf.h"
+
+/**
+ * initial size, grown by doubling for lines that do not fit
+ */
+#define RXBUF_SIZE 4096
+
+int rxbuf_parse_delimiter(delimiter_t* delimiter, const char* str)
+{
+    if (!str || !*str) return -1;
+
+    memset(delimiter, 0, sizeof(delimiter_t));
+
+    if (strcmp(str, "lf") == 0) {
+        delimiter->bytes[0] = '\n';
+        delimiter->len = 1;
+        delimiter->trim = 1;
+    } else if (strcmp(str, "cr") == 0) {
+        delimiter->bytes[0] = '\r';
+        delimiter->len = 1;
+        delimiter->trim = 1;
+    } else if (strcmp(str, "crlf") == 0) {
+        delimiter->bytes[0] = '\r';
+        delimiter->bytes[1] = '\n';
+        delimiter->len = 2;
+    } else if (strncmp(str, "0x", 2) == 0 && str[2]) {
+        char* end;
+        long l = strtol(str+2, &end, 16);
+        if (*end || l < 0 || l > 0xff) return -1;
+        delimiter->bytes[0] = (char)l;
+        delimiter->len = 1;
+    } else if (!str[1]) {
+        delimiter->bytes[0] = *str;
+        delimiter->len = 1;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+ssize_t rxbuf_fill(rxbuf_t* rxbuf, int fd)
+{
+    /* reclaim consumed space, only the incomplete line is moved */
+    if (rxbuf->head) {
+        memmove(rxbuf->data, rxbuf->data + rxbuf->head,
+                rxbuf->tail - rxbuf->head);
+        rxbuf->tail -= rxbuf->head;
+        rxbuf->head = 0;
+    }
+
+    /* incomplete line fills entire buffer */
+    if (rxbuf->tail == rxbuf->size) {
+        size_t size = rxbuf->size ? 2 * rxbuf->size : RXBUF_SIZE;
+        char* data = realloc(rxbuf->data, size);
+        if (!data) return -1;
+        rxbuf->data = data;
+        rxbuf->size = size;
+    }
+
+    ssize_t n = read(fd, rxbuf->data + rxbuf->tail, rxbuf->size - rxbuf->tail);
+    if (n > 0) rxbuf->tail += (size_t)n;
+    return n;
+}
+
+int rxbuf_append(rxbuf_t* rxbuf, const char* data, size_t len)
+{
+    if (rxbuf->head) {
+        memmove(rxbuf->data, rxbuf->data + rxbuf->head,
+                rxbuf->tail - rxbuf->head);
+        rxbuf->tail -= rxbuf->head;
+        rxbuf->head = 0;
+    }
+
+    if (rxbuf->tail + len > rxbuf->size) {
+        size_t size = rxbuf->size ? rxbuf->size : RXBUF_SIZE;
+        while (size < rxbuf->tail + len) size *= 2;
+        char* grown = realloc(rxbuf->data, size);
+        if (!grown) return -1;
+        rxbuf->data = grown;
+        rxbuf->size = size;
+    }
+
+    memcpy(rxbuf->data + rxbuf->tail, data, len);
+    rxbuf->tail += len;
+    return 0;
+}
+
+int rxbuf_line(rxbuf_t* rxbuf, const delimiter_t* delimiter,
+        char** line, size_t* len)
+{
+    char last = delimiter->bytes[delimiter->len-1];
+    char* start;
+    size_t avail;
+    size_t from;
+    char* p;
+
+    /* CR delimited: the LF of a CRLF is not part of the next line */
+    if (delimiter->trim && last == '\r' && rxbuf->head < rxbuf->tail
+            && rxbuf->data[rxbuf->head] == '\n') {
+        rxbuf->head++;
+        if (rxbuf->scan) rxbuf->scan--;
+    }
+
+    start = rxbuf->data + rxbuf->head;
+    avail = rxbuf->tail - rxbuf->head;
+    from = rxbuf->scan;
+
+    /* memchr is vectorized by libc, search for the final delimiter byte */
+    for (;;) {
+        p = from < avail ? memchr(start + from, last, avail - from) : NULL;
+        if (!p) {
+            rxbuf->scan = avail;
+            return 0;
+        }
+        if (delimiter->len == 1 || (p > start && p[-1] == delimiter->bytes[0])) {
+            break;
+        }
+        from = (size_t)(p - start) + 1;
+    }
+
+    size_t end = (size_t)(p - start) + 1 - delimiter->len;
+    size_t next = (size_t)(p - start) + 1;
+
+    /* LF delimited: drop the CR of a CRLF */
+    if (delimiter->trim && last == '\n' && end && start[end-1] == '\r') end--;
+
+    start[end] = '\0';
+    *line = start;
+    *len = end;
+
+    rxbuf->head += next;
+    rxbuf->scan = 0;
+    return 1;
+}
+
+size_t rxbuf_take(rxbuf_t* rxbuf, char* buf, size_t len)
+{
+    size_t n = rxbuf->tail - rxbuf->head;
+    if (n > len) n = len;
+
+    if (!n) return 0;
+    memcpy(buf, rxbuf->data + rxbuf->head, n);
+    rxbuf->head += n;
+    rxbuf->scan = 0;
+    return n;
+}
+
+void rxbuf_reset(rxbuf_t* rxbuf)
+{
+    rxbuf->head = 0;
+    rxbuf->tail = 0;
+    rxbuf->scan = 0;
+}
+
+void rxbuf_die(rxbuf_t* rxbuf)
+{
+    free(rxbuf->data);
+    memset(rxbuf, 0, sizeof(rxbuf_t));
+}
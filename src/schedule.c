@@ -0,0 +1,223 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : schedule.c
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/input.h"
+#include "../include/schedule.h"
+
+/**
+ * nanoseconds per second
+ */
+#define NSEC 1000000000ULL
+
+/**
+ * length of array
+ */
+#define LENGTH(a) sizeof(a)/sizeof(a[0])
+
+/**
+ * period units
+ */
+static const struct {
+    const char* name;
+    uint64_t nsec;
+} units[] = {
+    {"", NSEC}, {"us", 1000}, {"ms", 1000000}, {"s", NSEC},
+    {"min", 60 * NSEC}, {"h", 3600 * NSEC},
+};
+
+/**
+ * current CLOCK_MONOTONIC time
+ *
+ * @return nsec
+ */
+static uint64_t now(void);
+
+/**
+ * add task
+ *
+ * @param[in,out] schedule schedule to grow
+ * @param[in] line "<period> <command>"
+ * @return status 0 for succes, -1 for failure
+ */
+static int add_task(schedule_t* schedule, const char* line);
+
+uint64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC + (uint64_t)ts.tv_nsec;
+}
+
+int schedule_parse_period(uint64_t* nsec, const char* str)
+{
+    char* end;
+    if (!str || !*str || *str == '-') return -1;
+
+    double d = strtod(str, &end);
+    if (end == str || d <= 0) return -1;
+
+    for (size_t i = 0; i < LENGTH(units); i++) {
+        if (strcmp(end, units[i].name) == 0) {
+            *nsec = (uint64_t)(d * (double)units[i].nsec);
+            return *nsec ? 0 : -1;
+        }
+    }
+    return -1;
+}
+
+int add_task(schedule_t* schedule, const char* line)
+{
+    char period[32];
+    size_t len = strcspn(line, " \t");
+    const char* cmd = line + len;
+    task_t* tasks;
+    task_t* task;
+
+    while (isspace((unsigned char)*cmd)) cmd++;
+    if (len >= sizeof(period) || !*cmd) {
+        fprintf(stderr, "invalid schedule line: %s\n", line);
+        return -1;
+    }
+    memcpy(period, line, len);
+    period[len] = '\0';
+
+    tasks = realloc(schedule->tasks, (schedule->n+1) * sizeof(task_t));
+    if (!tasks) return -1;
+    schedule->tasks = tasks;
+    task = &schedule->tasks[schedule->n];
+    memset(task, 0, sizeof(task_t));
+
+    if (schedule_parse_period(&task->period, period) == -1) {
+        fprintf(stderr, "invalid period: %s\n", period);
+        return -1;
+    }
+    if (!(task->cmd = malloc(strlen(cmd)+1))) return -1;
+    strcpy(task->cmd, cmd);
+    schedule->n++;
+    return 0;
+}
+
+int schedule_load(schedule_t* schedule, const char* path)
+{
+    input_t input;
+    const char* line;
+    int status = 0;
+
+    memset(schedule, 0, sizeof(schedule_t));
+    if (input_open(&input, path) == -1) {
+        fprintf(stderr, "error opening schedule %s: %s\n", path,
+                strerror(errno));
+        return -1;
+    }
+    while (status == 0 && (line = input_next(&input))) {
+        status = add_task(schedule, line);
+    }
+    input_close(&input);
+
+    if (status == 0 && !schedule->n) {
+        fprintf(stderr, "schedule %s has no commands\n", path);
+        status = -1;
+    }
+    return status;
+}
+
+task_t* schedule_next(schedule_t* schedule)
+{
+    task_t* next = NULL;
+    uint64_t t = now();
+
+    /* every task is released at the start */
+    if (!schedule->start) {
+        schedule->start = t;
+        for (size_t i = 0; i < schedule->n; i++) schedule->tasks[i].due = t;
+    }
+
+    /* earliest release first so a slow device starves no task, releases
+     * that collide go to the shortest period */
+    for (size_t i = 0; i < schedule->n; i++) {
+        task_t* task = &schedule->tasks[i];
+        if (!next || task->due < next->due
+                || (task->due == next->due && task->period < next->period)) {
+            next = task;
+        }
+    }
+
+    if (next->due > t) {
+        struct timespec ts = {
+            .tv_sec = (time_t)(next->due / NSEC),
+            .tv_nsec = (long)(next->due % NSEC),
+        };
+        /* a signal hands control back to the caller */
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) {
+            return NULL;
+        }
+    }
+    return next;
+}
+
+void schedule_start(task_t* task)
+{
+    uint64_t t = now();
+    uint64_t late = t > task->due ? t - task->due : 0;
+
+    task->runs++;
+    task->jitter += late;
+    if (late > task->maxjitter) task->maxjitter = late;
+
+    /* stay on the grid, whole periods that passed are skipped */
+    task->due += task->period;
+    if (task->due <= t) {
+        uint64_t skip = (t - task->due) / task->period + 1;
+        task->missed += skip;
+        task->due += skip * task->period;
+    }
+}
+
+int schedule_changed(task_t* task, const char* response, size_t len)
+{
+    if (task->seen && len == task->lastlen
+            && memcmp(task->last, response, len) == 0) {
+        return 0;
+    }
+
+    char* last = realloc(task->last, len ? len : 1);
+    if (!last) return 1;
+    memcpy(last, response, len);
+    task->last = last;
+    task->lastlen = len;
+    task->seen = 1;
+    return 1;
+}
+
+void schedule_print(const schedule_t* schedule, FILE* stream)
+{
+    for (size_t i = 0; i < schedule->n; i++) {
+        const task_t* task = &schedule->tasks[i];
+        fprintf(stream, "%s: period %.3f ms, %zu runs, %zu missed, "
+                "jitter mean %.3f ms max %.3f ms\n", task->cmd,
+                (double)task->period / 1e6, task->runs, task->missed,
+                task->runs ? (double)task->jitter / (double)task->runs / 1e6
+                : 0.0, (double)task->maxjitter / 1e6);
+    }
+}
+
+void schedule_die(schedule_t* schedule)
+{
+    for (size_t i = 0; i < schedule->n; i++) {
+        free(schedule->tasks[i].cmd);
+        free(schedule->tasks[i].last);
+    }
+    free(schedule->tasks);
+    memset(schedule, 0, sizeof(schedule_t));
+}
+
+// vim:ft=c
@@ -9,21 +9,345 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <poll.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
+#include <linux/serial.h>
 
+#include "../include/baud.h"
 #include "../include/serial.h"
 
-#define UNUSED(x) (void)(x)
+/**
+ * length of array
+ */
+#define LENGTH(a) sizeof(a)/sizeof(a[0])
+
+/**
+ * ASYNC_LOW_LATENCY is unsigned, serial_struct.flags is not
+ */
+#define LOW_LATENCY ((int)ASYNC_LOW_LATENCY)
+
+/**
+ * sec to wait for a probe response when no timeout is configured
+ */
+#define AUTOBAUD_TIMEOUT 0.2
+
+/**
+ * termios speed constant of a standard baudrate
+ */
+static const struct {
+    unsigned int baudrate;
+    speed_t speed;
+} rates[] = {
+    {50, B50}, {75, B75}, {110, B110}, {134, B134}, {150, B150},
+    {200, B200}, {300, B300}, {600, B600}, {1200, B1200}, {1800, B1800},
+    {2400, B2400}, {4800, B4800}, {9600, B9600}, {19200, B19200},
+    {38400, B38400}, {57600, B57600}, {115200, B115200},
+    {230400, B230400}, {460800, B460800}, {500000, B500000},
+    {576000, B576000}, {921600, B921600}, {1000000, B1000000},
+    {1152000, B1152000}, {1500000, B1500000}, {2000000, B2000000},
+    {2500000, B2500000}, {3000000, B3000000}, {3500000, B3500000},
+    {4000000, B4000000},
+};
+
+/**
+ * baudrates tried by auto-baud, fastest first
+ */
+static const unsigned int candidates[] = {
+    4000000, 3000000, 2000000, 1500000, 1000000, 921600, 460800, 230400,
+    115200, 57600, 38400, 19200, 9600, 4800, 2400, 1200,
+};
+
+/**
+ * look up termios speed constant
+ *
+ * @param[in] baudrate bits per second
+ * @return B* constant or B0 if the rate is non-standard
+ */
+static speed_t speed(unsigned int baudrate);
+
+/**
+ * apply baudrate to port, through termios2 for non-standard rates
+ *
+ * @param[in] fd open serial port
+ * @param[in,out] tty port settings, written to the port
+ * @param[in] baudrate bits per second
+ * @return status 0 for succes, -1 for failure
+ */
+static int apply(int fd, struct termios* tty, unsigned int baudrate);
+
+/**
+ * grow transmit buffer
+ *
+ * @param[in,out] portsettings settings with transmit buffer
+ * @param[in] size number of bytes to be appended
+ * @return status 0 for succes, -1 for failure
+ */
+static int reserve(portsettings_t* portsettings, size_t size);
+
+/**
+ * append framed command to the transmit buffer
+ *
+ * @param[in,out] portsettings settings with framing and transmit buffer
+ * @param[in] cmd command, hexadecimal text when hex is set
+ * @return status 0 for succes, -1 for failure
+ */
+static int encode(portsettings_t* portsettings, const char* cmd);
+
+/**
+ * write every byte of an io vector
+ *
+ * partial writes are resumed and a full output buffer (EAGAIN) is waited
+ * for with poll()
+ *
+ * @param[in] fd file descriptor
+ * @param[in,out] iov io vector, modified
+ * @param[in] iovcnt length of iov
+ * @return status 0 for succes, -1 for failure
+ */
+static int write_all(int fd, struct iovec* iov, int iovcnt);
+
+/**
+ * check probe response
+ *
+ * @param[in] portsettings expected response prefix, if any
+ * @param[in] line received line
+ * @param[in] len length of line
+ * @return 1 when valid
+ */
+static int valid_probe(const portsettings_t* portsettings, const char* line,
+        size_t len);
+
+/**
+ * sample kernel error counters of the port
+ *
+ * @param[in] fd open serial port
+ * @param[out] count counters, valid is 0 when the driver has none (eg pty)
+ * @return status 0 for succes, -1 for failure
+ */
+static int icount(int fd, icount_t* count);
+
+/**
+ * request ASYNC_LOW_LATENCY from the driver and report what took effect
+ *
+ * @param[in,out] portsettings open port, asynclow is set when the flag was
+ *                changed and has to be cleared on closing
+ */
+static void low_latency(portsettings_t* portsettings);
+
+/**
+ * account for bytes just appended to the receive buffer
+ *
+ * @param[in,out] portsettings settings with receive buffer and counters
+ * @param[in] n number of bytes read
+ */
+static void received(portsettings_t* portsettings, size_t n);
+
+/**
+ * busy-poll for input with non-blocking reads, VMIN and VTIME are 0
+ *
+ * @param[in,out] portsettings open port
+ * @param[in] period sec to keep polling
+ * @return 1 if bytes were received, 0 if none, -1 for failure
+ */
+static int spin(portsettings_t* portsettings, double period);
+
+/**
+ * current CLOCK_MONOTONIC time
+ *
+ * @return seconds
+ */
+static double now(void);
+
+int reserve(portsettings_t* portsettings, size_t size)
+{
+    size_t txsize = portsettings->txsize ? portsettings->txsize : 256;
+
+    if (portsettings->txlen + size <= portsettings->txsize) return 0;
+
+    while (txsize < portsettings->txlen + size) txsize *= 2;
+    char* tx = realloc(portsettings->tx, txsize);
+    if (!tx) {
+        fprintf(stderr, "error allocating transmit buffer\n");
+        return -1;
+    }
+    portsettings->tx = tx;
+    portsettings->txsize = txsize;
+    return 0;
+}
+
+int encode(portsettings_t* portsettings, const char* cmd)
+{
+    size_t len = strlen(cmd);
+    const char* payload = cmd;
+    ssize_t n;
+
+    /* room for decoded hex payload followed by the frame */
+    if (reserve(portsettings, len + framing_bound(portsettings->framing, len)
+                + sizeof(portsettings->terminator.bytes)) == -1) {
+        return -1;
+    }
 
-int fd;
-struct termios oldtty;
+    char* end = portsettings->tx + portsettings->txlen;
 
-int serial_init(const portsettings_t* portsettings)
+    if (portsettings->hex) {
+        n = framing_hex_decode(cmd, end);
+        if (n == -1) {
+            fprintf(stderr, "invalid hex command: %s\n", cmd);
+            return -1;
+        }
+        payload = end;
+        len = (size_t)n;
+    }
+
+    /* a line is the payload followed by the configured terminator */
+    if (portsettings->framing == FRAMING_LINE) {
+        memmove(end, payload, len);
+        memcpy(end + len, portsettings->terminator.bytes,
+                portsettings->terminator.len);
+        portsettings->txlen += len + portsettings->terminator.len;
+        return 0;
+    }
+
+    n = framing_encode(portsettings->framing, payload, len, end + len);
+    if (n == -1) {
+        fprintf(stderr, "command too long for %s framing\n",
+                framing_name(portsettings->framing));
+        return -1;
+    }
+
+    memmove(end, end + len, (size_t)n);
+    portsettings->txlen += (size_t)n;
+    return 0;
+}
+
+int write_all(int fd, struct iovec* iov, int iovcnt)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+
+    while (iovcnt) {
+        ssize_t n = writev(fd, iov, iovcnt);
+
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                fprintf(stderr, "error writing port: %s\n", strerror(errno));
+                return -1;
+            }
+            /* output buffer full, wait until the driver made room */
+            if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+                fprintf(stderr, "error polling port: %s\n", strerror(errno));
+                return -1;
+            }
+            continue;
+        }
+
+        /* partial write, skip what was sent */
+        while (iovcnt && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+speed_t speed(unsigned int baudrate)
+{
+    for (size_t i = 0; i < LENGTH(rates); i++) {
+        if (rates[i].baudrate == baudrate) return rates[i].speed;
+    }
+    return B0;
+}
+
+int apply(int fd, struct termios* tty, unsigned int baudrate)
+{
+    speed_t s = speed(baudrate);
+
+    /* placeholder speed, replaced by termios2 below */
+    cfsetospeed(tty, s != B0 ? s : B38400);
+    cfsetispeed(tty, s != B0 ? s : B38400);
+
+    if (tcsetattr(fd, TCSANOW, tty) == -1) return -1;
+    if (s == B0 && baud_set_custom(fd, baudrate) == -1) return -1;
+    return 0;
+}
+
+int valid_probe(const portsettings_t* portsettings, const char* line,
+        size_t len)
+{
+    if (portsettings->expect) {
+        size_t n = strlen(portsettings->expect);
+        return len >= n && memcmp(line, portsettings->expect, n) == 0;
+    }
+
+    /* garbage at a wrong rate is rarely a clean line of printable text */
+    if (!len) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!isprint((unsigned char)line[i]) && line[i] != '\t') return 0;
+    }
+    return 1;
+}
+
+int icount(int fd, icount_t* count)
+{
+    struct serial_icounter_struct ic;
+
+    memset(count, 0, sizeof(icount_t));
+    if (ioctl(fd, TIOCGICOUNT, &ic) == -1) return -1;
+
+    count->valid = 1;
+    count->frame = ic.frame;
+    count->overrun = ic.overrun;
+    count->parity = ic.parity;
+    count->brk = ic.brk;
+    count->buf_overrun = ic.buf_overrun;
+    return 0;
+}
+
+void low_latency(portsettings_t* portsettings)
 {
+    struct serial_struct ss;
+    int fd = portsettings->fd;
+
+    if (ioctl(fd, TIOCGSERIAL, &ss) == -1) {
+        fprintf(stderr, "low-latency: ASYNC_LOW_LATENCY not supported by "
+                "%s: %s\n", portsettings->port, strerror(errno));
+        return;
+    }
+    if (ss.flags & LOW_LATENCY) {
+        fprintf(stderr, "low-latency: ASYNC_LOW_LATENCY already set\n");
+        return;
+    }
+
+    ss.flags |= LOW_LATENCY;
+    errno = 0;
+    if (ioctl(fd, TIOCSSERIAL, &ss) == -1
+            || ioctl(fd, TIOCGSERIAL, &ss) == -1
+            || !(ss.flags & LOW_LATENCY)) {
+        fprintf(stderr, "low-latency: ASYNC_LOW_LATENCY rejected by %s: %s\n",
+                portsettings->port, errno ? strerror(errno) : "ignored");
+        return;
+    }
+    portsettings->asynclow = 1;
+    fprintf(stderr, "low-latency: ASYNC_LOW_LATENCY set\n");
+}
+
+int serial_init(portsettings_t* portsettings)
+{
+    int fd;
+
     if (!portsettings->port) {
         fprintf(stderr, "please provide serial port\n");
         return -1;
@@ -49,14 +373,12 @@ int serial_init(const portsettings_t* portsettings)
 
     if (tcgetattr(fd, &tty) < 0) {
         fprintf(stderr, "error reading port settings: %s\n", strerror(errno));
+        close(fd);
         return -1;
     }
 
-    oldtty = tty;
-
-    /* set IO speed */
-    cfsetospeed(&tty, portsettings->baudrate);
-    cfsetispeed(&tty, portsettings->baudrate);
+    portsettings->fd = fd;
+    portsettings->oldtty = tty;
 
     /* ignore Wsign because termios.c_cflag is unsigned but the macros are */
 #pragma GCC diagnostic push
@@ -64,30 +386,48 @@ int serial_init(const portsettings_t* portsettings)
 
     /* set port paratmeters */
     tty.c_cflag |=                  CLOCAL | CREAD;
-    /* ?? */
+    /* character size */
     tty.c_cflag &=                  ~CSIZE;
-    /* 8-bit characters */
-    tty.c_cflag |=                  CS8;
-    /* no parity bit */
-    tty.c_cflag &=                  ~PARENB;
-    /* only need 1 stop bit */
-    tty.c_cflag &=                  ~CSTOPB;
-    /* no hardware flowcontrol  */
-    /* tty.c_cflag &=               ~CRTSCTS; */
-    /* canonical input */
-    tty.c_lflag |=                  ICANON | ISIG;
-    /* NON-canonical input!! <] */
-    /* tty.c_lflag &=               ~(ICANON | ISIG);*/
+    tty.c_cflag |=                  portsettings->databits == 5 ? CS5
+                                    : portsettings->databits == 6 ? CS6
+                                    : portsettings->databits == 7 ? CS7 : CS8;
+    /* parity, mark and space stick the parity bit to 1 or 0 */
+    tty.c_cflag &=                  ~(PARENB | PARODD | CMSPAR);
+    if (portsettings->parity != 'n')
+        tty.c_cflag |=              PARENB;
+    if (portsettings->parity == 'o' || portsettings->parity == 'm')
+        tty.c_cflag |=              PARODD;
+    if (portsettings->parity == 'm' || portsettings->parity == 's')
+        tty.c_cflag |=              CMSPAR;
+    /* stop bits */
+    if (portsettings->stopbits == 2)
+        tty.c_cflag |=              CSTOPB;
+    else
+        tty.c_cflag &=              ~CSTOPB;
+    /* hardware flow control */
+    if (portsettings->flow == FLOW_RTSCTS)
+        tty.c_cflag |=              CRTSCTS;
+    else
+        tty.c_cflag &=              ~CRTSCTS;
+    /* NON-canonical input, lines are split by the rx buffer */
+    tty.c_lflag &=                  ~(ICANON | ISIG);
     /* echo */
     tty.c_lflag &=                  ~(ECHO | ECHOE | ECHONL | IEXTEN);
     /* preserve carriage return */
     /* tty.c_iflag &=               ~IGNCR; */
-    /* ?? */
-    tty.c_iflag &=                  ~INPCK;
+    /* check parity of received characters only when there is one */
+    if (portsettings->parity != 'n')
+        tty.c_iflag |=              INPCK;
+    else
+        tty.c_iflag &=              ~INPCK;
     /* ?? */
     tty.c_iflag &=                  ~(INLCR | ICRNL | IUCLC | IMAXBEL);
-    /* SW fdlow-control */
+    /* software flow control, only XON resumes output */
     tty.c_iflag &=                  ~(IXON | IXOFF | IXANY);
+    if (portsettings->flow == FLOW_XONXOFF)
+        tty.c_iflag |=              IXON | IXOFF;
+    tty.c_cc[VSTART] =              0x11;
+    tty.c_cc[VSTOP] =               0x13;
     /* ?? */
     tty.c_oflag &=                  ~OPOST;
     /* alt eol characters */
@@ -99,90 +439,377 @@ int serial_init(const portsettings_t* portsettings)
     tty.c_cc[VMIN] =                0;
 #pragma GCC diagnostic pop
 
-    if (tcsetattr(fd, TCSANOW, &tty) == -1) {
+    if (apply(fd, &tty, portsettings->baudrate) == -1) {
         fprintf(stderr, "error setting serial port settings: %s\n",
                 strerror(errno));
         return -1;
     }
+
+    /* baseline for the error report when the port is closed */
+    icount(fd, &portsettings->icount);
+
+    if (portsettings->lowlatency) low_latency(portsettings);
+    if (portsettings->spin) {
+        fprintf(stderr, "low-latency: busy-poll %u us before sleeping\n",
+                portsettings->spin);
+    }
     return 0;
 }
 
-int serial_tx(const portsettings_t* portsettings, const char *cmd)
+int serial_set_baudrate(portsettings_t* portsettings, unsigned int baudrate)
 {
-    /* TODO "fd" should go in portsettings struct */
-    UNUSED(portsettings);
-    int len = (int)strlen(cmd);
-    int n = (int)write(fd, cmd, (size_t)len);
-    write(fd, "\r", 1);
+    struct termios tty;
 
-    if (n != len) {
-        fprintf(stderr, "sent only %i bytes out of %i\n", n, len);
+    if (tcgetattr(portsettings->fd, &tty) == -1
+            || apply(portsettings->fd, &tty, baudrate) == -1) {
+        return -1;
     }
 
-    /* wait until output buffer is empty */
-    tcdrain(fd);
-    return n;
+    /* whatever arrived at the old rate is meaningless now */
+    tcflush(portsettings->fd, TCIOFLUSH);
+    rxbuf_reset(&portsettings->rx);
+    portsettings->baudrate = baudrate;
+    return 0;
 }
 
-int serial_rx(const portsettings_t* portsettings, char *buf, size_t size)
+int serial_autobaud(portsettings_t* portsettings, double timeout)
 {
-    ssize_t n = 0;
-    fd_set set;
-    FD_ZERO(&set);
-    FD_SET(fd, &set);
+    char* line;
+    size_t len;
+
+    if (!portsettings->probe) {
+        fprintf(stderr, "auto-baud requires a probe command\n");
+        return -1;
+    }
+    if (timeout <= 0) timeout = AUTOBAUD_TIMEOUT;
+    timing_t timing = { .first = timeout, .gap = timeout, .total = 0 };
+
+    for (size_t i = 0; i < LENGTH(candidates); i++) {
+
+        /* port or driver may not support every rate */
+        if (serial_set_baudrate(portsettings, candidates[i]) == -1) continue;
+
+        serial_tx(portsettings, portsettings->probe);
+        if (serial_rx(portsettings, &line, &len, &timing) == -1) return -1;
+        if (line && valid_probe(portsettings, line, len)) return 0;
+    }
+
+    fprintf(stderr, "auto-baud: no valid response at any baudrate\n");
+    return -1;
+}
 
-    *buf = '\0';
+int serial_tx(portsettings_t* portsettings, const char *cmd)
+{
+    portsettings->rxfirst = 0;
+
+    /* plain text goes out with its terminator in a single gathered write */
+    if (!portsettings->txlen && !portsettings->hex
+            && portsettings->framing == FRAMING_LINE) {
+        struct iovec iov[2] = {
+            { .iov_base = (char*)(uintptr_t)cmd, .iov_len = strlen(cmd) },
+            { .iov_base = (char*)(uintptr_t)portsettings->terminator.bytes,
+                .iov_len = portsettings->terminator.len },
+        };
+        size_t len = iov[0].iov_len + iov[1].iov_len;
+        if (portsettings->record) {
+            record_write(portsettings->record, RECORD_TX, iov, 2);
+        }
+        if (write_all(portsettings->fd, iov, 2) == -1) return -1;
+        portsettings->txbytes += len;
+        if (portsettings->drain) tcdrain(portsettings->fd);
+        portsettings->txsent = now();
+        return 0;
+    }
+
+    if (encode(portsettings, cmd) == -1) return -1;
+    return serial_flush(portsettings);
+}
+
+int serial_write(portsettings_t* portsettings, const void* data, size_t len)
+{
+    struct iovec iov = {
+        .iov_base = (void*)(uintptr_t)data,
+        .iov_len = len,
+    };
+
+    if (serial_flush(portsettings) == -1) return -1;
+    if (portsettings->record) {
+        record_write(portsettings->record, RECORD_TX, &iov, 1);
+    }
+    if (write_all(portsettings->fd, &iov, 1) == -1) return -1;
+    portsettings->txbytes += len;
+    return 0;
+}
+
+int serial_queue(portsettings_t* portsettings, const char* cmd)
+{
+    if (encode(portsettings, cmd) == -1) return -1;
+    if (portsettings->txlen >= SERIAL_BURST) return serial_flush(portsettings);
+    return 0;
+}
 
-    struct timeval timeout = {
-        .tv_sec = 0,
-        .tv_usec = (long)(1000000.0 * portsettings->timeout),
+int serial_flush(portsettings_t* portsettings)
+{
+    struct iovec iov = {
+        .iov_base = portsettings->tx,
+        .iov_len = portsettings->txlen,
     };
 
-    switch (select(fd+1, &set, NULL, NULL, &timeout)) {
+    size_t len = portsettings->txlen;
+
+    if (!len) return 0;
+    portsettings->txlen = 0;
+
+    if (portsettings->record) {
+        record_write(portsettings->record, RECORD_TX, &iov, 1);
+    }
+    if (write_all(portsettings->fd, &iov, 1) == -1) return -1;
+    portsettings->txbytes += len;
+
+    /* only wait for the line to go idle when the protocol needs it */
+    if (portsettings->drain) tcdrain(portsettings->fd);
+    portsettings->txsent = now();
+    return 0;
+}
+
+int serial_encode(portsettings_t* portsettings, const char* cmd)
+{
+    portsettings->rxfirst = 0;
+    portsettings->txsent = now();
+    return encode(portsettings, cmd);
+}
+
+size_t serial_take(portsettings_t* portsettings, char* buf, size_t size)
+{
+    size_t len = portsettings->txlen < size ? portsettings->txlen : size;
+    if (!len) return 0;
+
+    memcpy(buf, portsettings->tx, len);
+    memmove(portsettings->tx, portsettings->tx + len,
+            portsettings->txlen - len);
+    portsettings->txlen -= len;
 
-        /* error select() */
-        case -1:
-            fprintf(stderr, "error selecting port: %s\n" , strerror(errno));
-            break;
+    if (portsettings->record) {
+        struct iovec iov = { .iov_base = buf, .iov_len = len };
+        record_write(portsettings->record, RECORD_TX, &iov, 1);
+    }
+    portsettings->txbytes += len;
+    return len;
+}
 
-        /* timeout occured - return 0 but empty buffer */
-        case 0:
-            return 0;
+void serial_sent(portsettings_t* portsettings)
+{
+    portsettings->txsent = now();
+}
 
-        /* available for reading */
-        default: {
+int serial_received(portsettings_t* portsettings, const char* data,
+        size_t len)
+{
+    if (rxbuf_append(&portsettings->rx, data, len) == -1) {
+        fprintf(stderr, "error allocating receive buffer\n");
+        return -1;
+    }
+    received(portsettings, len);
+    return 0;
+}
 
-            /* read from serial port */
-            n = read(fd, buf, size-1);
-            if (n > 0) {
-                /* trim CRLF */
-                *(strchr(buf, '\n')) = '\0';
-                *(strchr(buf, '\r')) = '\0';
-                return 0;
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
 
-            /* read() error */
-            } else if (n < 0) {
-                fprintf(stderr, "error reading port: %s\n" , strerror(errno));
+void received(portsettings_t* portsettings, size_t n)
+{
+    if (portsettings->record) {
+        struct iovec iov = {
+            .iov_base = portsettings->rx.data + portsettings->rx.tail - n,
+            .iov_len = n,
+        };
+        record_write(portsettings->record, RECORD_RX, &iov, 1);
+    }
+
+    portsettings->rxlast = now();
+    if (!portsettings->rxfirst) portsettings->rxfirst = portsettings->rxlast;
+    portsettings->rxbytes += n;
+}
+
+int spin(portsettings_t* portsettings, double period)
+{
+    double end = now() + period;
+
+    do {
+        ssize_t n = rxbuf_fill(&portsettings->rx, portsettings->fd);
+        if (n > 0) {
+            received(portsettings, (size_t)n);
+            return 1;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            fprintf(stderr, "error reading port: %s\n" , strerror(errno));
+            return -1;
+        }
+    } while (now() < end);
+    return 0;
+}
+
+int serial_read(portsettings_t* portsettings)
+{
+    ssize_t n = rxbuf_fill(&portsettings->rx, portsettings->fd);
+
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EINTR) return 0;
+        fprintf(stderr, "error reading port: %s\n" , strerror(errno));
+        return -1;
+    }
+
+    /* readable but nothing to read, device is gone */
+    if (n == 0) {
+        fprintf(stderr, "error reading port: hangup\n");
+        return -1;
+    }
+
+    received(portsettings, (size_t)n);
+    return 0;
+}
+
+int serial_pending(const portsettings_t* portsettings)
+{
+    struct pollfd pfd = { .fd = portsettings->fd, .events = POLLIN };
+
+    if (portsettings->rx.tail > portsettings->rx.head) return 1;
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+int serial_line(portsettings_t* portsettings, char** line, size_t* len)
+{
+    int status;
+
+    if (portsettings->framing == FRAMING_LINE) {
+        return rxbuf_line(&portsettings->rx, &portsettings->delimiter, line, len);
+    }
+
+    while ((status = framing_decode(portsettings->framing, &portsettings->rx,
+                    line, len)) == -1) {
+        fprintf(stderr, "dropped malformed %s frame\n",
+                framing_name(portsettings->framing));
+    }
+    return status;
+}
+
+double serial_deadline(const portsettings_t* portsettings,
+        const timing_t* timing)
+{
+    /* deadlines follow the traffic, they are not re-armed per line */
+    double deadline = portsettings->rxfirst
+        ? portsettings->rxlast + timing->gap
+        : portsettings->txsent + timing->first;
+
+    if (timing->total && portsettings->txsent + timing->total < deadline) {
+        deadline = portsettings->txsent + timing->total;
+    }
+    return deadline;
+}
+
+int serial_rx(portsettings_t* portsettings, char** line, size_t* len,
+        const timing_t* timing)
+{
+    int fd = portsettings->fd;
+    fd_set set;
+
+    *line = NULL;
+    *len = 0;
+
+    /* a single read() may have delivered several lines */
+    while (!serial_line(portsettings, line, len)) {
+
+        double wait = serial_deadline(portsettings, timing) - now();
+        if (wait <= 0) return 0;
+
+        /* the spin period is taken from the wait */
+        if (portsettings->spin) {
+            double period = portsettings->spin / 1e6;
+            if (period > wait) period = wait;
+            switch (spin(portsettings, period)) {
+                case -1: return -1;
+                case 1: continue;
+                default: break;
+            }
+            wait -= period;
+        }
+
+        FD_ZERO(&set);
+        FD_SET(fd, &set);
+
+        struct timespec ts = {
+            .tv_sec = (time_t)wait,
+            .tv_nsec = (long)(1e9 * (wait - (double)(time_t)wait)),
+        };
+
+        switch (pselect(fd+1, &set, NULL, NULL, &ts, NULL)) {
+
+            /* error pselect() */
+            case -1:
+                if (errno == EINTR) return 0;
+                fprintf(stderr, "error selecting port: %s\n" , strerror(errno));
+                return -1;
+
+            /* the deadline is checked again at the top */
+            case 0:
                 break;
 
-            /* read should never return 0 as read is canonical (blocking) */
-            } else {
-                printf("read() returned 0, this should not happen??\n");
+            /* available for reading */
+            default:
+                if (serial_read(portsettings) == -1) return -1;
                 break;
-            }
         }
     }
-    return -1;
+    return 0;
 }
 
-int serial_die(void) {
+int serial_die(portsettings_t* portsettings) {
+
+    int fd = portsettings->fd;
+    if (fd == -1) return 0;
+
+    serial_flush(portsettings);
+    portsettings->fd = -1;
+
+    /* the flag outlives the open port, leave the driver as it was */
+    if (portsettings->asynclow) {
+        struct serial_struct ss;
+        if (ioctl(fd, TIOCGSERIAL, &ss) != -1) {
+            ss.flags &= ~LOW_LATENCY;
+            ioctl(fd, TIOCSSERIAL, &ss);
+        }
+        portsettings->asynclow = 0;
+    }
+
+    /* bytes lost while the port was open */
+    icount_t last;
+    if (portsettings->icount.valid && icount(fd, &last) != -1) {
+        icount_t* then = &portsettings->icount;
+        if (last.overrun != then->overrun
+                || last.buf_overrun != then->buf_overrun
+                || last.frame != then->frame || last.parity != then->parity
+                || last.brk != then->brk) {
+            fprintf(stderr, "%s: overrun %i, buffer overrun %i, framing %i, "
+                    "parity %i, break %i\n", portsettings->port,
+                    last.overrun - then->overrun,
+                    last.buf_overrun - then->buf_overrun,
+                    last.frame - then->frame, last.parity - then->parity,
+                    last.brk - then->brk);
+        }
+    }
 
-    if (tcsetattr(fd, TCSANOW, &oldtty) == -1) {
+    /* let queued output leave before the original settings return */
+    if (tcsetattr(fd, TCSADRAIN, &portsettings->oldtty) == -1) {
         fprintf(stderr, "error resetting serial port settings: %s\n",
                 strerror(errno));
+        close(fd);
         return -1;
     }
 
-    if (fd) close(fd);
+    close(fd);
     return 0;
 }
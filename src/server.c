@@ -0,0 +1,593 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : server.c
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/framing.h"
+#include "../include/serial.h"
+#include "../include/server.h"
+
+/**
+ * max number of connections waiting to be accepted
+ */
+#define SERVER_BACKLOG 16
+
+/**
+ * max number of events handled per epoll_wait
+ */
+#define SERVER_EVENTS 64
+
+typedef struct server_t server_t;
+
+/**
+ * connection accepted by the server
+ */
+typedef struct client_t {
+    int fd;                  /**< connected socket, -1 once closed */
+    rxbuf_t rx;              /**< received requests */
+    char* out;               /**< encoded records not yet sent */
+    size_t outlen;           /**< length of out */
+    size_t outsize;          /**< allocated length of out */
+    int writing;             /**< EPOLLOUT is armed */
+    session_t* session;      /**< device that receives the commands */
+    unsigned int pending;    /**< queued commands not yet finished */
+    server_t* server;        /**< server owning this client */
+    struct client_t* next;   /**< next client in list */
+} client_t;
+
+/**
+ * state of the event loop
+ */
+struct server_t {
+    int fd;                  /**< listening socket */
+    int epfd;                /**< epoll instance */
+    session_t* sessions;     /**< served devices */
+    size_t n;                /**< length of sessions */
+    client_t* clients;       /**< list of connections */
+    char* scratch;           /**< record before encoding */
+    size_t scratchsize;      /**< allocated length of scratch */
+};
+
+/**
+ * requests are lines terminated by LF, a CR before it is dropped
+ */
+static const delimiter_t request_delimiter = { { '\n', 0 }, 1, 1 };
+
+/**
+ * create listening socket, a stale socket file is replaced
+ *
+ * @param[in] path path of the unix domain socket
+ * @return file descriptor or -1 for failure
+ */
+static int listen_on(const char* path);
+
+/**
+ * open port of session and add it to the epoll set
+ *
+ * @param[in] server server owning the session
+ * @param[in,out] session session to open
+ * @return status 0 for succes, -1 for failure
+ */
+static int open_port(server_t* server, session_t* session);
+
+/**
+ * accept pending connections
+ *
+ * @param[in,out] server server with readable listening socket
+ */
+static void accept_clients(server_t* server);
+
+/**
+ * read requests of a client and queue its commands
+ *
+ * @param[in,out] client client with readable socket
+ */
+static void receive(client_t* client);
+
+/**
+ * handle a single request line
+ *
+ * @param[in,out] client client that sent the request
+ * @param[in] line request without line terminator
+ */
+static void request(client_t* client, const char* line);
+
+/**
+ * encode record and append it to the output of a client
+ *
+ * @param[in,out] client receiver of the record
+ * @param[in] type record type
+ * @param[in] data payload
+ * @param[in] len length of payload
+ * @param[in] hex payload is to be sent as hexadecimal text
+ */
+static void record(client_t* client, char type, const char* data, size_t len,
+        int hex);
+
+/**
+ * session callback, responses are sent to the client that queued the command
+ *
+ * @param[in] session device the line was received on
+ * @param[in] cmd command the line is a response to
+ * @param[in] line response line or NULL when the command is finished
+ * @param[in] len length of line
+ */
+static void respond(const session_t* session, const char* cmd,
+        const char* line, size_t len);
+
+/**
+ * send as much output as the socket accepts and (dis)arm EPOLLOUT
+ *
+ * @param[in,out] client client with output
+ */
+static void transmit(client_t* client);
+
+/**
+ * close socket of client, it is freed when its last command finishes
+ *
+ * @param[in,out] client client to disconnect
+ */
+static void disconnect(client_t* client);
+
+/**
+ * write buffer completely to a blocking socket
+ *
+ * @param[in] fd socket
+ * @param[in] buf data
+ * @param[in] len length of data
+ * @return status 0 for succes, -1 for failure
+ */
+static int send_all(int fd, const char* buf, size_t len);
+
+/**
+ * send a request line and wait for the end of its response
+ *
+ * @param[in,out] conn connection to the server
+ * @param[in] line request without line terminator
+ * @param[in] cmd command passed to reply
+ * @param[in] reply callback for every response line or NULL
+ * @return status 0 for succes, -1 for failure
+ */
+static int transact(server_conn_t* conn, const char* line, const char* cmd,
+        server_reply_t reply);
+
+int listen_on(const char* path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    0)) == -1) {
+        fprintf(stderr, "error creating socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    /* a socket left behind by a server that is no longer running */
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int alive = probe != -1 && connect(probe, (struct sockaddr*)&addr,
+                sizeof(addr)) == 0;
+        if (probe != -1) close(probe);
+        if (alive) {
+            fprintf(stderr, "server already running on %s\n", path);
+            close(fd);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1
+            || listen(fd, SERVER_BACKLOG) == -1) {
+        fprintf(stderr, "error listening on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int open_port(server_t* server, session_t* session)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = session };
+
+    if (serial_init(&session->portsettings) == -1) return -1;
+    if (epoll_ctl(server->epfd, EPOLL_CTL_ADD, session->portsettings.fd,
+                &ev) == -1) {
+        fprintf(stderr, "%s: %s\n", session->name, strerror(errno));
+        serial_die(&session->portsettings);
+        return -1;
+    }
+    return 0;
+}
+
+void accept_clients(server_t* server)
+{
+    int fd;
+
+    while ((fd = accept(server->fd, NULL, NULL)) != -1) {
+        client_t* client = calloc(1, sizeof(client_t));
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = client };
+
+        if (!client || fcntl(fd, F_SETFL, O_NONBLOCK) == -1 || epoll_ctl(server->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            fprintf(stderr, "error accepting client: %s\n", strerror(errno));
+            free(client);
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->session = &server->sessions[0];
+        client->server = server;
+        client->next = server->clients;
+        server->clients = client;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        fprintf(stderr, "error accepting client: %s\n", strerror(errno));
+    }
+}
+
+void receive(client_t* client)
+{
+    char* line;
+    size_t len;
+    ssize_t n = rxbuf_fill(&client->rx, client->fd);
+
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) return;
+    if (n <= 0) {
+        disconnect(client);
+        return;
+    }
+    while (client->fd != -1
+            && rxbuf_line(&client->rx, &request_delimiter, &line, &len)) {
+        request(client, line);
+    }
+}
+
+void request(client_t* client, const char* line)
+{
+    server_t* server = client->server;
+    session_t* session = client->session;
+
+    /* select device */
+    if (line[0] == '@') {
+        for (size_t i = 0; i < server->n; i++) {
+            if (strcmp(server->sessions[i].name, line+1) == 0) {
+                client->session = &server->sessions[i];
+                record(client, 'E', NULL, 0, 0);
+                return;
+            }
+        }
+        record(client, '!', "unknown device", strlen("unknown device"), 0);
+        return;
+    }
+
+    /* the port failed earlier, try again */
+    if (session->portsettings.fd == -1 && open_port(server, session) == -1) {
+        record(client, '!', "device unavailable",
+                strlen("device unavailable"), 0);
+        return;
+    }
+
+    if (session_queue(session, line, client) == -1) {
+        record(client, '!', "out of memory", strlen("out of memory"), 0);
+        return;
+    }
+    client->pending++;
+    session_advance(session, respond);
+}
+
+void record(client_t* client, char type, const char* data, size_t len,
+        int hex)
+{
+    server_t* server = client->server;
+    size_t size = 1 + (hex ? 2 * len : len);
+
+    if (client->fd == -1) return;
+
+    /* room for the null character written by sprintf */
+    if (size + 1 > server->scratchsize) {
+        char* scratch = realloc(server->scratch, size + 1);
+        if (!scratch) return;
+        server->scratch = scratch;
+        server->scratchsize = size + 1;
+    }
+    server->scratch[0] = type;
+    if (hex) {
+        for (size_t i = 0; i < len; i++) {
+            sprintf(&server->scratch[1 + 2*i], "%02x", (unsigned char)data[i]);
+        }
+    } else if (len) {
+        memcpy(&server->scratch[1], data, len);
+    }
+
+    size_t bound = framing_bound(FRAMING_COBS, size);
+    if (client->outlen + bound > client->outsize) {
+        size_t outsize = client->outsize ? client->outsize : 4096;
+        while (client->outlen + bound > outsize) outsize *= 2;
+        char* out = realloc(client->out, outsize);
+        if (!out) return;
+        client->out = out;
+        client->outsize = outsize;
+    }
+    client->outlen += (size_t)framing_encode(FRAMING_COBS, server->scratch,
+            size, &client->out[client->outlen]);
+}
+
+void respond(const session_t* session, const char* cmd, const char* line,
+        size_t len)
+{
+    client_t* client = session->tag;
+
+    (void)cmd;
+
+    if (line) {
+        record(client, 'L', line, len, session->portsettings.hex);
+        return;
+    }
+
+    client->pending--;
+    if (session->received < session->portsettings.count) {
+        record(client, 'T', NULL, 0, 0);
+    } else {
+        record(client, 'E', NULL, 0, 0);
+    }
+}
+
+void transmit(client_t* client)
+{
+    size_t sent = 0;
+
+    while (sent < client->outlen) {
+        ssize_t n = send(client->fd, client->out + sent, client->outlen - sent,
+                MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            disconnect(client);
+            return;
+        }
+        sent += (size_t)n;
+    }
+    memmove(client->out, client->out + sent, client->outlen - sent);
+    client->outlen -= sent;
+
+    /* only wait for the socket to drain while output is left */
+    int writing = client->outlen > 0;
+    if (writing != client->writing) {
+        struct epoll_event ev = {
+            .events = EPOLLIN | (writing ? EPOLLOUT : 0),
+            .data.ptr = client
+        };
+        epoll_ctl(client->server->epfd, EPOLL_CTL_MOD, client->fd, &ev);
+        client->writing = writing;
+    }
+}
+
+void disconnect(client_t* client)
+{
+    if (client->fd == -1) return;
+    epoll_ctl(client->server->epfd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+    client->outlen = 0;
+}
+
+int server_run(const char* path, session_t* sessions, size_t n,
+        volatile sig_atomic_t* killed)
+{
+    server_t server = { .sessions = sessions, .n = n };
+    struct epoll_event events[SERVER_EVENTS];
+    int status = 0;
+
+    if (!n) {
+        fprintf(stderr, "no device to serve\n");
+        return -1;
+    }
+    if ((server.epfd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        fprintf(stderr, "error creating event loop: %s\n", strerror(errno));
+        return -1;
+    }
+    if ((server.fd = listen_on(path)) == -1) {
+        close(server.epfd);
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(server.epfd, EPOLL_CTL_ADD, server.fd, &ev);
+
+    /* ports stay open, one that fails is retried with the next request */
+    for (size_t i = 0; i < n; i++) {
+        if (open_port(&server, &sessions[i]) == -1) {
+            fprintf(stderr, "%s: device unavailable\n", sessions[i].name);
+        }
+    }
+
+    while (!*killed) {
+        int nev = epoll_wait(server.epfd, events, SERVER_EVENTS,
+                session_timeout(sessions, n));
+        if (nev == -1) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "error waiting for events: %s\n", strerror(errno));
+            status = -1;
+            break;
+        }
+
+        for (int i = 0; i < nev; i++) {
+            void* ptr = events[i].data.ptr;
+
+            if (!ptr) {
+                accept_clients(&server);
+            } else if ((session_t*)ptr >= sessions
+                    && (session_t*)ptr < sessions + n) {
+                session_receive(ptr, respond);
+            } else if (events[i].events & EPOLLIN) {
+                receive(ptr);
+            }
+        }
+
+        /* expire timed out commands */
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (size_t i = 0; i < n; i++) session_expire(&sessions[i], &now, respond);
+
+        /* send the records of this round and free finished clients */
+        client_t** link = &server.clients;
+        while (*link) {
+            client_t* client = *link;
+            if (client->outlen) transmit(client);
+            if (client->fd == -1 && !client->pending) {
+                *link = client->next;
+                rxbuf_die(&client->rx);
+                free(client->out);
+                free(client);
+            } else {
+                link = &client->next;
+            }
+        }
+    }
+
+    while (server.clients) {
+        client_t* client = server.clients;
+        server.clients = client->next;
+        disconnect(client);
+        rxbuf_die(&client->rx);
+        free(client->out);
+        free(client);
+    }
+    for (size_t i = 0; i < n; i++) serial_die(&sessions[i].portsettings);
+    free(server.scratch);
+    close(server.fd);
+    unlink(path);
+    close(server.epfd);
+    return status;
+}
+
+int send_all(int fd, const char* buf, size_t len)
+{
+    while (len) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int transact(server_conn_t* conn, const char* line, const char* cmd,
+        server_reply_t reply)
+{
+    size_t len = strlen(line);
+    char* frame;
+    size_t flen;
+
+    /* command and line terminator in one message */
+    char* msg = malloc(len + 1);
+    if (!msg) return -1;
+    memcpy(msg, line, len);
+    msg[len] = '\n';
+    int status = send_all(conn->fd, msg, len + 1);
+    free(msg);
+    if (status == -1) {
+        fprintf(stderr, "error sending request: %s\n", strerror(errno));
+        return -1;
+    }
+
+    for (;;) {
+        int r = framing_decode(FRAMING_COBS, &conn->rx, &frame, &flen);
+
+        if (r == 0) {
+            ssize_t n = rxbuf_fill(&conn->rx, conn->fd);
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) {
+                fprintf(stderr, "connection to server lost\n");
+                return -1;
+            }
+            continue;
+        }
+        if (r == -1 || !flen) {
+            fprintf(stderr, "malformed reply from server\n");
+            return -1;
+        }
+
+        switch (frame[0]) {
+            case 'L':
+                if (reply) reply(cmd, frame+1, flen-1);
+                break;
+            case 'E':
+            case 'T':
+                return 0;
+            case '!':
+                fprintf(stderr, "%.*s: %s\n", (int)(flen-1), frame+1, line);
+                return -1;
+            default:
+                fprintf(stderr, "malformed reply from server\n");
+                return -1;
+        }
+    }
+}
+
+int server_connect(server_conn_t* conn, const char* path, const char* device)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    memset(conn, 0, sizeof(server_conn_t));
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        conn->fd = -1;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    if ((conn->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1
+            || connect(conn->fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        fprintf(stderr, "error connecting to %s: %s\n", path, strerror(errno));
+        server_close(conn);
+        return -1;
+    }
+
+    if (device) {
+        char* select = malloc(strlen(device) + 2);
+        if (!select) return -1;
+        select[0] = '@';
+        strcpy(select+1, device);
+        int status = transact(conn, select, NULL, NULL);
+        free(select);
+        return status;
+    }
+    return 0;
+}
+
+int server_request(server_conn_t* conn, const char* cmd, server_reply_t reply)
+{
+    return transact(conn, cmd, cmd, reply);
+}
+
+void server_close(server_conn_t* conn)
+{
+    if (conn->fd != -1) close(conn->fd);
+    conn->fd = -1;
+    rxbuf_die(&conn->rx);
+}
+
+// vim:ft=c
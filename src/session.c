@@ -0,0 +1,780 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : session.c
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/serial.h"
+#include "../include/session.h"
+#include "../include/uring.h"
+
+/**
+ * nanoseconds per second
+ */
+#define NSEC 1000000000L
+
+/**
+ * length of the registered receive and of the transmit buffer of a port
+ */
+#define RING_BUF SERIAL_BURST
+
+/**
+ * request data, the index of the session or timer above the kind of request
+ */
+#define RING_DATA(i, op) ((uint64_t)(i) << 8 | (uint64_t)(op))
+
+/**
+ * kind of io_uring request
+ */
+typedef enum {
+    RING_POLL = 1,        /**< wait for input, linked to RING_READ */
+    RING_READ,            /**< read into the receive buffer */
+    RING_WAIT,            /**< wait for room, linked to RING_WRITE */
+    RING_WRITE,           /**< write from the transmit buffer */
+    RING_TIMEOUT,         /**< earliest deadline of all ports */
+    RING_CANCEL,          /**< cancellation, result ignored */
+} ring_op_t;
+
+/**
+ * io_uring state of a session
+ */
+typedef struct ring_t {
+    char* rx;             /**< receive buffer within the registered region */
+    char* tx;             /**< transmit buffer within the registered region */
+    size_t slot;          /**< index of the rx and tx pair in the region */
+    size_t txlen;         /**< bytes in tx */
+    size_t txoff;         /**< bytes of tx written */
+    unsigned int inflight; /**< requests not completed */
+    int writing;          /**< a write is in flight */
+    int blocked;          /**< the last write found the driver full */
+    int closing;          /**< requests cancelled, closed once none is left */
+} ring_t;
+
+/**
+ * (re)start the receive timeout of the command in flight
+ *
+ * @param[in,out] session deadline is set from the first, gap and total
+ *                limits of its port
+ */
+static void arm(session_t* session);
+
+/**
+ * report the command in flight as finished
+ *
+ * @param[in,out] session session whose command is finished
+ * @param[in] output callback to report to
+ */
+static void finish(session_t* session, session_output_t output);
+
+/**
+ * hand out buffered lines to the commands awaiting them
+ *
+ * @param[in,out] session session with freshly received data
+ * @param[in] output callback for every received line
+ */
+static void dispatch(session_t* session, session_output_t output);
+
+/**
+ * finish the command in flight and every queued command of a failed port
+ *
+ * @param[in,out] session session to give up, failed is set
+ * @param[in] output callback for every finished command
+ */
+static void drop(session_t* session, session_output_t output);
+
+/**
+ * open the port of a session and transmit its first command
+ *
+ * @param[in,out] session session to start, failed is set on failure
+ * @param[in] epfd event loop to add the port to
+ * @param[in] output callback for every received line
+ * @return status 0 for succes, -1 for failure
+ */
+static int start(session_t* session, int epfd, session_output_t output);
+
+/**
+ * serve the sessions from an epoll loop
+ *
+ * @see session_run()
+ */
+static int run_epoll(session_t* sessions, size_t n, size_t jobs,
+        session_output_t output, volatile sig_atomic_t* killed);
+
+/**
+ * prepare a wait for input linked to a read into the receive buffer
+ *
+ * @param[in,out] uring ring
+ * @param[in] session session with open port
+ * @param[in,out] ring its io_uring state
+ * @param[in] i index of the session
+ * @return status 0 for succes, -1 for failure
+ */
+static int ring_read(uring_t* uring, session_t* session, ring_t* ring,
+        size_t i);
+
+/**
+ * prepare a write of the encoded commands unless one is in flight
+ *
+ * @param[in,out] uring ring
+ * @param[in,out] session session with open port
+ * @param[in,out] ring its io_uring state
+ * @param[in] i index of the session
+ * @return status 0 for succes, -1 for failure
+ */
+static int ring_write(uring_t* uring, session_t* session, ring_t* ring,
+        size_t i);
+
+/**
+ * prepare the cancellation of the requests of a port that is to be closed
+ *
+ * @param[in,out] uring ring
+ * @param[in,out] ring io_uring state of the session, closing is set
+ * @param[in] i index of the session
+ * @param[in] all writes too, otherwise they are left to finish
+ * @return status 0 for succes, -1 for failure
+ */
+static int ring_close(uring_t* uring, ring_t* ring, size_t i, int all);
+
+/**
+ * open the port of a session, transmit its first command and start reading
+ *
+ * @param[in,out] uring ring
+ * @param[in,out] session session to start, failed is set on failure
+ * @param[in,out] ring its io_uring state, rx and tx are set
+ * @param[in] i index of the session
+ * @param[in] output callback for every received line
+ * @return status 0 for succes, -1 for failure
+ */
+static int ring_start(uring_t* uring, session_t* session, ring_t* ring,
+        size_t i, session_output_t output);
+
+/**
+ * handle the completion of a port request
+ *
+ * @param[in,out] uring ring
+ * @param[in,out] session session the request belongs to
+ * @param[in,out] ring its io_uring state
+ * @param[in] i index of the session
+ * @param[in] op kind of request
+ * @param[in] res result of the request
+ * @param[in] output callback for every received line
+ * @return status 0 for succes, -1 for failure
+ */
+static int ring_complete(uring_t* uring, session_t* session, ring_t* ring,
+        size_t i, ring_op_t op, int res, session_output_t output);
+
+/**
+ * serve the sessions from an io_uring, falls back to run_epoll()
+ *
+ * @see session_run()
+ */
+static int run_uring(session_t* sessions, size_t n, size_t jobs,
+        session_output_t output, volatile sig_atomic_t* killed);
+
+void session_init(session_t* session, const char* name,
+        const portsettings_t* portsettings)
+{
+    memset(session, 0, sizeof(session_t));
+
+    session->name = malloc(strlen(name)+1);
+    strcpy(session->name, name);
+
+    session->portsettings = portsettings_copy(portsettings);
+}
+
+int session_queue(session_t* session, const char* cmd, void* tag)
+{
+    if (session->queued == session->size) {
+        size_t size = session->size ? 2 * session->size : 16;
+        session_cmd_t* queue = realloc(session->queue,
+                size * sizeof(session_cmd_t));
+        if (!queue) {
+            fprintf(stderr, "%s: %s\n", session->name, strerror(errno));
+            return -1;
+        }
+        session->queue = queue;
+        session->size = size;
+    }
+
+    char* copy = malloc(strlen(cmd)+1);
+    if (!copy) return -1;
+    strcpy(copy, cmd);
+    session->queue[session->queued].cmd = copy;
+    session->queue[session->queued].tag = tag;
+    session->queued++;
+    return 0;
+}
+
+void arm(session_t* session)
+{
+    timing_t timing = portsettings_timing(&session->portsettings);
+    double deadline = serial_deadline(&session->portsettings, &timing);
+
+    session->deadline.tv_sec = (time_t)deadline;
+    session->deadline.tv_nsec = (long)((deadline - (double)(time_t)deadline)
+            * NSEC);
+}
+
+void finish(session_t* session, session_output_t output)
+{
+    unsigned int count = session->portsettings.count;
+
+    /* an unlimited count always ends by its deadline */
+    session->done++;
+    if (count && (!session->received
+                || (count != UINT_MAX && session->received < count))) {
+        session->timeouts++;
+    }
+    output(session, session->cmd, NULL, 0);
+    session->cmd = NULL;
+    session->tag = NULL;
+}
+
+void session_advance(session_t* session, session_output_t output)
+{
+    while (!session->cmd && session->next < session->queued) {
+        session_cmd_t* next = &session->queue[session->next++];
+        if (session->uring && !session->portsettings.drain) {
+            serial_encode(&session->portsettings, next->cmd);
+        } else {
+            serial_tx(&session->portsettings, next->cmd);
+        }
+
+        session->cmd = next->cmd;
+        session->tag = next->tag;
+        session->received = 0;
+
+        /* no response expected, continue with the next command */
+        if (!session->portsettings.count) {
+            finish(session, output);
+            continue;
+        }
+        arm(session);
+    }
+
+    /* everything is sent, release the queue for new commands */
+    if (!session->cmd && session->next == session->queued) {
+        for (size_t i = 0; i < session->queued; i++) {
+            free(session->queue[i].cmd);
+        }
+        session->queued = session->next = 0;
+    }
+}
+
+void dispatch(session_t* session, session_output_t output)
+{
+    char* line;
+    size_t len;
+
+    while (session->cmd && serial_line(&session->portsettings, &line, &len)) {
+        output(session, session->cmd, line, len);
+        if (++session->received == session->portsettings.count) {
+            finish(session, output);
+            session_advance(session, output);
+        }
+    }
+}
+
+int session_receive(session_t* session, session_output_t output)
+{
+    if (serial_read(&session->portsettings) != -1) {
+        if (session->cmd) arm(session);
+        dispatch(session, output);
+        return 0;
+    }
+
+    /* a failing port is dropped with its remaining commands */
+    fprintf(stderr, "%s: receive failed\n", session->name);
+    serial_die(&session->portsettings);
+    drop(session, output);
+    return -1;
+}
+
+void drop(session_t* session, session_output_t output)
+{
+    session->failed = 1;
+    if (session->cmd) finish(session, output);
+    while (session->next < session->queued) {
+        session_cmd_t* next = &session->queue[session->next++];
+        session->cmd = next->cmd;
+        session->tag = next->tag;
+        session->received = 0;
+        finish(session, output);
+    }
+}
+
+void session_expire(session_t* session, const struct timespec* now,
+        session_output_t output)
+{
+    if (!session->cmd) return;
+    if (session->deadline.tv_sec > now->tv_sec || (session->deadline.tv_sec
+                == now->tv_sec && session->deadline.tv_nsec > now->tv_nsec)) {
+        return;
+    }
+    finish(session, output);
+    session_advance(session, output);
+    dispatch(session, output);
+}
+
+int session_timeout(const session_t* sessions, size_t n)
+{
+    struct timespec now;
+    long long ms = -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (size_t i = 0; i < n; i++) {
+        const session_t* s = &sessions[i];
+        if (!s->cmd) continue;
+
+        long long ns = (long long)(s->deadline.tv_sec - now.tv_sec) * NSEC
+            + (s->deadline.tv_nsec - now.tv_nsec);
+        long long t = ns <= 0 ? 0 : (ns + 999999) / 1000000;
+        if (ms == -1 || t < ms) ms = t;
+    }
+    return (int)ms;
+}
+
+int start(session_t* session, int epfd, session_output_t output)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = session };
+
+    if (session->failed) return -1;
+    if (serial_init(&session->portsettings) == -1) {
+        fprintf(stderr, "%s: skipping device\n", session->name);
+        session->failed = 1;
+        return -1;
+    }
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, session->portsettings.fd, &ev) == -1) {
+        fprintf(stderr, "%s: %s\n", session->name, strerror(errno));
+        serial_die(&session->portsettings);
+        session->failed = 1;
+        return -1;
+    }
+    session_advance(session, output);
+    return 0;
+}
+
+int run_epoll(session_t* sessions, size_t n, size_t jobs,
+        session_output_t output, volatile sig_atomic_t* killed)
+{
+    int status = 0;
+    struct epoll_event* events;
+    size_t opened = 0;
+    size_t active = 0;
+    int epfd;
+
+    if ((epfd = epoll_create1(0)) == -1) {
+        fprintf(stderr, "error creating event loop: %s\n", strerror(errno));
+        return -1;
+    }
+    events = calloc(n, sizeof(struct epoll_event));
+
+    while (!*killed) {
+
+        /* a finished port makes room for the next, closing it removes it
+         * from the epoll set */
+        for (size_t i = 0; i < opened; i++) {
+            session_t* s = &sessions[i];
+            if (s->portsettings.fd != -1 && !s->cmd && !s->queued) {
+                serial_die(&s->portsettings);
+            }
+        }
+        active = 0;
+        for (size_t i = 0; i < opened; i++) {
+            if (sessions[i].portsettings.fd != -1) active++;
+        }
+
+        /* a device that fails to open does not stop the others */
+        while (opened < n && (!jobs || active < jobs)) {
+            if (start(&sessions[opened++], epfd, output) == -1) status = -1;
+            else active++;
+        }
+
+        int timeout = session_timeout(sessions, opened);
+        if (timeout == -1) {
+            if (opened < n || active) continue;
+            break;
+        }
+
+        int nev = epoll_wait(epfd, events, (int)n, timeout);
+        if (nev == -1) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "error waiting for ports: %s\n", strerror(errno));
+            status = -1;
+            break;
+        }
+
+        for (int i = 0; i < nev; i++) {
+            if (session_receive(events[i].data.ptr, output) == -1) status = -1;
+        }
+
+        /* expire timed out commands */
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (size_t i = 0; i < opened; i++) {
+            session_expire(&sessions[i], &now, output);
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) serial_die(&sessions[i].portsettings);
+    free(events);
+    close(epfd);
+    return status;
+}
+
+int ring_read(uring_t* uring, session_t* session, ring_t* ring, size_t i)
+{
+    int fd = session->portsettings.fd;
+
+    /* a port without input reads 0 bytes, the read only follows the poll */
+    if (uring_poll(uring, fd, POLLIN, RING_DATA(i, RING_POLL), 1) == -1
+            || uring_read_fixed(uring, fd, ring->rx, RING_BUF, 0,
+                RING_DATA(i, RING_READ), 0) == -1) {
+        return -1;
+    }
+    ring->inflight += 2;
+    return 0;
+}
+
+int ring_write(uring_t* uring, session_t* session, ring_t* ring, size_t i)
+{
+    int fd = session->portsettings.fd;
+
+    if (ring->writing) return 0;
+    if (ring->txoff == ring->txlen) {
+        ring->txoff = 0;
+        ring->txlen = serial_take(&session->portsettings, ring->tx, RING_BUF);
+        if (!ring->txlen) return 0;
+    }
+
+    /* the driver was full, write once it made room */
+    if (ring->blocked) {
+        if (uring_poll(uring, fd, POLLOUT, RING_DATA(i, RING_WAIT), 1) == -1) {
+            return -1;
+        }
+        ring->inflight++;
+        ring->blocked = 0;
+    }
+
+    if (uring_write_fixed(uring, fd, ring->tx + ring->txoff,
+                (unsigned int)(ring->txlen - ring->txoff), 0,
+                RING_DATA(i, RING_WRITE), 0) == -1) {
+        return -1;
+    }
+    ring->inflight++;
+    ring->writing = 1;
+    return 0;
+}
+
+int ring_close(uring_t* uring, ring_t* ring, size_t i, int all)
+{
+    ring->closing = 1;
+    if (uring_cancel(uring, RING_DATA(i, RING_POLL), 0,
+                RING_DATA(i, RING_CANCEL)) == -1
+            || uring_cancel(uring, RING_DATA(i, RING_WAIT), 0,
+                RING_DATA(i, RING_CANCEL)) == -1) {
+        return -1;
+    }
+    if (all && ring->writing && uring_cancel(uring, RING_DATA(i, RING_WRITE),
+                0, RING_DATA(i, RING_CANCEL)) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+int ring_start(uring_t* uring, session_t* session, ring_t* ring, size_t i,
+        session_output_t output)
+{
+    if (session->failed) return -1;
+    if (serial_init(&session->portsettings) == -1) {
+        fprintf(stderr, "%s: skipping device\n", session->name);
+        session->failed = 1;
+        return -1;
+    }
+    session->uring = 1;
+    ring->txlen = ring->txoff = 0;
+    ring->blocked = ring->closing = 0;
+    session_advance(session, output);
+    return ring_read(uring, session, ring, i);
+}
+
+int ring_complete(uring_t* uring, session_t* session, ring_t* ring, size_t i,
+        ring_op_t op, int res, session_output_t output)
+{
+    const char* error = "receive failed";
+
+    ring->inflight--;
+
+    switch (op) {
+        case RING_READ:
+            if (ring->closing || session->failed) return 0;
+            if (res > 0) {
+                if (serial_received(&session->portsettings, ring->rx,
+                            (size_t)res) == -1) {
+                    break;
+                }
+                if (session->cmd) arm(session);
+                dispatch(session, output);
+                return ring_read(uring, session, ring, i);
+            }
+
+            /* readable but nothing to read, device is gone */
+            if (res == -EAGAIN || res == -EINTR || res == -ECANCELED) {
+                return ring_read(uring, session, ring, i);
+            }
+            fprintf(stderr, "error reading port: %s\n",
+                    res ? strerror(-res) : "hangup");
+            break;
+
+        case RING_WRITE:
+            ring->writing = 0;
+            if (ring->closing || session->failed) return 0;
+            if (res >= 0) {
+                ring->txoff += (size_t)res;
+                if (ring->txoff == ring->txlen) {
+                    serial_sent(&session->portsettings);
+                    if (session->cmd) arm(session);
+                }
+                return 0;
+            }
+            if (res == -EAGAIN || res == -EINTR || res == -ECANCELED) {
+                ring->blocked = 1;
+                return 0;
+            }
+            fprintf(stderr, "error writing port: %s\n", strerror(-res));
+            error = "transmit failed";
+            break;
+
+        case RING_POLL:
+        case RING_WAIT:
+        case RING_TIMEOUT:
+        case RING_CANCEL:
+        default:
+            return 0;
+    }
+
+    /* a failing port is dropped with its remaining commands, it is closed
+     * once its requests are cancelled */
+    fprintf(stderr, "%s: %s\n", session->name, error);
+    drop(session, output);
+    return -1;
+}
+
+int run_uring(session_t* sessions, size_t n, size_t jobs,
+        session_output_t output, volatile sig_atomic_t* killed)
+{
+    int status = 0;
+    size_t slots = jobs && jobs < n ? jobs : n;
+    size_t opened = 0;
+    size_t active = 0;
+    unsigned int entries = 8;
+    uint64_t timer = 0;
+    struct timespec alarm = { 0, 0 };
+    int armed = 0;
+    uring_t uring;
+    char* region;
+    char* used;
+    ring_t* rings;
+
+    /* a port at most prepares a read, a write and their polls at once */
+    while (entries < 4 * slots + 4 && entries < 4096) entries *= 2;
+
+    if (uring_init(&uring, entries) == -1) {
+        fprintf(stderr, "io_uring unavailable: %s, using epoll\n",
+                strerror(errno));
+        return run_epoll(sessions, n, jobs, output, killed);
+    }
+
+    /* one registered region holds the rx and tx buffer of every open port */
+    region = malloc(slots * 2 * RING_BUF);
+    used = calloc(slots, 1);
+    rings = calloc(n, sizeof(ring_t));
+    struct iovec iov = { .iov_base = region, .iov_len = slots * 2 * RING_BUF };
+    if (!region || !used || !rings || uring_register(&uring, &iov, 1) == -1) {
+        fprintf(stderr, "io_uring unavailable: %s, using epoll\n",
+                strerror(errno));
+        uring_die(&uring);
+        free(region);
+        free(used);
+        free(rings);
+        return run_epoll(sessions, n, jobs, output, killed);
+    }
+
+    while (!*killed) {
+
+        /* a finished port makes room for the next once its requests are
+         * done, a failed one is closed as soon as they are cancelled */
+        active = 0;
+        for (size_t i = 0; i < opened; i++) {
+            session_t* s = &sessions[i];
+            ring_t* r = &rings[i];
+            if (s->portsettings.fd == -1) continue;
+
+            if (!r->closing && (s->failed || (!s->cmd && !s->queued
+                            && !r->writing && r->txoff == r->txlen
+                            && !s->portsettings.txlen))) {
+                if (ring_close(&uring, r, i, s->failed) == -1) goto fail;
+            }
+            if (r->closing && !r->inflight) {
+                serial_die(&s->portsettings);
+                used[r->slot] = 0;
+                continue;
+            }
+            active++;
+        }
+
+        /* a device that fails to open does not stop the others */
+        while (opened < n && (!jobs || active < jobs)) {
+            ring_t* r = &rings[opened];
+            for (r->slot = 0; used[r->slot]; r->slot++) continue;
+            r->rx = region + r->slot * 2 * RING_BUF;
+            r->tx = r->rx + RING_BUF;
+
+            int started = ring_start(&uring, &sessions[opened], r, opened,
+                    output);
+            if (sessions[opened].portsettings.fd != -1) {
+                used[r->slot] = 1;
+                active++;
+            }
+            opened++;
+            if (started == -1) status = -1;
+        }
+
+        if (!active) {
+            if (opened < n) continue;
+            break;
+        }
+
+        /* everything encoded since the last round goes out in this batch */
+        for (size_t i = 0; i < opened; i++) {
+            session_t* s = &sessions[i];
+            if (s->portsettings.fd == -1 || rings[i].closing) continue;
+            if (ring_write(&uring, s, &rings[i], i) == -1) goto fail;
+        }
+
+        /* one timer for the earliest deadline, a later one is not re-armed
+         * until the timer has fired */
+        struct timespec earliest = { 0, 0 };
+        int due = 0;
+        for (size_t i = 0; i < opened; i++) {
+            const session_t* s = &sessions[i];
+            if (!s->cmd || s->portsettings.fd == -1) continue;
+            if (!due || s->deadline.tv_sec < earliest.tv_sec
+                    || (s->deadline.tv_sec == earliest.tv_sec
+                        && s->deadline.tv_nsec < earliest.tv_nsec)) {
+                earliest = s->deadline;
+                due = 1;
+            }
+        }
+        if (due && (!armed || earliest.tv_sec < alarm.tv_sec
+                    || (earliest.tv_sec == alarm.tv_sec
+                        && earliest.tv_nsec < alarm.tv_nsec))) {
+            if (armed && uring_cancel(&uring, RING_DATA(timer, RING_TIMEOUT),
+                        1, RING_DATA(0, RING_CANCEL)) == -1) {
+                goto fail;
+            }
+            if (uring_timeout(&uring, &earliest,
+                        RING_DATA(++timer, RING_TIMEOUT)) == -1) {
+                goto fail;
+            }
+            alarm = earliest;
+            armed = 1;
+        }
+
+        if (uring_submit(&uring, 1) == -1) {
+            if (errno == EINTR) continue;
+            goto fail;
+        }
+
+        uint64_t data;
+        int res;
+        while (uring_complete(&uring, &data, &res)) {
+            ring_op_t op = (ring_op_t)(data & 0xff);
+            size_t i = (size_t)(data >> 8);
+
+            if (op == RING_TIMEOUT) {
+                if (i == timer) armed = 0;
+            } else if (op != RING_CANCEL && i < opened) {
+                if (ring_complete(&uring, &sessions[i], &rings[i], i, op, res,
+                            output) == -1) {
+                    status = -1;
+                }
+            }
+        }
+
+        /* expire timed out commands */
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (size_t i = 0; i < opened; i++) {
+            session_expire(&sessions[i], &now, output);
+        }
+    }
+
+    /* the buffers are only released once the kernel is done with them */
+    for (size_t i = 0; i < opened; i++) {
+        if (sessions[i].portsettings.fd == -1) continue;
+        if (ring_close(&uring, &rings[i], i, 1) == -1) goto fail;
+    }
+    for (;;) {
+        size_t inflight = 0;
+        for (size_t i = 0; i < opened; i++) inflight += rings[i].inflight;
+        if (!inflight) break;
+
+        if (uring_submit(&uring, 1) == -1) {
+            if (errno == EINTR) continue;
+            goto fail;
+        }
+        uint64_t data;
+        int res;
+        while (uring_complete(&uring, &data, &res)) {
+            ring_op_t op = (ring_op_t)(data & 0xff);
+            size_t i = (size_t)(data >> 8);
+            if (op != RING_TIMEOUT && op != RING_CANCEL && i < opened) {
+                rings[i].inflight--;
+            }
+        }
+    }
+    goto end;
+
+fail:
+    fprintf(stderr, "error serving ports: %s\n", strerror(errno));
+    status = -1;
+
+end:
+    uring_die(&uring);
+    for (size_t i = 0; i < n; i++) serial_die(&sessions[i].portsettings);
+    free(region);
+    free(used);
+    free(rings);
+    return status;
+}
+
+int session_run(session_t* sessions, size_t n, size_t jobs, int uring,
+        session_output_t output, volatile sig_atomic_t* killed)
+{
+    if (uring) return run_uring(sessions, n, jobs, output, killed);
+    return run_epoll(sessions, n, jobs, output, killed);
+}
+
+void session_die(session_t* session)
+{
+    serial_die(&session->portsettings);
+    portsettings_die(&session->portsettings);
+    for (size_t i = 0; i < session->queued; i++) free(session->queue[i].cmd);
+    free(session->queue);
+    free(session->name);
+    memset(session, 0, sizeof(session_t));
+    session->portsettings.fd = -1;
+}
@@ -0,0 +1,238 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : stats.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/stats.h"
+
+/**
+ * percentiles printed for every series
+ */
+static const struct {
+    const char* name;
+    double p;
+} percentiles[] = { {"p50", 0.50}, {"p90", 0.90}, {"p99", 0.99}, {"max", 1.0} };
+
+/**
+ * append sample to series
+ *
+ * @param[in,out] series series to grow
+ * @param[in] v sample
+ * @return status 0 for succes, -1 for failure
+ */
+static int push(series_t* series, double v);
+
+/**
+ * qsort comparator for doubles
+ *
+ * @param[in] a pointer to first double
+ * @param[in] b pointer to second double
+ * @return <0, 0 or >0
+ */
+static int compare(const void* a, const void* b);
+
+/**
+ * nearest-rank percentile of a sorted series
+ *
+ * @param[in] series sorted series with at least one sample
+ * @param[in] p fraction between 0 and 1
+ * @return sample
+ */
+static double percentile(const series_t* series, double p);
+
+/**
+ * print percentiles of a series as a table row or a json object
+ *
+ * @param[in] stream stream to print to
+ * @param[in] name name of the measurement
+ * @param[in,out] series series, sorted in place
+ * @param[in] json print json
+ */
+static void print_series(FILE* stream, const char* name, series_t* series,
+        int json);
+
+/**
+ * print string as json string
+ *
+ * @param[in] stream stream to print to
+ * @param[in] str string
+ */
+static void print_json_string(FILE* stream, const char* str);
+
+int push(series_t* series, double v)
+{
+    if (series->n == series->size) {
+        size_t size = series->size ? 2 * series->size : 64;
+        double* p = realloc(series->v, size * sizeof(double));
+        if (!p) return -1;
+        series->v = p;
+        series->size = size;
+    }
+    series->v[series->n++] = v;
+    return 0;
+}
+
+int compare(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+double percentile(const series_t* series, double p)
+{
+    double r = p * (double)series->n;
+    size_t rank = (size_t)r;
+
+    if ((double)rank < r) rank++;
+    return series->v[rank ? rank - 1 : 0];
+}
+
+int stats_add(stats_t* stats, const char* cmd, const sample_t* sample,
+        double start, double end)
+{
+    char prefix[STATS_PREFIX];
+    size_t len = strcspn(cmd, " \t");
+    stats_cmd_t* entry = NULL;
+
+    if (len >= STATS_PREFIX) len = STATS_PREFIX - 1;
+    memcpy(prefix, cmd, len);
+    prefix[len] = '\0';
+
+    for (size_t i = 0; i < stats->n; i++) {
+        if (strcmp(stats->entries[i].prefix, prefix) == 0) {
+            entry = &stats->entries[i];
+        }
+    }
+    if (!entry) {
+        stats_cmd_t* entries = realloc(stats->entries,
+                (stats->n+1) * sizeof(stats_cmd_t));
+        if (!entries) return -1;
+        stats->entries = entries;
+        entry = &stats->entries[stats->n++];
+        memset(entry, 0, sizeof(stats_cmd_t));
+        strcpy(entry->prefix, prefix);
+    }
+
+    if (!stats->start) stats->start = start;
+    stats->end = end;
+
+    entry->count++;
+    entry->bytes += sample->bytes;
+    entry->lines += sample->lines;
+    if (sample->timeout) entry->timeouts++;
+
+    if (push(&entry->tx, sample->tx) == -1) return -1;
+    if (sample->first >= 0 && push(&entry->first, sample->first) == -1) return -1;
+    if (sample->total >= 0 && push(&entry->total, sample->total) == -1) return -1;
+    return 0;
+}
+
+void print_json_string(FILE* stream, const char* str)
+{
+    fputc('"', stream);
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') fprintf(stream, "\\%c", c);
+        else if (c < 0x20) fprintf(stream, "\\u%04x", c);
+        else fputc(c, stream);
+    }
+    fputc('"', stream);
+}
+
+void print_series(FILE* stream, const char* name, series_t* series, int json)
+{
+    qsort(series->v, series->n, sizeof(double), compare);
+
+    if (json) {
+        fprintf(stream, "\"%s\":{\"n\":%zu", name, series->n);
+        for (size_t i = 0; i < sizeof(percentiles)/sizeof(percentiles[0]); i++) {
+            if (series->n) {
+                fprintf(stream, ",\"%s\":%.6f", percentiles[i].name,
+                        percentile(series, percentiles[i].p));
+            } else {
+                fprintf(stream, ",\"%s\":null", percentiles[i].name);
+            }
+        }
+        fprintf(stream, "}");
+        return;
+    }
+
+    fprintf(stream, "  %-6s", name);
+    for (size_t i = 0; i < sizeof(percentiles)/sizeof(percentiles[0]); i++) {
+        if (series->n) {
+            fprintf(stream, "  %s %9.3f ms", percentiles[i].name,
+                    1e3 * percentile(series, percentiles[i].p));
+        } else {
+            fprintf(stream, "  %s %9s   ", percentiles[i].name, "-");
+        }
+    }
+    fprintf(stream, "\n");
+}
+
+void stats_print(stats_t* stats, FILE* stream, int json)
+{
+    double elapsed = stats->end - stats->start;
+    size_t count = 0, bytes = 0, lines = 0, timeouts = 0;
+
+    for (size_t i = 0; i < stats->n; i++) {
+        count += stats->entries[i].count;
+        bytes += stats->entries[i].bytes;
+        lines += stats->entries[i].lines;
+        timeouts += stats->entries[i].timeouts;
+    }
+    double rate = elapsed > 0 ? (double)bytes / elapsed : 0;
+    double txrate = elapsed > 0 ? (double)stats->txbytes / elapsed : 0;
+
+    if (json) {
+        fprintf(stream, "{\"commands\":[");
+        for (size_t i = 0; i < stats->n; i++) {
+            stats_cmd_t* e = &stats->entries[i];
+            fprintf(stream, "%s{\"command\":", i ? "," : "");
+            print_json_string(stream, e->prefix);
+            fprintf(stream, ",\"count\":%zu,\"timeouts\":%zu,\"bytes\":%zu,"
+                    "\"lines\":%zu,", e->count, e->timeouts, e->bytes, e->lines);
+            print_series(stream, "tx", &e->tx, 1);
+            fprintf(stream, ",");
+            print_series(stream, "first", &e->first, 1);
+            fprintf(stream, ",");
+            print_series(stream, "total", &e->total, 1);
+            fprintf(stream, "}");
+        }
+        fprintf(stream, "],\"count\":%zu,\"timeouts\":%zu,\"bytes\":%zu,"
+                "\"lines\":%zu,\"txbytes\":%zu,\"elapsed\":%.6f,"
+                "\"bytes_per_sec\":%.1f,\"txbytes_per_sec\":%.1f}\n",
+                count, timeouts, bytes, lines, stats->txbytes, elapsed,
+                rate, txrate);
+        return;
+    }
+
+    for (size_t i = 0; i < stats->n; i++) {
+        stats_cmd_t* e = &stats->entries[i];
+        fprintf(stream, "%s: %zu commands, %zu timeouts, %zu bytes, %zu lines\n",
+                e->prefix, e->count, e->timeouts, e->bytes, e->lines);
+        print_series(stream, "tx", &e->tx, 0);
+        print_series(stream, "first", &e->first, 0);
+        print_series(stream, "total", &e->total, 0);
+    }
+    fprintf(stream, "total: %zu commands, %zu timeouts, %zu bytes received, "
+            "%zu sent in %.3f s, %.1f bytes/s received, %.1f bytes/s sent\n",
+            count, timeouts, bytes, stats->txbytes, elapsed, rate, txrate);
+}
+
+void stats_die(stats_t* stats)
+{
+    for (size_t i = 0; i < stats->n; i++) {
+        free(stats->entries[i].tx.v);
+        free(stats->entries[i].first.v);
+        free(stats->entries[i].total.v);
+    }
+    free(stats->entries);
+    memset(stats, 0, sizeof(stats_t));
+}
+
+// vim:ft=c
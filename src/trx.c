@@ -6,19 +6,45 @@
 
 #include <errno.h>
 #include <getopt.h>
+#include <glob.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include <signal.h>
 
+#include "../include/capture.h"
+#include "../include/columns.h"
+#include "../include/config.h"
+#include "../include/input.h"
+#include "../include/journal.h"
+#include "../include/latency.h"
+#include "../include/output.h"
+#include "../include/realtime.h"
+#include "../include/record.h"
+#include "../include/registry.h"
+#include "../include/schedule.h"
+#include "../include/server.h"
+#include "../include/stats.h"
 #include "../include/portsettings.h"
 #include "../include/serial.h"
+#include "../include/session.h"
+#include "../include/xmodem.h"
 
 #define CMD_LEN 80
 
+/**
+ * SCHED_FIFO priority used with --cpu, that of threaded interrupt handlers
+ */
+#define REALTIME_PRIORITY 50
+
+/**
+ * upper bound of --window, far beyond what any device buffers
+ */
+#define WINDOW_MAX 4096
+
 /**
  * length of array
  *
@@ -29,6 +55,57 @@
 
 #define UNUSED(x) (void)(x)
 
+/**
+ * long options without a short equivalent
+ */
+enum {
+    OPT_WINDOW = 0x100,
+    OPT_DELIMITER,
+    OPT_AUTOBAUD,
+    OPT_PROBE,
+    OPT_EXPECT,
+    OPT_FRAMING,
+    OPT_HEX,
+    OPT_BURST,
+    OPT_FORMAT,
+    OPT_ROTATE,
+    OPT_DAEMON,
+    OPT_CONNECT,
+    OPT_FLOW,
+    OPT_DRAIN,
+    OPT_STATS,
+    OPT_RECORD,
+    OPT_REPLAY,
+    OPT_SPEED,
+    OPT_LOWLATENCY,
+    OPT_FIRST,
+    OPT_GROUP,
+    OPT_JOBS,
+    OPT_GAP,
+    OPT_TOTAL,
+    OPT_SPIN,
+    OPT_CPU,
+    OPT_SCHEDULE,
+    OPT_ONCHANGE,
+    OPT_EXTRACT,
+    OPT_DUMP,
+    OPT_CAPTURE,
+    OPT_ROTATETIME,
+    OPT_COMPRESS,
+    OPT_URING,
+    OPT_JOURNAL,
+    OPT_CHECKPOINT,
+    OPT_RESUME,
+    OPT_SEND,
+    OPT_RECEIVE,
+    OPT_PROTOCOL,
+};
+
+/**
+ * callback invoked for every command read from an input file
+ */
+typedef int (*command_handler_t)(const char* cmd);
+
 extern char **environ;
 
 portsettings_t portsettings;
@@ -50,25 +127,203 @@ typedef struct file_t {
 struct settings {
     file_t device; /**< device config file */
     file_t input; /**< commands to be transmitted */
+    file_t manifest; /**< lines of "<device> <command>" */
+    file_t schedule; /**< lines of "<period> <command>" */
+    int onchange; /**< print scheduled responses only when they change */
+    char** devices; /**< device names when more than one -d is given */
+    size_t ndevices; /**< length of devices */
+    char** groups; /**< --group patterns, expanded into devices */
+    size_t ngroups; /**< length of groups */
+    char** expanded; /**< device names added by groups, owned */
+    size_t nexpanded; /**< length of expanded */
+    size_t jobs; /**< max ports open at once, 0 for all */
+    int uring; /**< serve ports and output file through io_uring */
     file_t output; /**< responses will be written to this file */
     int verbose; /**< increase verbosity */
     int quiet; /**< mute stdout */
+    unsigned int window; /**< max commands awaiting a response */
+    int adaptive; /**< learn response timing and shorten timeouts */
+    int autobaud; /**< probe for the fastest working baudrate */
+    int stats; /**< print timing statistics at exit, 2 for json */
+    int burst; /**< pack commands without response into few writes */
+    output_format_t format; /**< record format of output file */
+    off_t rotate; /**< max size of output file, 0 for no rotation */
+    char* serve; /**< socket to serve the ports on, --daemon */
+    char* connect; /**< socket of a running daemon, --connect */
+    char* record; /**< log all traffic of the port to this file */
+    char* replay; /**< act as the device recorded in this file */
+    char* extract; /**< columnar log of fields extracted from responses */
+    char* dump; /**< print this columnar log */
+    char* capture; /**< spool everything received to this file */
+    double rotatetime; /**< sec after which a capture segment is rotated */
+    int compress; /**< gzip rotated capture segments */
+    char* journal; /**< checkpoint journal of the input file */
+    double checkpoint; /**< sec between journal syncs, -1 for default */
+    int resume; /**< skip the commands acknowledged in the journal */
+    char** send; /**< files to transfer with --send */
+    size_t nsend; /**< length of send */
+    char* receive; /**< file or directory of a received transfer */
+    char* protocol; /**< xmodem, xmodem-1k, ymodem or ymodem-g */
+    double speed; /**< time scale of the replay */
+    int cpu; /**< cpu to pin to under SCHED_FIFO, -1 for none */
 } settings;
 
+/**
+ * command awaiting its response in pipelined (--window) mode
+ */
+typedef struct pending_t {
+    char* cmd; /**< transmitted command, owned copy */
+    unsigned int count; /**< lines still expected */
+    int started; /**< first line has been received */
+    double sent; /**< time the command was transmitted */
+    checkpoint_t at; /**< position in the input file */
+} pending_t;
+
+/**
+ * fifo of outstanding commands, responses are matched to the head
+ */
+struct pipeline {
+    pending_t* slots; /**< ring of settings.window entries */
+    unsigned int head; /**< oldest outstanding command */
+    unsigned int used; /**< number of outstanding commands */
+} pipeline;
+
+/**
+ * response file written by a background thread, used with --output
+ */
+output_t output = { .fd = -1 };
+
+/**
+ * log of all traffic on the port, used with --record
+ */
+record_t record = { .fd = -1 };
+
+/**
+ * fields extracted from responses by the rules of the device, used with
+ * --extract
+ */
+columns_t columns = { .fd = -1 };
+
+/**
+ * receive-only spool of the port, used with --capture
+ */
+capture_t capture_file = { .fd = -1 };
+
+/**
+ * progress through the input file, used with --journal
+ */
+journal_t journal = { .fd = -1 };
+
+/**
+ * position of the input command being handled, none for arguments
+ */
+checkpoint_t current;
+
+/**
+ * connection to a running daemon, used with --connect
+ */
+server_conn_t conn = { .fd = -1 };
+
+/**
+ * timing of every command, used with --stats
+ */
+stats_t stats;
+
+/**
+ * compiled index of the device config files, opened on first use
+ */
+registry_t registry;
+
+/**
+ * learned response timing of the device, used with --adaptive
+ */
+profile_t profile;
+
+/**
+ * entry of the last response that a learned gap ended, -1 for none
+ */
+long gapped = -1;
+
+/**
+ * periodic commands, used with --schedule
+ */
+schedule_t schedule;
+
+/**
+ * response lines held back by --on-change until compared with the previous
+ * response, every line is stored as its size_t length followed by its bytes
+ */
+struct capture {
+    char* data; /**< encoded lines */
+    size_t len; /**< bytes used in data */
+    size_t size; /**< allocated size of data */
+    int on; /**< print_response() appends here instead of printing */
+} capture;
+
+/**
+ * devices served by the multi-port event loop
+ */
+struct sessions {
+    session_t* list; /**< array of sessions */
+    size_t n; /**< length of list */
+} sessions;
+
 /**
  * arg options
  */
 struct option long_options[] = {
     {"device",    required_argument,  NULL,  'd'},
     {"input",     required_argument,  NULL,  'i'},
+    {"manifest",  required_argument,  NULL,  'm'},
     {"output",    required_argument,  NULL,  'o'},
     {"baudrate",  required_argument,  NULL,  'b'},
     {"port",      required_argument,  NULL,  'p'},
-    {"timeout",   required_argument,  NULL,  'w'},
+    {"timeout",   required_argument,  NULL,  't'},
     {"count",     required_argument,  NULL,  'n'},
+    {"adaptive",  no_argument,        NULL,  'a'},
     {"verbose",   no_argument,        NULL,  'v'},
     {"quiet",     no_argument,        NULL,  'q'},
     {"help",      no_argument,        NULL,  'h'},
+    {"window",    required_argument,  NULL,  OPT_WINDOW},
+    {"delimiter", required_argument,  NULL,  OPT_DELIMITER},
+    {"autobaud",  no_argument,        NULL,  OPT_AUTOBAUD},
+    {"probe",     required_argument,  NULL,  OPT_PROBE},
+    {"expect",    required_argument,  NULL,  OPT_EXPECT},
+    {"framing",   required_argument,  NULL,  OPT_FRAMING},
+    {"hex",       no_argument,        NULL,  OPT_HEX},
+    {"burst",     no_argument,        NULL,  OPT_BURST},
+    {"format",    required_argument,  NULL,  OPT_FORMAT},
+    {"rotate",    required_argument,  NULL,  OPT_ROTATE},
+    {"daemon",    required_argument,  NULL,  OPT_DAEMON},
+    {"connect",   required_argument,  NULL,  OPT_CONNECT},
+    {"flow",      required_argument,  NULL,  OPT_FLOW},
+    {"drain",     no_argument,        NULL,  OPT_DRAIN},
+    {"stats",     optional_argument,  NULL,  OPT_STATS},
+    {"record",    required_argument,  NULL,  OPT_RECORD},
+    {"replay",    required_argument,  NULL,  OPT_REPLAY},
+    {"speed",     required_argument,  NULL,  OPT_SPEED},
+    {"low-latency", no_argument,      NULL,  OPT_LOWLATENCY},
+    {"first",     required_argument,  NULL,  OPT_FIRST},
+    {"group",     required_argument,  NULL,  OPT_GROUP},
+    {"jobs",      required_argument,  NULL,  OPT_JOBS},
+    {"gap",       required_argument,  NULL,  OPT_GAP},
+    {"total",     required_argument,  NULL,  OPT_TOTAL},
+    {"spin",      required_argument,  NULL,  OPT_SPIN},
+    {"cpu",       required_argument,  NULL,  OPT_CPU},
+    {"schedule",  required_argument,  NULL,  OPT_SCHEDULE},
+    {"on-change", no_argument,        NULL,  OPT_ONCHANGE},
+    {"extract",   required_argument,  NULL,  OPT_EXTRACT},
+    {"dump",      required_argument,  NULL,  OPT_DUMP},
+    {"capture",   required_argument,  NULL,  OPT_CAPTURE},
+    {"rotate-time", required_argument, NULL, OPT_ROTATETIME},
+    {"compress",  no_argument,        NULL,  OPT_COMPRESS},
+    {"uring",     no_argument,        NULL,  OPT_URING},
+    {"journal",   required_argument,  NULL,  OPT_JOURNAL},
+    {"checkpoint", required_argument, NULL,  OPT_CHECKPOINT},
+    {"resume",    no_argument,        NULL,  OPT_RESUME},
+    {"send",      required_argument,  NULL,  OPT_SEND},
+    {"receive",   required_argument,  NULL,  OPT_RECEIVE},
+    {"protocol",  required_argument,  NULL,  OPT_PROTOCOL},
     {NULL,        0,                  NULL,  0}
 };
 
@@ -77,6 +332,14 @@ struct option long_options[] = {
 //                            function prototypes                             //
 ////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * get the responses printed so far to stdout and the output file on disk,
+ * called before a checkpoint is written
+ *
+ * @return status 0 for succes, -1 for failure
+ */
+static int sync_responses(void);
+
 /**
  * print the help section to stdout
  */
@@ -88,22 +351,63 @@ static void print_help(void);
 static void print_settings(void);
 
 /**
- * find file in various locations (~/.config/trx, ~/.trx, /etc/trx)
+ * apply a single device setting, options given on the command line are
+ * left untouched, extract rules go to the columnar log
+ *
+ * @param[in,out] ps settings to update
+ * @param[in] key setting name
+ * @param[in] value setting value
+ * @return status 0 for succes, -1 for failure
+ */
+static int apply_setting(portsettings_t* ps, const char* key,
+        const char* value);
+
+/**
+ * apply the settings of a device from the registry or a config file
  *
- * @param[in,out] file name of file or absolute path
- * @param[in] ext extension
- * @return pointer to allocated string with absolute path or NULL if failed
+ * @param[out] ps writes settings in this struct
+ * @param[in] name device name, or path of a config file
+ * @return status 0 for succes, -1 for failure
  */
-static char* find_file(const char* file, const char* ext);
+static int load_device(portsettings_t* ps, const char* name);
 
 /**
- * parse a device config file and set properties
+ * read commands from file, skipping comments and empty lines
  *
- * @param[out] portsettings writes settings in this struct
- * @param[in] file reads from this file
+ * regular files are memory-mapped, stdin ("-") and pipes are streamed so
+ * every command is handled as soon as it arrives
+ *
+ * @param[in,out] file input file with resolved path
+ * @param[in] handler called for each command
  * @return status 0 for succes, -1 for failure
  */
-static int parse_config(file_t *file);
+static int read_input(file_t* file, command_handler_t handler);
+
+/**
+ * monotonic clock
+ *
+ * @return sec since an arbitrary point in time
+ */
+static double now(void);
+
+/**
+ * print a received line to stdout or write it to the output file
+ *
+ * @param[in] cmd command the line responds to
+ * @param[in] line received line, may contain null characters
+ * @param[in] len length of line
+ */
+static void print_response(const char* cmd, const char* line, size_t len);
+
+/**
+ * write payload as text or hex, followed by newline
+ *
+ * @param[in] ps settings of the port the payload was received on
+ * @param[in] line received line or frame
+ * @param[in] len length of line
+ */
+static void print_payload(const portsettings_t* ps, const char* line,
+        size_t len);
 
 /**
  * controll transmit and receive
@@ -114,6 +418,164 @@ static int parse_config(file_t *file);
  */
 static int run(const char* cmd);
 
+/**
+ * run a scheduled command, held back with --on-change while its response
+ * equals the previous one
+ *
+ * @param[in,out] task released task
+ * @return status 0 for succes, -1 for failure
+ */
+static int poll_task(task_t* task);
+
+/**
+ * run the schedule until interrupted
+ */
+static void run_schedule(void);
+
+/**
+ * transmit the arg commands and capture the port until interrupted
+ *
+ * @param[in] argc argument count
+ * @param[in] argv arguments, commands from optind
+ */
+static void run_capture(int argc, char** argv);
+
+/**
+ * run the arg commands, then transfer the --send or --receive files
+ *
+ * @param[in] argc argument count
+ * @param[in] argv arguments, commands from optind
+ */
+static void run_transfer(int argc, char** argv);
+
+/**
+ * transmit command without waiting for its response
+ *
+ * blocks only while the window of outstanding commands is full
+ *
+ * @param[in] cmd command message string
+ * @return status 0 for succes, -1 for failure
+ */
+static int submit(const char* cmd);
+
+/**
+ * receive one line and attribute it to the oldest outstanding command
+ *
+ * a timeout abandons the oldest outstanding command
+ *
+ * @return status 0 for succes, -1 for failure
+ */
+static int collect(void);
+
+/**
+ * wait for the responses of all outstanding commands
+ *
+ * @return status 0 for succes, -1 for failure
+ */
+static int flush(void);
+
+/**
+ * create a session for a device config file
+ *
+ * @param[in] name device config name as passed to -d or used in a manifest
+ * @return pointer to the new session or NULL if failed
+ */
+static session_t* add_session(const char* name);
+
+/**
+ * add a device name to the devices given with -d
+ *
+ * @param[in] name device name or config file, copied
+ * @return status 0 for succes, -1 for failure
+ */
+static int add_device(const char* name);
+
+/**
+ * registry_each_t wrapper of add_device()
+ */
+static int add_match(const char* name, void* arg);
+
+/**
+ * add every device that matches a --group pattern, first by name in the
+ * registry and otherwise as a glob of config files
+ *
+ * @param[in] pattern shell wildcard pattern
+ * @return status 0 for succes, -1 for failure or no match
+ */
+static int expand_group(const char* pattern);
+
+/**
+ * print per device failures and timeouts and a summary of a group run to
+ * stderr
+ *
+ * @param[in] elapsed sec the run took
+ */
+static void print_group(double elapsed);
+
+/**
+ * queue command on every device given with -d
+ *
+ * @param[in] cmd command message string
+ * @return status 0 for succes, -1 for failure
+ */
+static int queue_all(const char* cmd);
+
+/**
+ * queue a "<device> <command>" manifest line on the matching session
+ *
+ * @param[in] line manifest line
+ * @return status 0 for succes, -1 for failure
+ */
+static int queue_manifest(const char* line);
+
+/**
+ * print a response line tagged with its device name
+ */
+static void print_session(const session_t* session, const char* cmd,
+        const char* line, size_t len);
+
+/**
+ * serve several devices from one event loop, does not return
+ *
+ * @param[in] argc argument count
+ * @param[in] argv argument vector, commands start at optind
+ */
+static void run_sessions(int argc, char** argv);
+
+/**
+ * keep the ports open and serve the commands of clients, does not return
+ */
+static void serve(void);
+
+/**
+ * send command to the daemon and print its response
+ *
+ * @param[in] cmd command
+ * @return status 0 for succes, -1 for failure
+ */
+static int request(const char* cmd);
+
+/**
+ * hand all commands to a running daemon instead of opening the port,
+ * does not return
+ *
+ * @param[in] argc argument count
+ * @param[in] argv argument vector, commands start at optind
+ */
+static void run_client(int argc, char** argv);
+
+/**
+ * signal handler, ends the run at the next opportunity
+ *
+ * @param[in] signum signal number
+ */
+static void term(int signum);
+
+/**
+ * restore port and free all resources
+ */
+static void cleanup(void);
+
 static void die(void);
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -125,29 +587,158 @@ void print_help()
     const char* help[] = {
         "usage: trx [options] [command] [command] [...]",
         "",
-        "  -b  --baudrate  serial port baudrate setting (must be valid)",
-        "                  eg 9600, 19200, ...",
+        "  -b  --baudrate  serial port baudrate setting",
+        "                  eg 9600, 115200, 3000000 or any non-standard rate",
+        "",
+        "      --autobaud  use the fastest baudrate at which the device",
+        "                  answers the probe command",
+        "",
+        "      --probe     command transmitted by --autobaud",
+        "",
+        "      --expect    valid probe response starts with this text",
+        "                  default: any printable line",
         "",
         "  -p  --port      serial port device file",
         "",
-        "  -t  --timeout   receiver will wait <timeout> msec for new input",
+        "  -t  --timeout   receiver will wait <timeout> sec for new input",
         "                  unless count is fulfilled",
         "",
+        "      --first     sec from command to the first byte (timeout)",
+        "",
+        "      --gap       sec of silence between bytes that ends the",
+        "                  response (timeout)",
+        "",
+        "      --total     sec from command to the end of the response",
+        "                  (no limit)",
+        "",
         "  -n  --count     max number of lines to be read",
+        "                  0 to not wait for a response",
+        "",
+        "      --delimiter end of received lines: lf (default), cr, crlf,",
+        "                  a single character or a byte as 0x..",
+        "",
+        "      --framing   line (default), cobs, slip or length",
+        "                  binary framings imply --hex",
+        "",
+        "      --hex       commands and responses are hex encoded",
+        "",
+        "      --flow      flow control: none (default), rtscts or xonxoff",
+        "",
+        "      --drain     wait until every command has left the port",
+        "                  (tcdrain), eg for RS485 transceivers",
         "",
         "  -d  --device    device config file",
         "                  search in $XDG_CONFIG_HOME when no abs path given",
+        "                  repeat to send all commands to several devices",
+        "",
+        "  -m  --manifest  file of \"<device> <command>\" lines",
+        "                  all devices are served concurrently",
         "",
         "  -i  --input     contents of this file will be transmitted per line",
         "                  as if they are given as separate arguments",
+        "                  \"-\" streams commands from stdin, which is the",
+        "                  default when stdin is not a terminal",
         "",
         "  -o  --output    response is written to file instead of stdout",
+        "                  by a background thread",
+        "",
+        "      --format    output file format: raw (default), csv or json",
+        "",
+        "      --rotate    rename output file to the next free <output>.N once",
+        "                  it exceeds this size, eg 100M",
+        "",
+        "  -a  --adaptive  learn response timing per command and end responses",
+        "                  as soon as the device goes quiet (timeout is the max)",
         "",
         "  -v  --verbose   verbose output",
         "",
         "  -q  --quiet     suppress writing response to stdout",
         "                  does not mute stderr",
         "",
+        "      --journal   keep the position of the last answered command of",
+        "                  the input file in <file>",
+        "",
+        "      --checkpoint  sync the journal every <period> (default 1s),",
+        "                  0 after every command",
+        "",
+        "      --resume    skip the commands the journal holds as answered",
+        "",
+        "      --burst     pack commands with count 0 into as few writes",
+        "                  as possible",
+        "",
+        "      --window    keep up to <n> commands in flight (requires -n)",
+        "                  responses are matched to commands in order",
+        "",
+        "      --stats     print p50/p90/p99/max of transmit time, first byte",
+        "                  latency and response time per command and the",
+        "                  throughput to stderr at exit, --stats=json for json",
+        "",
+        "      --group     send all commands to every device whose name",
+        "                  matches <pattern>, or to every config file that",
+        "                  matches it as a glob, eg --group 'psu-*'",
+        "",
+        "      --jobs      max number of ports open at once with several",
+        "                  devices (default all)",
+        "",
+        "      --uring     serve several devices and the output file through",
+        "                  io_uring, batching reads, writes and timeouts into",
+        "                  few system calls; epoll and write() when the",
+        "                  kernel does not provide it",
+        "",
+        "      --daemon    keep the port(s) open and serve commands of",
+        "                  clients on unix socket <path>",
+        "",
+        "      --connect   send commands to the daemon on unix socket <path>",
+        "                  -d selects one of its devices",
+        "",
+        "      --record    append every transmitted and received chunk with",
+        "                  its timestamp to binary log <file>",
+        "",
+        "      --replay    act as the device recorded in <file> on a pty,",
+        "                  of which the path is printed",
+        "",
+        "      --speed     replay <n> times as fast, 0 without delays",
+        "",
+        "      --extract   store the fields of responses that match the",
+        "                  extract rules of the device in columnar log <file>",
+        "",
+        "      --dump      print columnar log <file> as csv, or json with",
+        "                  --format json",
+        "",
+        "      --capture   only receive, spool everything to <file> until",
+        "                  interrupted, commands are transmitted first",
+        "                  --rotate applies to its segments",
+        "",
+        "      --rotate-time  rotate the capture file every <period>,",
+        "                  eg 10min or 1h",
+        "",
+        "      --compress  gzip rotated capture segments in the background",
+        "",
+        "      --send      transfer <file> to the device, repeat for a",
+        "                  batch, commands are run first",
+        "",
+        "      --receive   receive a transfer into <dir>, or <file> with",
+        "                  xmodem",
+        "",
+        "      --protocol  xmodem, xmodem-1k, ymodem (default) or ymodem-g",
+        "                  which streams blocks without waiting for ACKs",
+        "",
+        "      --low-latency  ask the driver for ASYNC_LOW_LATENCY and report",
+        "                  whether it took effect",
+        "",
+        "      --spin      busy-poll the port for <usec> before sleeping",
+        "                  while waiting for a response",
+        "",
+        "      --cpu       pin to cpu <n> and run under SCHED_FIFO",
+        "",
+        "      --schedule  poll the commands of a file of \"<period> <command>\"",
+        "                  lines, eg \"10ms status\", \"1s temp\" or \"1min id\",",
+        "                  until interrupted, then report jitter and missed",
+        "                  deadlines to stderr",
+        "",
+        "      --on-change print a scheduled response only when it differs",
+        "                  from the previous response to that command",
+        "",
         "  -h  --help      this menu",
         "",
         "examples:",
@@ -167,171 +758,690 @@ void print_settings()
         printf("%-12s = %s\n", "output", settings.output.name);
     if (settings.device.name)
         printf("%-12s = %s\n", "device", settings.device.name);
+    for (size_t i = 0; i < settings.ndevices; i++)
+        printf("%-12s = %s\n", "device", settings.devices[i]);
+    if (settings.manifest.name)
+        printf("%-12s = %s\n", "manifest", settings.manifest.name);
+    if (settings.journal)
+        printf("%-12s = %s\n", "journal", settings.journal);
+    for (size_t i = 0; i < settings.nsend; i++)
+        printf("%-12s = %s\n", "send", settings.send[i]);
+    if (settings.receive)
+        printf("%-12s = %s\n", "receive", settings.receive);
+    if (settings.send || settings.receive)
+        printf("%-12s = %s\n", "protocol", settings.protocol);
     if (1) {
         printf("%-12s = %i\n", "verbose", settings.verbose);
         printf("%-12s = %i\n", "quiet", settings.quiet);
+        printf("%-12s = %u\n", "window", settings.window);
+        printf("%-12s = %i\n", "adaptive", settings.adaptive);
+        printf("%-12s = %i\n", "burst", settings.burst);
     }
 }
 
-char* find_file(const char* file, const char* ext)
+int sync_responses(void)
 {
-    char* path = NULL;
-    char buf[CMD_LEN+1];
-    struct stat file_stat;
-
-    if (*file != '~') {
-        strcpy(buf, file);
-
-    /* expand tilde */
-    } else {
-        strcpy(buf, getenv("HOME"));
-        strcat(buf, "/");
-        strcat(buf, file+1);
-    }
-
-    /* absolute path */
-    if ((strncmp(buf, "./", 2) != 0 || *buf != '/') && access(buf, F_OK) == -1) {
-
-        /* ~/.config/trx/{}.ext */
-        strcpy(buf, getenv("XDG_CONFIG_HOME"));
-        strcat(buf, "/trx/");
-        strcat(buf, file);
-        strcat(buf, ext);
-        if (access(buf, F_OK) == -1) {
-
-            /* ~/.trx/{}.ext */
-            strcpy(buf, getenv("HOME"));
-            strcat(buf, "/.trx/");
-            strcat(buf, file);
-            strcat(buf, ext);
-            if (access(buf, F_OK) == -1) {
-
-                /* /etc/trx/{}.ext */
-                strcpy(buf, "/etc");
-                strcat(buf, "/trx/");
-                strcat(buf, file);
-                strcat(buf, ext);
-
-                if (access(buf, F_OK) == -1) {
-                    return NULL;
-                }
-            }
-        }
-    }
-
-    path = malloc(strlen(buf)+1);
-    strcpy(path, buf);
-
-    stat(path, &file_stat);
-
-    /* check if file is regular file */
-    if (!S_ISREG(file_stat.st_mode)) {
-        fprintf(stderr, "\"%s\" is not a regular file\n", path);
-        return NULL;
-
-    /* check if file is empty */
-    } else if (!file_stat.st_size) {
-        fprintf(stderr, "file \"%s\" is empty\n", path);
-        return NULL;
+    if (fflush(stdout) == EOF) return -1;
+    if (output.path && output_sync(&output) == -1) return -1;
+    return 0;
+}
 
-    } else {
-        return path;
+int apply_setting(portsettings_t* ps, const char* key, const char* value)
+{
+    if (settings.extract && strcmp(key, "extract") == 0) {
+        return columns_add_rule(&columns, value);
     }
+    return config_apply(ps, key, value);
 }
 
-int parse_config(file_t *file)
+int load_device(portsettings_t* ps, const char* name)
 {
-    char line[CMD_LEN+2];
+    return config_load(&registry, ps, name, apply_setting);
+}
 
-    file->stream = fopen(file->path, "r");
+int read_input(file_t* file, command_handler_t handler)
+{
+    input_t input;
+    const char* line;
+    uint64_t n = 0;
+    int status = 0;
 
-    if (!file->stream) {
-        fprintf(stderr, "%s \"%s\"\n", strerror(errno), settings.device.path);
+    if (input_open(&input, file->path) == -1) {
+        fprintf(stderr, "%s \"%s\"\n", strerror(errno), file->name);
         return -1;
     }
 
-    while (fgets(line, CMD_LEN+1, file->stream)) {
-
-        /* validate max line length */
-        if (strlen(line) >= CMD_LEN) {
-            fprintf(stderr,
-                    "maximum line length exceeded: %i characters\n",
-                    CMD_LEN);
-            goto fail;
+    if (settings.verbose) printf("using input file \'%s\"\n", file->path);
+
+    /* the commands up to the checkpoint have to be those that were sent */
+    if (journal.fd != -1 && settings.resume) {
+        ssize_t skipped = input_seek(&input, journal.acked.offset, &line);
+        if (skipped == -1 || (uint64_t)skipped != journal.acked.n
+                || (line && journal_hash(line) != journal.acked.hash)) {
+            fprintf(stderr, "\"%s\" does not match the checkpoint in %s\n",
+                    file->name, settings.journal);
+            input_close(&input);
+            return -1;
         }
+        n = journal.acked.n;
+        if (settings.verbose) {
+            printf("%-12s = command %llu, byte %lld\n", "resume",
+                    (unsigned long long)n + 1,
+                    (long long)journal.acked.offset);
+        }
+    }
 
-        /* skip comments */
-        if (*line == '#') continue;
+    while ((line = input_next(&input))) {
 
-        char *p;
+        if (killed) {
+            input_close(&input);
+            die();
+        }
 
-        p = strtok(line, "= \r\n");
+        if (journal.fd != -1) {
+            current.offset = input_offset(&input);
+            current.n = ++n;
+        }
 
-        if (!portsettings.port && (strcmp(p, "port") == 0)) {
-            p = strtok(NULL, "= \r\n");
-            if (portsettings_set_port(&portsettings, p) == -1) {
-                fprintf(stderr, "invalid serial port: %s\n", p);
-                goto fail;
-            }
+        if (handler(line) == -1) {
+            status = -1;
+            break;
+        }
+    }
 
-        } else if (!portsettings.baudrate && (strcmp(p, "baudrate") == 0)) {
-            p = strtok(NULL, "= \r\n");
-            if (portsettings_set_baudrate(&portsettings, p) == -1) {
-                fprintf(stderr, "invalid baudrate: %s\n", p);
-                goto fail;
-            }
+    current.n = 0;
+    input_close(&input);
+    return status;
+}
 
-        } else if (!portsettings.timeout && (strcmp(p, "timeout") == 0)) {
-            p = strtok(NULL, "= \r\n");
-            if (portsettings_set_timeout(&portsettings, p) == -1) {
-                fprintf(stderr, "invalid timeout: %s\n", p);
-                goto fail;
-            }
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
 
-        } else if (portsettings.count == UINT_MAX && (strcmp(p, "count") == 0)) {
-            p = strtok(NULL, "= \r\n");
-            if (portsettings_set_count(&portsettings, p) == -1) {
-                fprintf(stderr, "invalid count: %s\n", p);
-                goto fail;
-            }
+void print_payload(const portsettings_t* ps, const char* line, size_t len)
+{
+    if (ps->hex) {
+        for (size_t i = 0; i < len; i++) {
+            printf("%02x", (unsigned char)line[i]);
         }
+    } else {
+        fwrite(line, 1, len, stdout);
     }
-
-    fclose(file->stream);
-    return 0;
-fail:
-    fclose(file->stream);
-    fprintf(stderr, "error parsing config file: %s\n", file->name);
-    return -1;
+    putchar('\n');
 }
 
-int run(const char* cmd)
+void print_response(const char* cmd, const char* line, size_t len)
 {
-    serial_tx(&portsettings, cmd);
-
-    char buf[81];
+    if (capture.on) {
+        size_t need = capture.len + sizeof(size_t) + len;
+        if (need > capture.size) {
+            size_t size = capture.size ? capture.size : 256;
+            while (size < need) size *= 2;
+            char* data = realloc(capture.data, size);
+            if (!data) return;
+            capture.data = data;
+            capture.size = size;
+        }
+        memcpy(capture.data + capture.len, &len, sizeof(size_t));
+        memcpy(capture.data + capture.len + sizeof(size_t), line, len);
+        capture.len = need;
+        return;
+    }
+    if (columns.fd != -1) columns_write(&columns, cmd, line, len);
+    if (output.path) {
+        output_write(&output, NULL, cmd, line, len, portsettings.hex);
+        return;
+    }
+    if (settings.quiet) return;
+    if (settings.verbose) printf("%-12s = ", "response");
+    print_payload(&portsettings, line, len);
+}
+
+int run(const char* cmd)
+{
+    if (settings.window > 1) return submit(cmd);
+
+    if (settings.verbose) printf("%-12s = %s\n", "command", cmd);
+
+    /* fire-and-forget, leave it to the next write */
+    if (settings.burst && !portsettings.count) {
+        if (serial_queue(&portsettings, cmd) == -1) return -1;
+        if (portsettings.txlen) journal_queue(&journal, &current, cmd);
+        else journal_ack(&journal, &current, cmd);
+        return 0;
+    }
+
+    /* lines still coming belong to the previous response, which its learned
+     * gap ended too early */
+    if (gapped != -1 && serial_pending(&portsettings)) {
+        latency_reset_gap(&profile, &profile.entries[gapped]);
+    }
+    gapped = -1;
+
+    latency_t* latency = settings.adaptive ? profile_get(&profile, cmd) : NULL;
+    sample_t sample = { .first = -1, .total = -1 };
+    size_t rxbytes = portsettings.rxbytes;
+    char* line;
+    size_t len;
     unsigned int n = 0;
+    int answered = 1;
+
+    /* learned deadlines, the configured limits without history */
+    timing_t configured = portsettings_timing(&portsettings);
+    timing_t timing = configured;
+    if (latency) {
+        timing.first = latency_first(latency, configured.first);
+        timing.gap = latency_gap(latency, configured.gap);
+
+        /* an explicit gap is never undercut */
+        if (portsettings.gap) timing.gap = configured.gap;
+    }
 
-    while (portsettings.count == UINT_MAX || n++ < portsettings.count) {
+    double start = now();
+    serial_tx(&portsettings, cmd);
+    double sent = now();
+    double last = sent;
+    journal_flushed(&journal);
+
+    while (portsettings.count == UINT_MAX || n < portsettings.count) {
 
         if (killed) die();
 
-        if (serial_rx(&portsettings, buf, 80) != -1) {
-            if (!settings.quiet) {
-                if (settings.verbose) printf("%-12s = ", "response");
-                if (*buf) {
-                    printf("%s\n", buf);
+        if (serial_rx(&portsettings, &line, &len, &timing) == -1) {
+            answered = 0;
+            break;
+        }
+
+        /* timeout */
+        if (!line) {
+            /* learned first line deadline was too short, relearn */
+            if (latency && !n && timing.first < configured.first) {
+                latency_reset(&profile, latency);
+            }
+
+            /* a learned gap ends a response of unknown length by design,
+             * one that falls short of its count was cut off */
+            if (latency && n && timing.gap < configured.gap) {
+                if (portsettings.count != UINT_MAX) {
+                    latency_reset_gap(&profile, latency);
                 } else {
-                    if (settings.verbose) printf("<timeout>\n");
-                    break;
+                    gapped = latency - profile.entries;
+                }
+            }
+            if (settings.verbose && !settings.quiet) printf("<timeout>\n");
+
+            /* an unlimited count always ends by timeout */
+            sample.timeout = !n || portsettings.count != UINT_MAX;
+            answered = !sample.timeout;
+            break;
+        }
+
+        double t = now();
+        if (latency) {
+            if (n) latency_add_gap(&profile, latency, t - last);
+            else latency_add_first(&profile, latency, t - sent);
+        }
+        last = t;
+        n++;
+
+        print_response(cmd, line, len);
+    }
+
+    /* an interrupted command is only left unacknowledged */
+    if (answered) journal_ack(&journal, &current, cmd);
+    else if (!killed) journal_miss(&journal, &current);
+
+    if (settings.stats) {
+        sample.tx = sent - start;
+        if (portsettings.rxfirst) sample.first = portsettings.rxfirst - sent;
+        if (n) sample.total = last - start;
+        sample.bytes = portsettings.rxbytes - rxbytes;
+        sample.lines = n;
+        stats_add(&stats, cmd, &sample, start, now());
+    }
+    return 0;
+}
+
+int poll_task(task_t* task)
+{
+    schedule_start(task);
+    if (!settings.onchange) return run(task->cmd);
+
+    capture.len = 0;
+    capture.on = 1;
+    int status = run(task->cmd);
+    capture.on = 0;
+
+    if (!schedule_changed(task, capture.data, capture.len)) return status;
+    for (size_t i = 0; i < capture.len;) {
+        size_t len;
+        memcpy(&len, capture.data + i, sizeof(size_t));
+        i += sizeof(size_t);
+        print_response(task->cmd, capture.data + i, len);
+        i += len;
+    }
+    return status;
+}
+
+void run_schedule(void)
+{
+    while (!killed) {
+        task_t* task = schedule_next(&schedule);
+        if (task && !killed) poll_task(task);
+    }
+    die();
+}
+
+void run_capture(int argc, char** argv)
+{
+    struct sigaction action;
+
+    if (capture_open(&capture_file, settings.capture, settings.rotate,
+                settings.rotatetime, settings.compress) == -1) {
+        cleanup();
+        exit(EXIT_FAILURE);
+    }
+    for (int i = optind; i < argc; i++) {
+        if (settings.verbose) printf("%-12s = %s\n", "command", argv[i]);
+        serial_tx(&portsettings, argv[i]);
+    }
+
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = term;
+    sigaction(SIGTERM, &action, NULL);
+
+    if (capture_run(&capture_file, portsettings.fd, &killed) == -1) {
+        cleanup();
+        exit(EXIT_FAILURE);
+    }
+    die();
+}
+
+void run_transfer(int argc, char** argv)
+{
+    struct sigaction action;
+    xmodem_protocol_t protocol;
+    int status;
+
+    xmodem_parse_protocol(&protocol, settings.protocol);
+
+    for (int i = optind; i < argc; i++) {
+        if (killed) die();
+        run(argv[i]);
+    }
+
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = term;
+    sigaction(SIGTERM, &action, NULL);
+
+    if (settings.send) {
+        status = xmodem_send(&portsettings, protocol, settings.send,
+                settings.nsend, &killed);
+    } else {
+        status = xmodem_receive(&portsettings, protocol, settings.receive,
+                &killed);
+    }
+    if (status == -1) {
+        cleanup();
+        exit(EXIT_FAILURE);
+    }
+    die();
+}
+
+int submit(const char* cmd)
+{
+    while (pipeline.used == settings.window) {
+        if (collect() == -1) return -1;
+    }
+
+    pending_t* p = &pipeline.slots[
+        (pipeline.head + pipeline.used) % settings.window];
+
+    p->cmd = malloc(strlen(cmd)+1);
+    if (!p->cmd) {
+        fprintf(stderr, "error allocating pending command\n");
+        return -1;
+    }
+    strcpy(p->cmd, cmd);
+    p->count = portsettings.count;
+    p->started = 0;
+    p->at = current;
+    pipeline.used++;
+
+    /* the receive state still belongs to the head of the pipeline */
+    double rxfirst = portsettings.rxfirst;
+    if (serial_tx(&portsettings, cmd) == -1) return -1;
+    p->sent = portsettings.txsent;
+    if (pipeline.used > 1) portsettings.rxfirst = rxfirst;
+
+    /* nothing to wait for */
+    while (pipeline.used && !pipeline.slots[pipeline.head].count) {
+        if (collect() == -1) return -1;
+    }
+    return 0;
+}
+
+int collect(void)
+{
+    char* line = NULL;
+    size_t len = 0;
+    pending_t* p = &pipeline.slots[pipeline.head];
+
+    if (killed) die();
+
+    timing_t timing = portsettings_timing(&portsettings);
+
+    /* time the head from its own transmission, not the newest one */
+    portsettings.txsent = p->sent;
+    if (p->count && serial_rx(&portsettings, &line, &len, &timing) == -1) {
+        return -1;
+    }
+
+    if (settings.verbose && !p->started) {
+        printf("%-12s = %s\n", "command", p->cmd);
+    }
+    p->started = 1;
+
+    /* response complete or timed out, retire the command */
+    if (!p->count || !line) {
+        if (p->count && settings.verbose && !settings.quiet) {
+            printf("<timeout>\n");
+        }
+        if (p->count && !killed) journal_miss(&journal, &p->at);
+        else journal_ack(&journal, &p->at, p->cmd);
+        free(p->cmd);
+        p->cmd = NULL;
+        portsettings.rxfirst = 0;
+        pipeline.head = (pipeline.head + 1) % settings.window;
+        pipeline.used--;
+        return 0;
+    }
+
+    print_response(p->cmd, line, len);
+
+    /* retire immediately so the window slot can be reused */
+    if (!--p->count) return collect();
+    return 0;
+}
+
+int flush(void)
+{
+    while (pipeline.used) {
+        if (collect() == -1) return -1;
+    }
+    return 0;
+}
+
+int add_device(const char* name)
+{
+    char** devices = realloc(settings.devices,
+            (settings.ndevices+1) * sizeof(char*));
+    char** expanded = realloc(settings.expanded,
+            (settings.nexpanded+1) * sizeof(char*));
+    char* copy = malloc(strlen(name)+1);
+
+    if (devices) settings.devices = devices;
+    if (expanded) settings.expanded = expanded;
+    if (!devices || !expanded || !copy) {
+        free(copy);
+        return -1;
+    }
+    strcpy(copy, name);
+    settings.expanded[settings.nexpanded++] = copy;
+    settings.devices[settings.ndevices++] = copy;
+    return 0;
+}
+
+int add_match(const char* name, void* arg)
+{
+    UNUSED(arg);
+    return add_device(name);
+}
+
+int expand_group(const char* pattern)
+{
+    int n = 0;
+
+    /* device names first, a pattern with a path is only a file glob */
+    if (!strchr(pattern, '/')) {
+        if (!registry.map && registry_open(&registry) == -1) return -1;
+        if ((n = registry_match(&registry, pattern, add_match, NULL)) == -1) {
+            return -1;
+        }
+    }
+
+    if (!n) {
+        glob_t g;
+        if (glob(pattern, GLOB_TILDE, NULL, &g) == 0) {
+            for (size_t i = 0; i < g.gl_pathc; i++) {
+                if (add_device(g.gl_pathv[i]) == -1) {
+                    globfree(&g);
+                    return -1;
                 }
+                n++;
             }
+            globfree(&g);
+        }
+    }
+
+    if (!n) {
+        fprintf(stderr, "no device matches \"%s\"\n", pattern);
+        return -1;
+    }
+    return 0;
+}
+
+void print_group(double elapsed)
+{
+    size_t ok = 0, late = 0, failed = 0;
+
+    for (size_t i = 0; i < sessions.n; i++) {
+        const session_t* s = &sessions.list[i];
+        if (s->failed) {
+            fprintf(stderr, "%s: failed\n", s->name);
+            failed++;
+        } else if (s->timeouts) {
+            fprintf(stderr, "%s: %zu of %zu commands timed out\n", s->name,
+                    s->timeouts, s->done);
+            late++;
+        } else {
+            ok++;
         }
-        else break;
+    }
+    fprintf(stderr, "group: %zu devices, %zu ok, %zu with timeouts, "
+            "%zu failed in %.3f s\n", sessions.n, ok, late, failed, elapsed);
+}
+
+session_t* add_session(const char* name)
+{
+    session_t* list;
+    session_t* s;
+
+    list = realloc(sessions.list, (sessions.n+1) * sizeof(session_t));
+    if (!list) return NULL;
+    sessions.list = list;
+    s = &sessions.list[sessions.n++];
+
+    /* options given on the command line override every config file */
+    session_init(s, name, &portsettings);
+
+    /* one broken config does not hold up the rest of a group */
+    if (load_device(&s->portsettings, name) == -1) {
+        if (!settings.ngroups) return NULL;
+        s->failed = 1;
+        return s;
+    }
+
+    if (settings.verbose) {
+        printf("%-12s = %s\n", "session", name);
+        portsettings_print(&s->portsettings);
+    }
+    return s;
+}
+
+int queue_all(const char* cmd)
+{
+    for (size_t i = 0; i < settings.ndevices; i++) {
+        if (session_queue(&sessions.list[i], cmd, NULL) == -1) return -1;
     }
     return 0;
 }
 
+int queue_manifest(const char* line)
+{
+    char name[CMD_LEN+1];
+    const char* cmd;
+    size_t len = strcspn(line, " \t");
+    session_t* s = NULL;
+
+    if (!line[len]) {
+        fprintf(stderr, "invalid manifest line: %s\n", line);
+        return -1;
+    }
+
+    if (len > CMD_LEN) {
+        fprintf(stderr, "device name too long: %.*s\n", (int)len, line);
+        return -1;
+    }
+    memcpy(name, line, len);
+    name[len] = '\0';
+    cmd = line + len + strspn(line + len, " \t");
+
+    for (size_t i = 0; i < sessions.n; i++) {
+        if (strcmp(sessions.list[i].name, name) == 0) s = &sessions.list[i];
+    }
+    if (!s && !(s = add_session(name))) return -1;
+
+    return session_queue(s, cmd, NULL);
+}
+
+void print_session(const session_t* session, const char* cmd,
+        const char* line, size_t len)
+{
+    if (output.path && line) {
+        output_write(&output, session->name, cmd, line, len,
+                session->portsettings.hex);
+        return;
+    }
+    if (settings.quiet) return;
+
+    if (!line) {
+        if (settings.verbose && session->received < session->portsettings.count) {
+            printf("%s: <timeout> %s\n", session->name, cmd);
+        }
+        return;
+    }
+    printf("%s: ", session->name);
+    print_payload(&session->portsettings, line, len);
+}
+
+void run_sessions(int argc, char** argv)
+{
+    if (portsettings.port) {
+        fprintf(stderr, "--port can not be combined with several devices\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* every -d gets every command */
+    for (size_t i = 0; i < settings.ndevices; i++) {
+        if (!add_session(settings.devices[i])) exit(EXIT_FAILURE);
+    }
+    for (int i = optind; i < argc; i++) {
+        if (queue_all(argv[i]) == -1) exit(EXIT_FAILURE);
+    }
+    if (settings.input.path) {
+        if (read_input(&settings.input, queue_all) == -1) exit(EXIT_FAILURE);
+    }
+
+    /* a manifest adds devices as it names them */
+    if (settings.manifest.path) {
+        if (read_input(&settings.manifest, queue_manifest) == -1) {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    double start = now();
+    int status = session_run(sessions.list, sessions.n, settings.jobs,
+            settings.uring, print_session, &killed);
+    if (settings.ngroups || settings.verbose) print_group(now() - start);
+    for (size_t i = 0; i < sessions.n; i++) session_die(&sessions.list[i]);
+    free(sessions.list);
+    sessions.list = NULL;
+    sessions.n = 0;
+    if (status == -1) exit(EXIT_FAILURE);
+    die();
+}
+
+void serve(void)
+{
+    if (settings.ndevices) {
+        if (portsettings.port) {
+            fprintf(stderr, "--port can not be combined with several devices\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < settings.ndevices; i++) {
+            if (!add_session(settings.devices[i])) exit(EXIT_FAILURE);
+        }
+
+    /* a single device is already configured */
+    } else if (settings.device.name || portsettings.port) {
+        sessions.list = malloc(sizeof(session_t));
+        if (!sessions.list) exit(EXIT_FAILURE);
+        sessions.n = 1;
+        session_init(&sessions.list[0], settings.device.name
+                ? settings.device.name : portsettings.port, &portsettings);
+    }
+
+    int status = server_run(settings.serve, sessions.list, sessions.n, &killed);
+    for (size_t i = 0; i < sessions.n; i++) session_die(&sessions.list[i]);
+    free(sessions.list);
+    sessions.list = NULL;
+    sessions.n = 0;
+    if (status == -1) {
+        cleanup();
+        exit(EXIT_FAILURE);
+    }
+    die();
+}
+
+int request(const char* cmd)
+{
+    if (settings.verbose) printf("%-12s = %s\n", "command", cmd);
+    return server_request(&conn, cmd, print_response);
+}
+
+void run_client(int argc, char** argv)
+{
+    if (settings.ndevices || settings.manifest.name) {
+        fprintf(stderr, "--connect takes a single device\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* responses arrive formatted by the daemon */
+    portsettings.hex = 0;
+
+    if (server_connect(&conn, settings.connect, settings.device.name) == -1) {
+        cleanup();
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (killed) die();
+        if (request(argv[i]) == -1) {
+            cleanup();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (settings.input.path && read_input(&settings.input, request) == -1) {
+        cleanup();
+        exit(EXIT_FAILURE);
+    }
+    die();
+}
+
 void term(int signum)
 {
     UNUSED(signum);
@@ -339,15 +1449,48 @@ void term(int signum)
 }
 
 
-void die(void)
+void cleanup(void)
 {
-    serial_die();
+    serial_die(&portsettings);
+    profile_save(&profile);
+    profile_die(&profile);
+    if (pipeline.slots) {
+        for (unsigned int i = 0; i < settings.window; i++) {
+            free(pipeline.slots[i].cmd);
+        }
+        free(pipeline.slots);
+    }
     portsettings_die(&portsettings);
     if (settings.device.path) free(settings.device.path);
     if (settings.input.path) free(settings.input.path);
+    if (settings.manifest.path) free(settings.manifest.path);
+    if (settings.schedule.path) free(settings.schedule.path);
+    free(settings.devices);
+    free(settings.send);
+    free(settings.groups);
+    for (size_t i = 0; i < settings.nexpanded; i++) free(settings.expanded[i]);
+    free(settings.expanded);
     if (settings.output.path) free(settings.output.path);
-    if (settings.output.stream) fclose(settings.output.stream);
-    /* if (output_file) fclose(output_file); */
+    output_close(&output);
+    journal_close(&journal);
+    record_close(&record);
+    capture_close(&capture_file);
+    columns_close(&columns);
+    schedule_die(&schedule);
+    free(capture.data);
+    stats_die(&stats);
+    server_close(&conn);
+    registry_close(&registry);
+}
+
+void die(void)
+{
+    if (settings.stats) {
+        stats.txbytes = portsettings.txbytes;
+        stats_print(&stats, stderr, settings.stats == 2);
+    }
+    if (schedule.n) schedule_print(&schedule, stderr);
+    cleanup();
     exit(EXIT_SUCCESS);
 }
 
@@ -362,11 +1505,14 @@ int main(int argc, char **argv)
 
 
     portsettings = portsettings_default();
+    settings.speed = 1;
+    settings.cpu = -1;
+    settings.checkpoint = -1;
 
     /* parse options */
     int oc;
     int oi = 0;
-    while ((oc = getopt_long(argc, argv, "d:i:o:b:p:t:n:vqh",
+    while ((oc = getopt_long(argc, argv, "d:i:m:o:b:p:t:n:avqh",
                     long_options, &oi)) != -1) {
         switch (oc) {
 
@@ -404,18 +1550,219 @@ int main(int argc, char **argv)
                 }
 
             /* program settings */
-            case 'd':
-                settings.device.name = optarg;
+            case 'd': {
+                char** devices = realloc(settings.devices,
+                        (settings.ndevices+1) * sizeof(char*));
+                if (!devices) exit(EXIT_FAILURE);
+                settings.devices = devices;
+                settings.devices[settings.ndevices++] = optarg;
                 break;
+            }
 
             case 'i':
                 settings.input.name = optarg;
                 break;
 
+            case 'm':
+                settings.manifest.name = optarg;
+                break;
+
             case 'o':
-                fprintf(stderr, "--output option not yet implemented ...\n");
-                exit(EXIT_FAILURE);
-                /* settings.output.name = optarg; */
+                settings.output.name = optarg;
+                break;
+
+            case OPT_FORMAT:
+                if (output_parse_format(&settings.format, optarg) != -1) {
+                    break;
+                } else {
+                    fprintf(stderr, "invalid format: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_ROTATE:
+                if (output_parse_size(&settings.rotate, optarg) != -1) {
+                    break;
+                } else {
+                    fprintf(stderr, "invalid size: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_DAEMON:
+                settings.serve = optarg;
+                break;
+
+            case OPT_CONNECT:
+                settings.connect = optarg;
+                break;
+
+            case OPT_RECORD:
+                settings.record = optarg;
+                break;
+
+            case OPT_REPLAY:
+                settings.replay = optarg;
+                break;
+
+            case OPT_GROUP: {
+                char** groups = realloc(settings.groups,
+                        (settings.ngroups+1) * sizeof(char*));
+                if (!groups) exit(EXIT_FAILURE);
+                settings.groups = groups;
+                settings.groups[settings.ngroups++] = optarg;
+                break;
+            }
+
+            case OPT_JOBS:
+                if (atoi(optarg) > 0) {
+                    settings.jobs = (size_t)atoi(optarg);
+                    break;
+                } else {
+                    fprintf(stderr, "invalid jobs: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_FIRST:
+                if (portsettings_set_first(&portsettings, optarg) != -1) {
+                    break;
+                } else {
+                    fprintf(stderr, "invalid first: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_GAP:
+                if (portsettings_set_gap(&portsettings, optarg) != -1) {
+                    break;
+                } else {
+                    fprintf(stderr, "invalid gap: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_TOTAL:
+                if (portsettings_set_total(&portsettings, optarg) != -1) {
+                    break;
+                } else {
+                    fprintf(stderr, "invalid total: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_LOWLATENCY:
+                portsettings.lowlatency = 1;
+                portsettings.fixed |= PORTSETTINGS_LOWLATENCY;
+                break;
+
+            case OPT_SPIN:
+                if (portsettings_set_spin(&portsettings, optarg) != -1) {
+                    portsettings.fixed |= PORTSETTINGS_SPIN;
+                    break;
+                } else {
+                    fprintf(stderr, "invalid spin: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_CPU:
+                if (*optarg >= '0' && *optarg <= '9') {
+                    settings.cpu = atoi(optarg);
+                    break;
+                } else {
+                    fprintf(stderr, "invalid cpu: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_EXTRACT:
+                settings.extract = optarg;
+                break;
+
+            case OPT_DUMP:
+                settings.dump = optarg;
+                break;
+
+            case OPT_CAPTURE:
+                settings.capture = optarg;
+                break;
+
+            case OPT_ROTATETIME: {
+                uint64_t nsec;
+                if (schedule_parse_period(&nsec, optarg) != -1) {
+                    settings.rotatetime = (double)nsec / 1e9;
+                    break;
+                } else {
+                    fprintf(stderr, "invalid rotate time: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            case OPT_COMPRESS:
+                settings.compress = 1;
+                break;
+
+            case OPT_URING:
+                settings.uring = 1;
+                break;
+
+            case OPT_JOURNAL:
+                settings.journal = optarg;
+                break;
+
+            case OPT_CHECKPOINT: {
+                uint64_t nsec;
+                if (strcmp(optarg, "0") == 0) {
+                    settings.checkpoint = 0;
+                    break;
+                } else if (schedule_parse_period(&nsec, optarg) != -1) {
+                    settings.checkpoint = (double)nsec / 1e9;
+                    break;
+                } else {
+                    fprintf(stderr, "invalid checkpoint: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            case OPT_RESUME:
+                settings.resume = 1;
+                break;
+
+            case OPT_SEND: {
+                char** send = realloc(settings.send,
+                        (settings.nsend+1) * sizeof(char*));
+                if (!send) exit(EXIT_FAILURE);
+                settings.send = send;
+                settings.send[settings.nsend++] = optarg;
+                break;
+            }
+
+            case OPT_RECEIVE:
+                settings.receive = optarg;
+                break;
+
+            case OPT_PROTOCOL: {
+                xmodem_protocol_t protocol;
+                if (xmodem_parse_protocol(&protocol, optarg) == -1) {
+                    fprintf(stderr, "invalid protocol: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                settings.protocol = optarg;
+                break;
+            }
+
+            case OPT_SCHEDULE:
+                settings.schedule.name = optarg;
+                break;
+
+            case OPT_ONCHANGE:
+                settings.onchange = 1;
+                break;
+
+            case OPT_SPEED:
+                if (atof(optarg) >= 0 && *optarg != '-') {
+                    settings.speed = atof(optarg);
+                    break;
+                } else {
+                    fprintf(stderr, "invalid speed: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case 'a':
+                settings.adaptive = 1;
                 break;
 
             case 'v':
@@ -426,6 +1773,83 @@ int main(int argc, char **argv)
                 settings.quiet = 1;
                 break;
 
+            case OPT_DELIMITER:
+                if (portsettings_set_delimiter(&portsettings, optarg) != -1) {
+                    portsettings.fixed |= PORTSETTINGS_DELIMITER;
+                    break;
+                } else {
+                    fprintf(stderr, "invalid delimiter: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_AUTOBAUD:
+                settings.autobaud = 1;
+                break;
+
+            case OPT_PROBE:
+                portsettings_set_probe(&portsettings, optarg);
+                break;
+
+            case OPT_EXPECT:
+                portsettings_set_expect(&portsettings, optarg);
+                break;
+
+            case OPT_FRAMING:
+                if (portsettings_set_framing(&portsettings, optarg) != -1) {
+                    portsettings.fixed |= PORTSETTINGS_FRAMING;
+                    break;
+                } else {
+                    fprintf(stderr, "invalid framing: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_STATS:
+                if (!optarg || strcmp(optarg, "text") == 0) {
+                    settings.stats = 1;
+                    break;
+                } else if (strcmp(optarg, "json") == 0) {
+                    settings.stats = 2;
+                    break;
+                } else {
+                    fprintf(stderr, "invalid stats format: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_FLOW:
+                if (portsettings_set_flow(&portsettings, optarg) != -1) {
+                    portsettings.fixed |= PORTSETTINGS_FLOW;
+                    break;
+                } else {
+                    fprintf(stderr, "invalid flow control: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+            case OPT_DRAIN:
+                portsettings.drain = 1;
+                portsettings.fixed |= PORTSETTINGS_DRAIN;
+                break;
+
+            case OPT_HEX:
+                portsettings.hex = 1;
+                portsettings.fixed |= PORTSETTINGS_HEX;
+                break;
+
+            case OPT_BURST:
+                settings.burst = 1;
+                break;
+
+            case OPT_WINDOW: {
+                char* end;
+                long window = strtol(optarg, &end, 10);
+                if (*optarg && !*end && window > 0 && window <= WINDOW_MAX) {
+                    settings.window = (unsigned int)window;
+                    break;
+                } else {
+                    fprintf(stderr, "invalid window: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
             case 'h':
                 print_help();
                 exit(EXIT_SUCCESS);
@@ -436,19 +1860,141 @@ int main(int argc, char **argv)
         }
     }
 
-    /* validate device config file */
-    if (settings.device.name) {
-        settings.device.path = find_file(settings.device.name, ".conf");
-        if (!settings.device.path) {
-            fprintf(stderr, "%s \"%s\"\n", strerror(errno),
-                    settings.device.name);
+    /* groups add to the devices given with -d */
+    for (size_t i = 0; i < settings.ngroups; i++) {
+        if (expand_group(settings.groups[i]) == -1) {
+            cleanup();
             exit(EXIT_FAILURE);
         }
     }
 
+    /* a single device keeps the classic single port path */
+    if (settings.ndevices == 1 && !settings.manifest.name && !settings.ngroups) {
+        settings.device.name = settings.devices[0];
+        settings.ndevices = 0;
+    }
+
+    if (settings.stats && (settings.ndevices || settings.manifest.name
+                || settings.serve || settings.connect || settings.window > 1)) {
+        fprintf(stderr, "--stats requires a single device without --window\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (settings.record && (settings.ndevices || settings.manifest.name
+                || settings.serve || settings.connect || settings.replay)) {
+        fprintf(stderr, "--record requires a single device\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (settings.extract && (settings.ndevices || settings.manifest.name
+                || settings.serve || settings.connect || !settings.device.name)) {
+        fprintf(stderr, "--extract requires a single device config\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (settings.capture && (settings.ndevices || settings.manifest.name
+                || settings.serve || settings.connect || settings.schedule.name
+                || settings.input.name || settings.window > 1
+                || settings.record || settings.extract || settings.output.name)) {
+        fprintf(stderr, "--capture requires a single device and only takes "
+                "commands as arguments\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((settings.send || settings.receive) && (settings.ndevices
+                || settings.manifest.name || settings.serve || settings.connect
+                || settings.schedule.name || settings.input.name
+                || settings.capture || settings.window > 1
+                || settings.journal)) {
+        fprintf(stderr, "--send and --receive require a single device and "
+                "only take commands as arguments\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (settings.send && settings.receive) {
+        fprintf(stderr, "--send can not be combined with --receive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (settings.protocol && !settings.send && !settings.receive) {
+        fprintf(stderr, "--protocol requires --send or --receive\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!settings.protocol) {
+        static char ymodem[] = "ymodem";
+        settings.protocol = ymodem;
+    }
+
+    if ((settings.rotatetime || settings.compress) && !settings.capture) {
+        fprintf(stderr, "--rotate-time and --compress require --capture\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* an extract log is converted to csv or json lines on stdout */
+    if (settings.dump) {
+        exit(columns_dump(settings.dump, stdout,
+                    settings.format == OUTPUT_JSON) == -1
+                ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    /* the recorded device is played on a pty until the client is done */
+    if (settings.replay) {
+        memset(&action, 0, sizeof(struct sigaction));
+        action.sa_handler = term;
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        exit(record_replay(settings.replay, settings.speed, &killed) == -1
+                ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    if (settings.schedule.name && (settings.ndevices || settings.manifest.name
+                || settings.serve || settings.connect || settings.window > 1
+                || settings.input.name || optind < argc)) {
+        fprintf(stderr, "--schedule requires a single device and takes no "
+                "other commands or --window\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (settings.onchange && !settings.schedule.name) {
+        fprintf(stderr, "--on-change requires --schedule\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (settings.serve && settings.connect) {
+        fprintf(stderr, "--daemon can not be combined with --connect\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* commands are piped in */
+    if (!settings.input.name && !settings.manifest.name && optind == argc
+            && !settings.serve && !settings.schedule.name
+            && !settings.capture && !settings.send && !settings.receive
+            && !isatty(STDIN_FILENO)) {
+        static char stdin_name[] = "-";
+        settings.input.name = stdin_name;
+    }
+
+    if (settings.journal && (settings.ndevices || settings.manifest.name
+                || settings.serve || settings.connect || settings.capture
+                || settings.schedule.name || !settings.input.name)) {
+        fprintf(stderr, "--journal requires a single device and an input "
+                "file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((settings.resume || settings.checkpoint >= 0) && !settings.journal) {
+        fprintf(stderr, "--checkpoint and --resume require --journal\n");
+        exit(EXIT_FAILURE);
+    }
+    if (settings.checkpoint < 0) settings.checkpoint = 1;
+
     /* validate input file */
-    if (settings.input.name) {
-        settings.input.path = find_file(settings.input.name, ".cmd");
+    if (settings.input.name && strcmp(settings.input.name, "-") == 0) {
+        settings.input.path = malloc(2);
+        strcpy(settings.input.path, "-");
+
+    } else if (settings.input.name) {
+        settings.input.path = config_find(settings.input.name, ".cmd");
         if (!settings.input.path) {
             fprintf(stderr, "%s \"%s\"\n", strerror(errno),
                     settings.input.name);
@@ -456,10 +2002,145 @@ int main(int argc, char **argv)
         }
     }
 
-    /* read config file (device) */
-    if (settings.device.path) {
-        if (parse_config(&settings.device)!= -1);
-        else exit(EXIT_FAILURE);
+    /* validate manifest */
+    if (settings.manifest.name) {
+        settings.manifest.path = config_find(settings.manifest.name, ".cmd");
+        if (!settings.manifest.path) {
+            fprintf(stderr, "%s \"%s\"\n", strerror(errno),
+                    settings.manifest.name);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* validate and parse schedule */
+    if (settings.schedule.name) {
+        settings.schedule.path = config_find(settings.schedule.name, ".cmd");
+        if (!settings.schedule.path) {
+            fprintf(stderr, "%s \"%s\"\n", strerror(errno),
+                    settings.schedule.name);
+            exit(EXIT_FAILURE);
+        }
+        if (schedule_load(&schedule, settings.schedule.path) == -1) {
+            schedule_die(&schedule);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* read device settings, a client only names the device to the daemon */
+    if (settings.device.name && !settings.connect) {
+        if (load_device(&portsettings, settings.device.name) == -1) {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* XON and XOFF are data in a binary transfer */
+    if ((settings.send || settings.receive)
+            && portsettings.flow == FLOW_XONXOFF) {
+        fprintf(stderr, "--send and --receive can not be used with "
+                "--flow xonxoff\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* output file */
+    if (settings.output.name && output_open(&output, settings.output.name,
+                settings.format, settings.rotate, settings.uring) == -1) {
+        exit(EXIT_FAILURE);
+    }
+
+    /* checkpoints of the input file */
+    if (settings.journal && journal_open(&journal, settings.journal,
+                settings.checkpoint, settings.resume, sync_responses) == -1) {
+        exit(EXIT_FAILURE);
+    }
+
+    /* real-time scheduling, granted or not the run goes on */
+    if (settings.cpu != -1) {
+        if (realtime_pin(settings.cpu) == -1) {
+            fprintf(stderr, "low-latency: pinning to cpu %i failed: %s\n",
+                    settings.cpu, strerror(errno));
+        } else {
+            fprintf(stderr, "low-latency: pinned to cpu %i\n", settings.cpu);
+        }
+        if (realtime_fifo(REALTIME_PRIORITY) == -1) {
+            fprintf(stderr, "low-latency: SCHED_FIFO failed: %s\n",
+                    strerror(errno));
+        } else {
+            fprintf(stderr, "low-latency: SCHED_FIFO priority %i\n",
+                    REALTIME_PRIORITY);
+        }
+        if (realtime_lock() == -1) {
+            fprintf(stderr, "low-latency: locking memory failed: %s\n",
+                    strerror(errno));
+        } else {
+            fprintf(stderr, "low-latency: memory locked\n");
+        }
+    }
+
+    /* rules were read with the device config */
+    if (settings.extract && columns_open(&columns, settings.extract) == -1) {
+        columns_close(&columns);
+        exit(EXIT_FAILURE);
+    }
+
+    /* traffic log */
+    if (settings.record) {
+        if (record_open(&record, settings.record) == -1) exit(EXIT_FAILURE);
+        portsettings.record = &record;
+    }
+
+    /* commands are handed to a running daemon */
+    if (settings.connect) run_client(argc, argv);
+
+    /* ports are kept open for clients */
+    if (settings.serve) {
+        if (settings.manifest.name || settings.input.name || optind < argc) {
+            fprintf(stderr, "--daemon takes no commands\n");
+            exit(EXIT_FAILURE);
+        }
+        if (settings.verbose) print_settings();
+        memset(&action, 0, sizeof(struct sigaction));
+        action.sa_handler = term;
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        serve();
+    }
+
+    /* several devices are served concurrently by one event loop */
+    if (settings.ndevices || settings.manifest.name) {
+        if (settings.window > 1) {
+            fprintf(stderr, "--window can not be combined with several devices\n");
+            exit(EXIT_FAILURE);
+        }
+        if (settings.verbose) print_settings();
+        memset(&action, 0, sizeof(struct sigaction));
+        action.sa_handler = term;
+        sigaction(SIGINT, &action, NULL);
+        run_sessions(argc, argv);
+    }
+
+    /* pipelining needs to know where a response ends */
+    if (settings.window > 1) {
+        if (portsettings.count == UINT_MAX) {
+            fprintf(stderr, "--window requires a line count (-n)\n");
+            exit(EXIT_FAILURE);
+        }
+        pipeline.slots = calloc(settings.window, sizeof(pending_t));
+        if (!pipeline.slots) {
+            fprintf(stderr, "error allocating command window\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* learned timing is kept per device config, or per port without one */
+    if (settings.adaptive) {
+        if (settings.window > 1) {
+            fprintf(stderr, "--adaptive can not be combined with --window\n");
+            exit(EXIT_FAILURE);
+        }
+        if (profile_load(&profile, settings.device.name ? settings.device.name
+                    : portsettings.port ? portsettings.port : "default") == -1) {
+            exit(EXIT_FAILURE);
+        }
     }
 
     /* verbose print */
@@ -472,60 +2153,53 @@ int main(int argc, char **argv)
     memset(&action, 0, sizeof(struct sigaction));
     action.sa_handler = term;
     sigaction(SIGINT, &action, NULL);
+    if (settings.journal) sigaction(SIGTERM, &action, NULL);
+
+    /* auto-baud starts from any rate */
+    if (settings.autobaud && !portsettings.baudrate) portsettings.baudrate = 9600;
 
     /* init serial port */
     if (serial_init(&portsettings) == -1) {
         exit(EXIT_FAILURE);
     }
 
+    if (settings.autobaud) {
+        if (serial_autobaud(&portsettings, portsettings.timeout) == -1) {
+            cleanup();
+            exit(EXIT_FAILURE);
+        }
+        if (settings.verbose) {
+            printf("%-12s = %u\n", "autobaud", portsettings.baudrate);
+        }
+    }
+
+    /* spool the port until interrupted, commands start the stream */
+    if (settings.capture) run_capture(argc, argv);
+
+    /* bulk file transfer, commands may prepare the device for it */
+    if (settings.send || settings.receive) run_transfer(argc, argv);
+
+    /* poll on the open port until interrupted */
+    if (settings.schedule.path) run_schedule();
+
     /* run arg commands */
     for (int i = optind; i < argc; i++) {
         if (killed) die();
-        if (settings.verbose) printf("%-12s = %s\n", "command", argv[i]);
         run(argv[i]);
     }
 
 
     /* run input file */
-    if (settings.input.name) {
-        settings.input.stream = fopen(settings.input.path, "r");
-        if (settings.input.stream) {
-
-            char line[CMD_LEN+2];
-
-            if (settings.verbose) printf("using input file \'%s\"\n",
-                    settings.input.path);
-
-            while (fgets(line, CMD_LEN+1, settings.input.stream)) {
-
-                if (killed) die();
-
-                /*filter comments and empty lines*/
-                if (*line == '#' || *line == '\n') continue;
-
-                /*validate max line length*/
-                if (strlen(line) >= CMD_LEN) {
-                    fprintf(stderr,
-                            "maximum line length exceeded: %i characters\n",
-                            CMD_LEN);
-                    return -1;
-                }
-
-                /*trim trailing newlines*/
-                if (line[strlen(line)-1] == '\n') line[strlen(line)-1] = '\0';
-
-                if (settings.verbose) printf("%-12s = %s\n", "command", line);
-                run(line);
-            }
-
-            fclose(settings.input.stream);
-
-        } else {
-            fprintf(stderr, "%s \"%s\"\n",
-                    strerror(errno), settings.input.name);
+    if (settings.input.path) {
+        if (read_input(&settings.input, run) == -1) {
+            cleanup();
             exit(EXIT_FAILURE);
         }
     }
+
+    /* send what is left of a burst and wait for responses still in flight */
+    if (serial_flush(&portsettings) != -1) journal_flushed(&journal);
+    flush();
     die();
 }
 
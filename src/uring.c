@@ -0,0 +1,358 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : uring.c
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/uring.h"
+
+/* the ring is only built when the kernel headers describe it */
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#define HAVE_URING 1
+#endif
+#endif
+
+#ifdef HAVE_URING
+
+#include <linux/io_uring.h>
+
+/**
+ * file offset meaning the current position
+ */
+#define URING_CURRENT ((uint64_t)-1)
+
+/**
+ * take a free submission entry, submitting what is prepared when full
+ *
+ * @param[in,out] uring ring
+ * @param[in] need free entries required, 2 keeps a linked request in the
+ *            same submission as the request it starts
+ * @return cleared entry or NULL for failure
+ */
+static struct io_uring_sqe* take_sqe(uring_t* uring, unsigned int need);
+
+/**
+ * prepare request
+ *
+ * @param[in,out] uring ring
+ * @param[in] op IORING_OP_*
+ * @param[in] fd file descriptor or -1
+ * @param[in] addr buffer or target
+ * @param[in] len length
+ * @param[in] data handed back on completion
+ * @param[in] link IOSQE_IO_LINK
+ * @return entry to complete or NULL for failure
+ */
+static struct io_uring_sqe* prepare(uring_t* uring, int op, int fd,
+        const void* addr, unsigned int len, uint64_t data, int link);
+
+struct io_uring_sqe* take_sqe(uring_t* uring, unsigned int need)
+{
+    unsigned int tail = *uring->sq_tail;
+    unsigned int head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+
+    if (tail - head + need > *uring->sq_mask + 1) {
+        if (uring_submit(uring, 0) == -1) return NULL;
+        head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head + need > *uring->sq_mask + 1) {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+
+    unsigned int i = tail & *uring->sq_mask;
+    struct io_uring_sqe* sqe = &uring->sqes[i];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    uring->sq_array[i] = i;
+    return sqe;
+}
+
+struct io_uring_sqe* prepare(uring_t* uring, int op, int fd,
+        const void* addr, unsigned int len, uint64_t data, int link)
+{
+    struct io_uring_sqe* sqe = take_sqe(uring, link ? 2 : 1);
+    if (!sqe) return NULL;
+
+    sqe->opcode = (unsigned char)op;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->user_data = data;
+    if (link) sqe->flags |= IOSQE_IO_LINK;
+
+    /* without SQPOLL the kernel only looks at entries in uring_submit(), the
+     * caller may still fill in the fields specific to the operation */
+    __atomic_store_n(uring->sq_tail, *uring->sq_tail + 1, __ATOMIC_RELEASE);
+    uring->pending++;
+    return sqe;
+}
+
+int uring_init(uring_t* uring, unsigned int entries)
+{
+    struct io_uring_params p;
+
+    memset(uring, 0, sizeof(uring_t));
+    memset(&p, 0, sizeof(p));
+
+    uring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (uring->fd == -1) return -1;
+
+    uring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    uring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (uring->cq_size > uring->sq_size) uring->sq_size = uring->cq_size;
+        uring->cq_size = uring->sq_size;
+    }
+
+    uring->sq_ring = mmap(NULL, uring->sq_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQ_RING);
+    if (uring->sq_ring == MAP_FAILED) goto fail;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        uring->cq_ring = uring->sq_ring;
+    } else {
+        uring->cq_ring = mmap(NULL, uring->cq_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_CQ_RING);
+        if (uring->cq_ring == MAP_FAILED) goto fail;
+    }
+
+    uring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES);
+    if (uring->sqes == MAP_FAILED) goto fail;
+
+    char* sq = uring->sq_ring;
+    char* cq = uring->cq_ring;
+    uring->sq_head = (unsigned int*)(void*)(sq + p.sq_off.head);
+    uring->sq_tail = (unsigned int*)(void*)(sq + p.sq_off.tail);
+    uring->sq_mask = (unsigned int*)(void*)(sq + p.sq_off.ring_mask);
+    uring->sq_array = (unsigned int*)(void*)(sq + p.sq_off.array);
+    uring->cq_head = (unsigned int*)(void*)(cq + p.cq_off.head);
+    uring->cq_tail = (unsigned int*)(void*)(cq + p.cq_off.tail);
+    uring->cq_mask = (unsigned int*)(void*)(cq + p.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe*)(void*)(cq + p.cq_off.cqes);
+    return 0;
+
+fail: {
+        int error = errno;
+        uring_die(uring);
+        errno = error;
+        return -1;
+    }
+}
+
+int uring_register(uring_t* uring, const struct iovec* iov, unsigned int n)
+{
+    return (int)syscall(__NR_io_uring_register, uring->fd,
+            IORING_REGISTER_BUFFERS, iov, n) == -1 ? -1 : 0;
+}
+
+int uring_read_fixed(uring_t* uring, int fd, void* buf, unsigned int len,
+        unsigned int index, uint64_t data, int link)
+{
+    struct io_uring_sqe* sqe = prepare(uring, IORING_OP_READ_FIXED, fd, buf,
+            len, data, link);
+    if (!sqe) return -1;
+    sqe->off = URING_CURRENT;
+    sqe->buf_index = (uint16_t)index;
+    return 0;
+}
+
+int uring_write_fixed(uring_t* uring, int fd, const void* buf,
+        unsigned int len, unsigned int index, uint64_t data, int link)
+{
+    struct io_uring_sqe* sqe = prepare(uring, IORING_OP_WRITE_FIXED, fd, buf,
+            len, data, link);
+    if (!sqe) return -1;
+    sqe->off = URING_CURRENT;
+    sqe->buf_index = (uint16_t)index;
+    return 0;
+}
+
+int uring_write(uring_t* uring, int fd, const void* buf, unsigned int len,
+        uint64_t data, int link)
+{
+    struct io_uring_sqe* sqe = prepare(uring, IORING_OP_WRITE, fd, buf, len,
+            data, link);
+    if (!sqe) return -1;
+    sqe->off = URING_CURRENT;
+    return 0;
+}
+
+int uring_poll(uring_t* uring, int fd, short events, uint64_t data,
+        int link)
+{
+    struct io_uring_sqe* sqe = prepare(uring, IORING_OP_POLL_ADD, fd, NULL, 0,
+            data, link);
+    if (!sqe) return -1;
+    sqe->poll32_events = (uint32_t)events;
+    return 0;
+}
+
+int uring_timeout(uring_t* uring, const struct timespec* deadline,
+        uint64_t data)
+{
+    uring->ts[0] = (int64_t)deadline->tv_sec;
+    uring->ts[1] = (int64_t)deadline->tv_nsec;
+
+    struct io_uring_sqe* sqe = prepare(uring, IORING_OP_TIMEOUT, -1,
+            uring->ts, 1, data, 0);
+    if (!sqe) return -1;
+    sqe->timeout_flags = IORING_TIMEOUT_ABS;
+    return 0;
+}
+
+int uring_cancel(uring_t* uring, uint64_t target, int timeout, uint64_t data)
+{
+    return prepare(uring, timeout ? IORING_OP_TIMEOUT_REMOVE
+            : IORING_OP_ASYNC_CANCEL, -1, (const void*)(uintptr_t)target, 0,
+            data, 0) ? 0 : -1;
+}
+
+void uring_unlink(uring_t* uring)
+{
+    if (!uring->pending) return;
+
+    unsigned int i = (*uring->sq_tail - 1) & *uring->sq_mask;
+    uring->sqes[uring->sq_array[i]].flags &= (unsigned char)~IOSQE_IO_LINK;
+}
+
+int uring_submit(uring_t* uring, unsigned int wait)
+{
+    int n = (int)syscall(__NR_io_uring_enter, uring->fd, uring->pending, wait,
+            wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (n == -1) return -1;
+    uring->pending -= (unsigned int)n;
+    return 0;
+}
+
+int uring_complete(uring_t* uring, uint64_t* data, int* res)
+{
+    unsigned int head = *uring->cq_head;
+    if (head == __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+
+    struct io_uring_cqe* cqe = &uring->cqes[head & *uring->cq_mask];
+    *data = cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n(uring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void uring_die(uring_t* uring)
+{
+    if (uring->sqes && uring->sqes != MAP_FAILED) {
+        munmap(uring->sqes, uring->sqes_size);
+    }
+    if (uring->cq_ring && uring->cq_ring != MAP_FAILED
+            && uring->cq_ring != uring->sq_ring) {
+        munmap(uring->cq_ring, uring->cq_size);
+    }
+    if (uring->sq_ring && uring->sq_ring != MAP_FAILED) {
+        munmap(uring->sq_ring, uring->sq_size);
+    }
+    if (uring->fd != -1) close(uring->fd);
+    memset(uring, 0, sizeof(uring_t));
+    uring->fd = -1;
+}
+
+#else
+
+int uring_init(uring_t* uring, unsigned int entries)
+{
+    (void)entries;
+    memset(uring, 0, sizeof(uring_t));
+    uring->fd = -1;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_register(uring_t* uring, const struct iovec* iov, unsigned int n)
+{
+    (void)uring; (void)iov; (void)n;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_read_fixed(uring_t* uring, int fd, void* buf, unsigned int len,
+        unsigned int index, uint64_t data, int link)
+{
+    (void)uring; (void)fd; (void)buf; (void)len; (void)index; (void)data;
+    (void)link;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_write_fixed(uring_t* uring, int fd, const void* buf,
+        unsigned int len, unsigned int index, uint64_t data, int link)
+{
+    (void)uring; (void)fd; (void)buf; (void)len; (void)index; (void)data;
+    (void)link;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_write(uring_t* uring, int fd, const void* buf, unsigned int len,
+        uint64_t data, int link)
+{
+    (void)uring; (void)fd; (void)buf; (void)len; (void)data; (void)link;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_poll(uring_t* uring, int fd, short events, uint64_t data,
+        int link)
+{
+    (void)uring; (void)fd; (void)events; (void)data; (void)link;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_timeout(uring_t* uring, const struct timespec* deadline,
+        uint64_t data)
+{
+    (void)uring; (void)deadline; (void)data;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_cancel(uring_t* uring, uint64_t target, int timeout, uint64_t data)
+{
+    (void)uring; (void)target; (void)timeout; (void)data;
+    errno = ENOSYS;
+    return -1;
+}
+
+void uring_unlink(uring_t* uring)
+{
+    (void)uring;
+}
+
+int uring_submit(uring_t* uring, unsigned int wait)
+{
+    (void)uring; (void)wait;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uring_complete(uring_t* uring, uint64_t* data, int* res)
+{
+    (void)uring; (void)data; (void)res;
+    return 0;
+}
+
+void uring_die(uring_t* uring)
+{
+    memset(uring, 0, sizeof(uring_t));
+    uring->fd = -1;
+}
+
+#endif
+
+// vim:ft=c
@@ -0,0 +1,847 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : xmodem.c
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/serial.h"
+#include "../include/xmodem.h"
+
+/**
+ * control characters
+ */
+#define SOH 0x01
+#define STX 0x02
+#define EOT 0x04
+#define ACK 0x06
+#define NAK 0x15
+#define CAN 0x18
+#define SUB 0x1a
+
+/**
+ * length of a short block
+ */
+#define SHORT_BLOCK 128
+
+/**
+ * attempts per block, and starts sent by a receiver
+ */
+#define RETRIES 10
+
+/**
+ * sec a sender waits for the receiver to start
+ */
+#define START_TIMEOUT 60.0
+
+/**
+ * sec between starts sent by a receiver
+ */
+#define START_INTERVAL 3.0
+
+/**
+ * sec to wait for an ACK or the next block
+ */
+#define BLOCK_TIMEOUT 10.0
+
+/**
+ * sec of silence within a block, also ends a purge
+ */
+#define CHAR_TIMEOUT 1.0
+
+/**
+ * result of reading from the port
+ */
+enum {
+    TIMEOUT = -1,         /**< nothing arrived in time */
+    FAILED = -2,          /**< port failed or transfer interrupted */
+    CANCELLED = -3,       /**< other side sent CAN CAN */
+};
+
+/**
+ * result of receiving a block
+ */
+enum {
+    BLOCK,                /**< valid block */
+    END,                  /**< EOT */
+    BAD,                  /**< corrupt block, purged */
+};
+
+/**
+ * state of one transfer
+ */
+typedef struct transfer_t {
+    portsettings_t* ps;   /**< open port */
+    xmodem_protocol_t protocol; /**< protocol */
+    volatile sig_atomic_t* killed; /**< set by SIGINT, SIGTERM */
+    int crc;              /**< CRC-16 instead of checksum */
+    int stream;           /**< blocks are not acknowledged */
+    size_t bytes;         /**< file bytes transferred */
+    size_t files;         /**< files completed */
+    unsigned int resent;  /**< blocks repeated after NAK or error */
+    double start;         /**< monotonic sec of the first block */
+    double end;           /**< monotonic sec the last file completed, 0 if
+                               none did */
+    unsigned char block[3 + XMODEM_BLOCK + 2]; /**< header, data, check */
+} transfer_t;
+
+/**
+ * current CLOCK_MONOTONIC time
+ *
+ * @return sec
+ */
+static double now(void);
+
+/**
+ * CRC-16/XMODEM, polynomial 0x1021
+ *
+ * @param[in] data bytes
+ * @param[in] len length of data
+ * @return crc
+ */
+static uint16_t crc16(const unsigned char* data, size_t len);
+
+/**
+ * read bytes from the port, those already buffered first
+ *
+ * @param[in,out] t transfer
+ * @param[out] buf destination
+ * @param[in] len bytes to read
+ * @param[in] timeout sec to wait for each byte
+ * @return 0 for succes, TIMEOUT or FAILED
+ */
+static int get(transfer_t* t, unsigned char* buf, size_t len, double timeout);
+
+/**
+ * read one byte, recognizing CAN CAN
+ *
+ * @param[in,out] t transfer
+ * @param[in] timeout sec to wait
+ * @return byte, TIMEOUT, FAILED or CANCELLED
+ */
+static int get_byte(transfer_t* t, double timeout);
+
+/**
+ * transmit bytes
+ *
+ * @param[in,out] t transfer
+ * @param[in] data bytes
+ * @param[in] len length of data
+ * @return status 0 for succes, -1 for failure
+ */
+static int put(transfer_t* t, const void* data, size_t len);
+
+/**
+ * transmit one control character
+ *
+ * @param[in,out] t transfer
+ * @param[in] c character
+ * @return status 0 for succes, -1 for failure
+ */
+static int put_byte(transfer_t* t, unsigned char c);
+
+/**
+ * discard input until the line has been quiet for CHAR_TIMEOUT
+ *
+ * @param[in,out] t transfer
+ */
+static void purge(transfer_t* t);
+
+/**
+ * discard input received so far
+ *
+ * @param[in,out] t transfer
+ */
+static void discard(transfer_t* t);
+
+/**
+ * abort the transfer on both ends
+ *
+ * @param[in,out] t transfer
+ * @param[in] reason printed to stderr
+ * @return -1
+ */
+static int cancel(transfer_t* t, const char* reason);
+
+/**
+ * print file bytes, time and throughput against the line rate to stderr
+ *
+ * @param[in] t transfer
+ * @param[in] verb "sent" or "received"
+ */
+static void report(const transfer_t* t, const char* verb);
+
+/**
+ * wait for the receiver to ask for a block: 'C', NAK or 'G'
+ *
+ * @param[in,out] t transfer, crc and stream are set as asked
+ * @return status 0 for succes, -1 for failure
+ */
+static int wait_start(transfer_t* t);
+
+/**
+ * transmit block and, unless streaming, wait for its ACK
+ *
+ * @param[in,out] t transfer
+ * @param[in] num block number
+ * @param[in] data payload, padded
+ * @param[in] size SHORT_BLOCK or XMODEM_BLOCK
+ * @return status 0 for succes, -1 for failure
+ */
+static int send_block(transfer_t* t, unsigned int num,
+        const unsigned char* data, size_t size);
+
+/**
+ * transmit the blocks of a file and EOT
+ *
+ * @param[in,out] t transfer
+ * @param[in] stream open file
+ * @param[in] name file name for messages
+ * @return status 0 for succes, -1 for failure
+ */
+static int send_data(transfer_t* t, FILE* stream, const char* name);
+
+/**
+ * transmit YMODEM block 0 of a file, or the empty one ending the batch
+ *
+ * @param[in,out] t transfer
+ * @param[in] path file or NULL
+ * @param[in] st status of the file
+ * @return status 0 for succes, -1 for failure
+ */
+static int send_header(transfer_t* t, const char* path,
+        const struct stat* st);
+
+/**
+ * receive the next block
+ *
+ * @param[in,out] t transfer, the block is left in block
+ * @param[in] timeout sec to wait for it to start
+ * @param[out] num block number
+ * @param[out] size payload length
+ * @return BLOCK, END, BAD, TIMEOUT, FAILED or CANCELLED
+ */
+static int recv_block(transfer_t* t, double timeout, unsigned int* num,
+        size_t* size);
+
+/**
+ * ask for blocks until the first one arrives
+ *
+ * @param[in,out] t transfer
+ * @param[out] num block number
+ * @param[out] size payload length
+ * @return BLOCK, END or FAILED
+ */
+static int recv_first(transfer_t* t, unsigned int* num, size_t* size);
+
+/**
+ * receive the blocks of a file up to EOT, the first one is in block
+ *
+ * @param[in,out] t transfer
+ * @param[in] fd open file
+ * @param[in] size length of the file, -1 when unknown
+ * @param[in] num number of the first block
+ * @param[in] len payload length of the first block
+ * @return status 0 for succes, -1 for failure
+ */
+static int recv_data(transfer_t* t, int fd, long long size, unsigned int num,
+        size_t len);
+
+/**
+ * create a file received in a YMODEM batch
+ *
+ * @param[in] dir directory
+ * @param[in] name name given by the header, directories are stripped
+ * @return open file or -1 for failure
+ */
+static int create(const char* dir, const char* name);
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+uint16_t crc16(const unsigned char* data, size_t len)
+{
+    uint16_t crc = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (uint16_t)(crc << 1 ^ 0x1021)
+                : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+int get(transfer_t* t, unsigned char* buf, size_t len, double timeout)
+{
+    struct pollfd pfd = { .fd = t->ps->fd, .events = POLLIN };
+
+    while (len) {
+        size_t n = rxbuf_take(&t->ps->rx, (char*)buf, len);
+        buf += n;
+        len -= n;
+        if (!len) break;
+
+        if (*t->killed) return FAILED;
+
+        int r = poll(&pfd, 1, (int)(timeout * 1000));
+        if (r == -1 && errno == EINTR) continue;
+        if (r == -1) {
+            fprintf(stderr, "error polling port: %s\n", strerror(errno));
+            return FAILED;
+        }
+        if (r == 0) return TIMEOUT;
+        if (serial_read(t->ps) == -1) return FAILED;
+    }
+    return 0;
+}
+
+int get_byte(transfer_t* t, double timeout)
+{
+    unsigned char c;
+    int r = get(t, &c, 1, timeout);
+
+    if (r) return r;
+    if (c != CAN) return c;
+
+    /* a single CAN may be line noise */
+    r = get(t, &c, 1, CHAR_TIMEOUT);
+    if (r == FAILED) return FAILED;
+    if (r == 0 && c == CAN) return CANCELLED;
+    return r == 0 ? c : CAN;
+}
+
+int put(transfer_t* t, const void* data, size_t len)
+{
+    return serial_write(t->ps, data, len);
+}
+
+int put_byte(transfer_t* t, unsigned char c)
+{
+    return put(t, &c, 1);
+}
+
+void purge(transfer_t* t)
+{
+    unsigned char c;
+    while (get(t, &c, 1, CHAR_TIMEOUT) == 0) continue;
+}
+
+void discard(transfer_t* t)
+{
+    rxbuf_reset(&t->ps->rx);
+    tcflush(t->ps->fd, TCIFLUSH);
+}
+
+int cancel(transfer_t* t, const char* reason)
+{
+    static const unsigned char cans[] = { CAN, CAN, CAN, CAN, CAN };
+
+    fprintf(stderr, "transfer cancelled: %s\n", reason);
+    put(t, cans, sizeof(cans));
+    return -1;
+}
+
+void report(const transfer_t* t, const char* verb)
+{
+    unsigned int bits = 1 + t->ps->databits + (t->ps->parity != 'n')
+        + t->ps->stopbits;
+    double line = (double)t->ps->baudrate / bits;
+    double end = t->end > t->start ? t->end : now();
+    double elapsed = t->start ? end - t->start : 0;
+    double rate = elapsed > 0 ? (double)t->bytes / elapsed : 0;
+
+    fprintf(stderr, "%s: %s %zu file%s, %zu bytes in %.2f sec (%.0f bytes/s), "
+            "%.1f%% of %.0f bytes/s at %u baud %u%c%u, %u blocks resent\n",
+            t->protocol == XMODEM ? "xmodem"
+            : t->protocol == XMODEM_1K ? "xmodem-1k"
+            : t->protocol == YMODEM ? "ymodem" : "ymodem-g",
+            verb, t->files, t->files == 1 ? "" : "s", t->bytes, elapsed, rate,
+            line > 0 ? 100 * rate / line : 0.0, line,
+            (unsigned int)t->ps->baudrate, t->ps->databits,
+            t->ps->parity - 'a' + 'A', t->ps->stopbits, t->resent);
+}
+
+int wait_start(transfer_t* t)
+{
+    double deadline = now() + START_TIMEOUT;
+
+    for (;;) {
+        double left = deadline - now();
+        int c = get_byte(t, left > 0 ? left : 0);
+
+        switch (c) {
+            case 'C':
+                t->crc = 1;
+                t->stream = 0;
+                break;
+            case NAK:
+                t->crc = 0;
+                t->stream = 0;
+                break;
+            case 'G':
+                if (t->protocol < YMODEM) continue;
+                t->crc = 1;
+                t->stream = 1;
+                break;
+            case TIMEOUT:
+                return cancel(t, "receiver did not start");
+            case FAILED:
+                return cancel(t, "interrupted");
+            case CANCELLED:
+                fprintf(stderr, "transfer cancelled by receiver\n");
+                return -1;
+            default:
+                continue;
+        }
+
+        /* repeated starts queued while waiting would read as NAKs */
+        discard(t);
+        if (!t->start) t->start = now();
+        return 0;
+    }
+}
+
+int send_block(transfer_t* t, unsigned int num, const unsigned char* data,
+        size_t size)
+{
+    unsigned char* b = t->block;
+    size_t len = 3 + size;
+
+    b[0] = size == SHORT_BLOCK ? SOH : STX;
+    b[1] = (unsigned char)num;
+    b[2] = (unsigned char)~num;
+    if (data != b + 3) memcpy(b + 3, data, size);
+    if (t->crc) {
+        uint16_t crc = crc16(b + 3, size);
+        b[len++] = (unsigned char)(crc >> 8);
+        b[len++] = (unsigned char)crc;
+    } else {
+        unsigned char sum = 0;
+        for (size_t i = 0; i < size; i++) sum = (unsigned char)(sum + b[3+i]);
+        b[len++] = sum;
+    }
+
+    for (unsigned int attempt = 0; attempt < RETRIES; attempt++) {
+        if (attempt) t->resent++;
+        if (put(t, b, len) == -1) return -1;
+
+        if (t->stream) return 0;
+
+        for (;;) {
+            int c = get_byte(t, BLOCK_TIMEOUT);
+            if (c == ACK) return 0;
+            if (c == NAK || c == 'C' || c == TIMEOUT) break;
+            if (c == FAILED) return cancel(t, "interrupted");
+            if (c == CANCELLED) {
+                fprintf(stderr, "transfer cancelled by receiver\n");
+                return -1;
+            }
+        }
+    }
+    return cancel(t, "too many retries");
+}
+
+int send_data(transfer_t* t, FILE* stream, const char* name)
+{
+    size_t block = t->protocol == XMODEM ? SHORT_BLOCK : XMODEM_BLOCK;
+    unsigned char* data = t->block + 3;
+    unsigned int num = 1;
+    size_t n;
+
+    while ((n = fread(data, 1, block, stream)) > 0) {
+
+        /* a short tail goes in a short block, padded */
+        size_t size = n <= SHORT_BLOCK ? SHORT_BLOCK : block;
+        memset(data + n, SUB, size - n);
+
+        if (send_block(t, num++, data, size) == -1) return -1;
+        t->bytes += n;
+
+        /* streaming only stops for a cancel */
+        if (t->stream) {
+            int c;
+            while ((c = get_byte(t, 0)) >= 0) continue;
+            if (c == FAILED) return cancel(t, "interrupted");
+            if (c == CANCELLED) {
+                fprintf(stderr, "transfer cancelled by receiver\n");
+                return -1;
+            }
+        }
+    }
+    if (ferror(stream)) {
+        fprintf(stderr, "error reading %s: %s\n", name, strerror(errno));
+        return cancel(t, "read error");
+    }
+
+    /* YMODEM receivers commonly NAK the first EOT */
+    for (unsigned int attempt = 0; attempt < RETRIES; attempt++) {
+        if (put_byte(t, EOT) == -1) return -1;
+        int c = get_byte(t, BLOCK_TIMEOUT);
+        if (c == ACK) {
+            t->files++;
+            t->end = now();
+            return 0;
+        }
+        if (c == FAILED) return cancel(t, "interrupted");
+        if (c == CANCELLED) {
+            fprintf(stderr, "transfer cancelled by receiver\n");
+            return -1;
+        }
+    }
+    return cancel(t, "end of file not acknowledged");
+}
+
+int send_header(transfer_t* t, const char* path, const struct stat* st)
+{
+    unsigned char* data = t->block + 3;
+    size_t size = SHORT_BLOCK;
+
+    memset(data, 0, XMODEM_BLOCK);
+    if (path) {
+        const char* name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+        int len = snprintf((char*)data, XMODEM_BLOCK, "%s%c%lld %llo %o",
+                name, '\0', (long long)st->st_size,
+                (unsigned long long)st->st_mtime,
+                (unsigned int)(st->st_mode & 07777));
+        if (len >= XMODEM_BLOCK) {
+            fprintf(stderr, "file name too long: %s\n", name);
+            return cancel(t, "file name too long");
+        }
+        if (len >= SHORT_BLOCK) size = XMODEM_BLOCK;
+    }
+
+    /* a streaming receiver only acknowledges the empty header */
+    if (send_block(t, 0, data, size) == -1) return -1;
+    if (t->stream && !path) {
+        int c = get_byte(t, CHAR_TIMEOUT);
+        if (c == FAILED) return cancel(t, "interrupted");
+    }
+    return 0;
+}
+
+int recv_block(transfer_t* t, double timeout, unsigned int* num, size_t* size)
+{
+    unsigned char* b = t->block;
+    double deadline = now() + timeout;
+    int c;
+
+    /* anything but the start of a block is noise */
+    do {
+        double left = deadline - now();
+        c = get_byte(t, left > 0 ? left : 0);
+        if (c < 0) return c;
+        if (c == EOT) return END;
+    } while (c != SOH && c != STX);
+
+    *size = c == SOH ? SHORT_BLOCK : XMODEM_BLOCK;
+    size_t len = 2 + *size + (t->crc ? 2 : 1);
+
+    b[0] = (unsigned char)c;
+    c = get(t, b + 1, len, CHAR_TIMEOUT);
+    if (c == FAILED) return FAILED;
+
+    int valid = c == 0 && b[1] == (unsigned char)~b[2];
+    if (valid && t->crc) {
+        valid = crc16(b + 3, *size)
+            == (uint16_t)(b[3 + *size] << 8 | b[4 + *size]);
+    } else if (valid) {
+        unsigned char sum = 0;
+        for (size_t i = 0; i < *size; i++) sum = (unsigned char)(sum + b[3+i]);
+        valid = sum == b[3 + *size];
+    }
+    if (!valid) {
+        purge(t);
+        return BAD;
+    }
+    *num = b[1];
+    return BLOCK;
+}
+
+int recv_first(transfer_t* t, unsigned int* num, size_t* size)
+{
+    for (unsigned int attempt = 0; attempt < RETRIES; attempt++) {
+
+        /* an XMODEM sender without CRC only answers a NAK */
+        if (t->protocol < YMODEM && attempt == RETRIES / 2) t->crc = 0;
+
+        unsigned char start = t->stream ? 'G' : t->crc ? 'C' : NAK;
+        if (put_byte(t, start) == -1) return FAILED;
+
+        int r = recv_block(t, START_INTERVAL, num, size);
+        if (r == BLOCK || r == END) {
+            if (!t->start) t->start = now();
+            return r;
+        }
+        if (r == FAILED) {
+            cancel(t, "interrupted");
+            return FAILED;
+        }
+        if (r == CANCELLED) {
+            fprintf(stderr, "transfer cancelled by sender\n");
+            return FAILED;
+        }
+    }
+    cancel(t, "sender did not start");
+    return FAILED;
+}
+
+int recv_data(transfer_t* t, int fd, long long size, unsigned int num,
+        size_t len)
+{
+    unsigned int expected = 1;
+    unsigned int errors = 0;
+    int eot = 0;
+    int r = BLOCK;
+
+    for (;;) {
+        if (r == BLOCK && num == (expected & 0xff)) {
+            size_t n = size >= 0 && (long long)len > size ? (size_t)size : len;
+            if (n && write(fd, t->block + 3, n) != (ssize_t)n) {
+                fprintf(stderr, "error writing file: %s\n", strerror(errno));
+                return cancel(t, "write error");
+            }
+            if (size >= 0) size -= (long long)n;
+            t->bytes += n;
+            expected++;
+            errors = 0;
+            if (!t->stream && put_byte(t, ACK) == -1) return -1;
+
+        } else if (r == BLOCK && num == ((expected - 1) & 0xff)) {
+            /* our ACK was lost, the sender repeated the block */
+            t->resent++;
+            if (!t->stream && put_byte(t, ACK) == -1) return -1;
+
+        } else if (r == BLOCK) {
+            return cancel(t, "block out of sequence");
+
+        } else if (r == END) {
+            /* a YMODEM sender confirms the end by repeating EOT */
+            if (t->protocol == YMODEM && !eot++) {
+                if (put_byte(t, NAK) == -1) return -1;
+            } else {
+                if (put_byte(t, ACK) == -1) return -1;
+                t->files++;
+                t->end = now();
+                return 0;
+            }
+
+        } else if (r == FAILED) {
+            return cancel(t, "interrupted");
+
+        } else if (r == CANCELLED) {
+            fprintf(stderr, "transfer cancelled by sender\n");
+            return -1;
+
+        } else if (t->stream) {
+            return cancel(t, r == BAD ? "corrupt block while streaming"
+                    : "sender stopped");
+
+        } else {
+            if (++errors == RETRIES) return cancel(t, "too many errors");
+            t->resent++;
+            if (put_byte(t, NAK) == -1) return -1;
+        }
+
+        r = recv_block(t, BLOCK_TIMEOUT, &num, &len);
+    }
+}
+
+int create(const char* dir, const char* name)
+{
+    const char* base = strrchr(name, '/') ? strrchr(name, '/') + 1 : name;
+
+    if (!*base || strcmp(base, ".") == 0 || strcmp(base, "..") == 0) {
+        fprintf(stderr, "invalid file name: %s\n", name);
+        return -1;
+    }
+
+    char* path = malloc(strlen(dir) + strlen(base) + 2);
+    if (!path) return -1;
+    sprintf(path, "%s/%s", dir, base);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+    free(path);
+    return fd;
+}
+
+int xmodem_parse_protocol(xmodem_protocol_t* protocol, const char* str)
+{
+    if (strcmp(str, "xmodem") == 0) *protocol = XMODEM;
+    else if (strcmp(str, "xmodem-1k") == 0) *protocol = XMODEM_1K;
+    else if (strcmp(str, "ymodem") == 0) *protocol = YMODEM;
+    else if (strcmp(str, "ymodem-g") == 0) *protocol = YMODEM_G;
+    else return -1;
+    return 0;
+}
+
+int xmodem_send(portsettings_t* portsettings, xmodem_protocol_t protocol,
+        char* const* files, size_t n, volatile sig_atomic_t* killed)
+{
+    transfer_t t = {
+        .ps = portsettings,
+        .protocol = protocol,
+        .killed = killed,
+    };
+    int status = 0;
+
+    if (protocol < YMODEM && n != 1) {
+        fprintf(stderr, "xmodem sends a single file\n");
+        return -1;
+    }
+
+    /* a missing file is better found before the receiver starts */
+    for (size_t i = 0; i < n; i++) {
+        if (access(files[i], R_OK) == -1) {
+            fprintf(stderr, "%s \"%s\"\n", strerror(errno), files[i]);
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i < n && status == 0; i++) {
+        struct stat st;
+        FILE* stream = fopen(files[i], "rb");
+
+        if (!stream || fstat(fileno(stream), &st) == -1) {
+            fprintf(stderr, "%s \"%s\"\n", strerror(errno), files[i]);
+            if (stream) fclose(stream);
+            status = cancel(&t, "can not open file");
+            break;
+        }
+
+        if (protocol >= YMODEM && (wait_start(&t) == -1
+                    || send_header(&t, files[i], &st) == -1)) {
+            status = -1;
+        } else if (wait_start(&t) == -1
+                || send_data(&t, stream, files[i]) == -1) {
+            status = -1;
+        }
+        fclose(stream);
+    }
+
+    /* an empty header ends the batch */
+    if (status == 0 && protocol >= YMODEM
+            && (wait_start(&t) == -1 || send_header(&t, NULL, NULL) == -1)) {
+        status = -1;
+    }
+
+    report(&t, "sent");
+    return status;
+}
+
+int xmodem_receive(portsettings_t* portsettings, xmodem_protocol_t protocol,
+        const char* path, volatile sig_atomic_t* killed)
+{
+    transfer_t t = {
+        .ps = portsettings,
+        .protocol = protocol,
+        .killed = killed,
+        .crc = 1,
+        .stream = protocol == YMODEM_G,
+    };
+    unsigned int num;
+    size_t len;
+    int status = 0;
+
+    if (protocol < YMODEM) {
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            fprintf(stderr, "%s \"%s\"\n", strerror(errno), path);
+            return -1;
+        }
+        int r = recv_first(&t, &num, &len);
+        if (r == FAILED) status = -1;
+        else if (r == END) status = cancel(&t, "sender sent no data");
+        else status = recv_data(&t, fd, -1, num, len);
+        if (close(fd) == -1) status = -1;
+        report(&t, "received");
+        return status;
+    }
+
+    for (;;) {
+        char* name = (char*)t.block + 3;
+        int r = recv_first(&t, &num, &len);
+
+        if (r == FAILED) {
+            status = -1;
+            break;
+        }
+        if (r == END || num != 0) {
+            status = cancel(&t, "expected a file header");
+            break;
+        }
+
+        /* an empty name ends the batch */
+        if (!*name) {
+            put_byte(&t, ACK);
+            break;
+        }
+
+        /* name, then optional size, mtime and mode */
+        name[len-1] = '\0';
+        char* info = name + strlen(name) + 1;
+        long long size = -1;
+        unsigned long long mtime = 0;
+        if (info < name + len - 1) sscanf(info, "%lld %llo", &size, &mtime);
+
+        int fd = create(path, name);
+        if (fd == -1) {
+            status = cancel(&t, "can not create file");
+            break;
+        }
+        char* file = strdup(name);
+        if (!file) {
+            close(fd);
+            status = cancel(&t, "out of memory");
+            break;
+        }
+
+        if (!t.stream && put_byte(&t, ACK) == -1) status = -1;
+
+        /* the data is asked for like the header */
+        if (status == 0) r = recv_first(&t, &num, &len);
+        if (status == -1 || r == FAILED) {
+            status = -1;
+        } else if (r == END) {
+            if (put_byte(&t, ACK) == -1) status = -1;
+            t.files++;
+        } else {
+            status = recv_data(&t, fd, size, num, len);
+        }
+
+        /* keep the time of the original */
+        if (status == 0 && mtime) {
+            struct timespec times[2] = {
+                { .tv_sec = 0, .tv_nsec = UTIME_OMIT },
+                { .tv_sec = (time_t)mtime, .tv_nsec = 0 },
+            };
+            futimens(fd, times);
+        }
+        if (close(fd) == -1) status = -1;
+        if (status == -1) fprintf(stderr, "incomplete file: %s\n", file);
+        free(file);
+        if (status == -1) break;
+    }
+
+    report(&t, "received");
+    return status;
+}
+
+// vim:ft=c
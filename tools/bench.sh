@@ -0,0 +1,98 @@
+#!/bin/sh
+################################################################################
+# @author      : Arno Lievens (arnolievens@gmail.com)
+# @file        : bench.sh
+# @created     : 17/10/2026
+#
+# drive trx through trxsim across a set of scenarios and report commands/s,
+# bytes/s and response time percentiles
+#
+# usage: bench.sh [trx] [trxsim]
+################################################################################
+
+TRX=${1:-./bin/trx}
+SIM=${2:-./bin/trxsim}
+TMP=$(mktemp -d)
+SIM_PID=
+
+cleanup() {
+    [ -n "$SIM_PID" ] && kill "$SIM_PID" 2>/dev/null && wait "$SIM_PID"
+    rm -rf "$TMP"
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+# json value of key $1 from the top level stats object on stdin
+field() {
+    sed -e 's/.*\],//' -e "s/.*\"$1\":\([^,}]*\).*/\1/"
+}
+
+# percentile $2 of series $1 of the first command in the stats on stdin
+percentile() {
+    sed -e "s/[^[]*\[{.*\"$1\":{[^}]*\"$2\":\([^,}]*\).*/\1/"
+}
+
+# run one scenario
+#   $1 name
+#   $2 number of commands
+#   $3 trxsim options
+#   $4 trx options
+scenario() {
+    "$SIM" -l "$TMP/tty" $3 > /dev/null &
+    SIM_PID=$!
+    while [ ! -e "$TMP/tty" ]; do sleep 0.01; done
+
+    i=0
+    while [ "$i" -lt "$2" ]; do echo "cmd $i"; i=$((i + 1)); done > "$TMP/cmds"
+
+    start=$(date +%s%N)
+    "$TRX" -p "$TMP/tty" -b 115200 -q -i "$TMP/cmds" $4 2> "$TMP/stats" < /dev/null
+    status=$?
+    end=$(date +%s%N)
+
+    kill "$SIM_PID"
+    wait "$SIM_PID"
+    SIM_PID=
+
+    if [ "$status" -ne 0 ]; then
+        printf "%-12s failed\n" "$1"
+        cat "$TMP/stats" >&2
+        return 1
+    fi
+
+    json=$(tail -n 1 "$TMP/stats")
+    case "$json" in
+        "{"*)
+            timeouts=$(echo "$json" | field timeouts)
+            bytes=$(echo "$json" | field bytes_per_sec)
+            p50=$(echo "$json" | percentile total p50)
+            p99=$(echo "$json" | percentile total p99)
+            ;;
+        *)
+            timeouts=-
+            bytes=-
+            p50=-
+            p99=-
+            ;;
+    esac
+
+    awk -v name="$1" -v n="$2" -v ns=$((end - start)) -v to="$timeouts" \
+        -v bytes="$bytes" -v p50="$p50" -v p99="$p99" 'BEGIN {
+        printf "%-12s %8d %10.1f %12s %9s %9s %8s\n", name, n,
+            n / (ns / 1e9), bytes == "-" ? "-" : sprintf("%.0f", bytes),
+            p50 == "-" ? "-" : sprintf("%.3f", p50 * 1000),
+            p99 == "-" ? "-" : sprintf("%.3f", p99 * 1000), to
+    }'
+}
+
+printf "%-12s %8s %10s %12s %9s %9s %8s\n" \
+    scenario commands "commands/s" "bytes/s" "p50 ms" "p99 ms" timeouts
+
+scenario short      2000 ""                          "-n 1 -t 1 --stats=json"
+scenario window     2000 ""                          "-n 1 -t 1 --window 16"
+scenario large        50 "-n 100 -s 1000"            "-n 100 -t 1 --stats=json"
+scenario slow         20 "-L 0.05"                   "-n 1 -t 1 --stats=json"
+scenario linerate     20 "-n 10 -r 1000"             "-n 10 -t 1 --stats=json"
+scenario highbaud    200 "-n 10 -s 200 -b 3000000"   "-n 10 -t 1 -b 3000000 --stats=json"
+scenario lossy       200 "-e 0.05 -S 7"              "-n 1 -t 0.02 --stats=json"
+scenario garbage     500 "-g 0.1 -S 7"               "-n 1 -t 1 --stats=json"
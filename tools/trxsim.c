@@ -0,0 +1,330 @@
+/**
+ * @author      : Arno Lievens (arnolievens@gmail.com)
+ * @created     : 17/10/2026
+ * @filename    : trxsim.c
+ *
+ * serial device simulator on a pseudo-terminal
+ *
+ * every command (terminated by CR or LF) is answered with <lines> lines
+ * "<command>-<i>", padded with 'x' to <size> bytes and terminated by CRLF
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * max length of a received command
+ */
+#define CMD_MAX 4096
+
+/**
+ * simulated device behaviour
+ */
+struct config {
+    const char* link;      /**< symlink to the slave side or NULL */
+    double latency;        /**< sec from command to first line */
+    double rate;           /**< max lines per sec, 0 for back to back */
+    unsigned int lines;    /**< lines per response */
+    size_t size;           /**< min length of a line, excluding CRLF */
+    double drop;           /**< probability that a command is ignored */
+    double garbage;        /**< probability of a line of random bytes */
+    unsigned int baudrate; /**< emulated wire speed, 0 for unlimited */
+} config = { .lines = 1 };
+
+/**
+ * line scheduled for transmission
+ */
+typedef struct line_t {
+    double due;            /**< monotonic sec the line may be written */
+    char* data;            /**< line including terminator */
+    size_t len;            /**< length of data */
+    struct line_t* next;   /**< next scheduled line */
+} line_t;
+
+/**
+ * fifo of lines waiting to be written
+ */
+struct schedule {
+    line_t* head;          /**< first line due */
+    line_t* tail;          /**< last line due */
+    double free;           /**< monotonic sec the emulated wire is idle */
+} schedule;
+
+volatile sig_atomic_t killed = 0;
+
+/**
+ * current CLOCK_MONOTONIC time
+ *
+ * @return seconds
+ */
+static double now(void);
+
+/**
+ * schedule the response to a command
+ *
+ * @param[in] cmd received command
+ * @param[in] len length of cmd
+ * @return status 0 for succes, -1 for failure
+ */
+static int respond(const char* cmd, size_t len);
+
+/**
+ * write all lines that are due
+ *
+ * @param[in] fd master side of the pty
+ * @return status 0 for succes, -1 for failure
+ */
+static int transmit(int fd);
+
+/**
+ * open pty pair in raw mode
+ *
+ * @param[out] slave open slave side, kept open so a closing client does not
+ *             hang up the master
+ * @return master file descriptor or -1 for failure
+ */
+static int open_pty(int* slave);
+
+/**
+ * print help menu
+ */
+static void print_help(void);
+
+/**
+ * signal handler
+ *
+ * @param[in] signum signal number
+ */
+static void term(int signum);
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int respond(const char* cmd, size_t len)
+{
+    double t = now() + config.latency;
+
+    if (config.drop > 0 && (double)rand() / RAND_MAX < config.drop) return 0;
+
+    for (unsigned int i = 0; i < config.lines; i++) {
+        line_t* line = calloc(1, sizeof(line_t));
+        char num[16];
+        int n = snprintf(num, sizeof(num), "-%u", i);
+        size_t size = len + (size_t)n;
+
+        if (size < config.size) size = config.size;
+        if (!line || !(line->data = malloc(size + 2))) {
+            free(line);
+            return -1;
+        }
+
+        if (config.garbage > 0 && (double)rand() / RAND_MAX < config.garbage) {
+            for (size_t j = 0; j < size; j++) line->data[j] = (char)rand();
+        } else {
+            memcpy(line->data, cmd, len);
+            memcpy(line->data + len, num, (size_t)n);
+            memset(line->data + len + n, 'x', size - len - (size_t)n);
+        }
+        memcpy(line->data + size, "\r\n", 2);
+        line->len = size + 2;
+
+        /* lines of one response are spaced by the line rate */
+        line->due = t + (config.rate > 0 ? i / config.rate : 0);
+
+        if (schedule.tail) schedule.tail->next = line;
+        else schedule.head = line;
+        schedule.tail = line;
+    }
+    return 0;
+}
+
+int transmit(int fd)
+{
+    double t = now();
+
+    while (schedule.head && schedule.head->due <= t && schedule.free <= t) {
+        line_t* line = schedule.head;
+        size_t off = 0;
+
+        while (off < line->len) {
+            ssize_t n = write(fd, line->data + off, line->len - off);
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN) {
+                    poll(&(struct pollfd){ .fd = fd, .events = POLLOUT }, 1, -1);
+                    continue;
+                }
+                return -1;
+            }
+            off += (size_t)n;
+        }
+
+        /* 10 bits per byte on the emulated wire */
+        if (config.baudrate) {
+            schedule.free = t + 10.0 * (double)line->len / config.baudrate;
+        }
+
+        schedule.head = line->next;
+        if (!schedule.head) schedule.tail = NULL;
+        free(line->data);
+        free(line);
+    }
+    return 0;
+}
+
+int open_pty(int* slave)
+{
+    struct termios tty;
+    int fd;
+
+    if ((fd = posix_openpt(O_RDWR | O_NOCTTY)) == -1
+            || grantpt(fd) == -1 || unlockpt(fd) == -1) {
+        fprintf(stderr, "error opening pty: %s\n", strerror(errno));
+        return -1;
+    }
+    if ((*slave = open(ptsname(fd), O_RDWR | O_NOCTTY)) == -1) {
+        fprintf(stderr, "error opening %s: %s\n", ptsname(fd), strerror(errno));
+        close(fd);
+        return -1;
+    }
+    tcgetattr(*slave, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(*slave, TCSANOW, &tty);
+    return fd;
+}
+
+void term(int signum)
+{
+    (void)signum;
+    killed = 1;
+}
+
+void print_help(void)
+{
+    static const char* help[] = {
+        "usage: trxsim [options]",
+        "",
+        "simulate a serial device on a pseudo-terminal, the slave path is",
+        "printed on stdout",
+        "",
+        "  -l  <path>      create symlink to the slave side",
+        "  -L  <sec>       latency from command to first line (0)",
+        "  -r  <lines/s>   max rate of response lines, 0 for no limit (0)",
+        "  -n  <lines>     lines per response (1)",
+        "  -s  <bytes>     pad lines with 'x' to this length (0)",
+        "  -e  <p>         probability a command is not answered (0)",
+        "  -g  <p>         probability a line is random bytes (0)",
+        "  -b  <baudrate>  emulate wire speed at 10 bits per byte (no limit)",
+        "  -S  <seed>      seed of the random generator (1)",
+        "  -h              this menu",
+    };
+    for (size_t i = 0; i < sizeof(help)/sizeof(help[0]); i++) {
+        printf("%s\n", help[i]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    char cmd[CMD_MAX];
+    size_t len = 0;
+    int slave;
+    int fd;
+    int oc;
+
+    while ((oc = getopt(argc, argv, "l:L:r:n:s:e:g:b:S:h")) != -1) {
+        switch (oc) {
+            case 'l': config.link = optarg; break;
+            case 'L': config.latency = atof(optarg); break;
+            case 'r': config.rate = atof(optarg); break;
+            case 'n': config.lines = (unsigned int)atoi(optarg); break;
+            case 's': config.size = (size_t)atol(optarg); break;
+            case 'e': config.drop = atof(optarg); break;
+            case 'g': config.garbage = atof(optarg); break;
+            case 'b': config.baudrate = (unsigned int)atoi(optarg); break;
+            case 'S': srand((unsigned int)atoi(optarg)); break;
+            case 'h':
+                print_help();
+                exit(EXIT_SUCCESS);
+            default:
+                print_help();
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((fd = open_pty(&slave)) == -1) exit(EXIT_FAILURE);
+
+    if (config.link) {
+        unlink(config.link);
+        if (symlink(ptsname(fd), config.link) == -1) {
+            fprintf(stderr, "error linking %s: %s\n", config.link,
+                    strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("%s\n", ptsname(fd));
+    fflush(stdout);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = term;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    while (!killed) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int timeout = -1;
+
+        /* wake up for the next line that is due */
+        if (schedule.head) {
+            double due = schedule.head->due > schedule.free
+                ? schedule.head->due : schedule.free;
+            double wait = due - now();
+            timeout = wait > 0 ? (int)(wait * 1000) + 1 : 0;
+        }
+
+        if (poll(&pfd, 1, timeout) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (pfd.revents & POLLIN) {
+            char buf[4096];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) break;
+
+            for (ssize_t i = 0; i < n; i++) {
+                if (buf[i] != '\r' && buf[i] != '\n') {
+                    if (len < sizeof(cmd)) cmd[len++] = buf[i];
+                    continue;
+                }
+                if (len && respond(cmd, len) == -1) killed = 1;
+                len = 0;
+            }
+        }
+
+        if (transmit(fd) == -1) break;
+    }
+
+    if (config.link) unlink(config.link);
+    close(slave);
+    close(fd);
+    return 0;
+}
+
+// vim:ft=c